@@ -0,0 +1,75 @@
+#ifndef CHECKPOINT_HPP
+#define CHECKPOINT_HPP
+
+#include "dtype.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Model checkpoint file, little endian, written by BasicModel::save():
+//   CheckpointHeader (64 bytes)
+//   num_layers CheckpointLayer records
+//   CheckpointOptimizer record, only with CHECKPOINT_HAS_OPTIMIZER
+//   weight and bias blobs of every LINEAR layer in the model's dtype, then the optimizer
+//   state in its accumulation dtype, each blob starting on a 64 byte boundary
+// Blobs are aligned so a mapped file can be used in place, see LoadMode::MMAP.
+constexpr char CHECKPOINT_MAGIC[8] = {'M', 'L', 'C', 'K', 'P', 'T', '\0', '\0'};
+constexpr uint32_t CHECKPOINT_VERSION = 1;
+constexpr size_t CHECKPOINT_ALIGN = 64;
+constexpr uint32_t CHECKPOINT_HAS_OPTIMIZER = 1;
+
+struct CheckpointHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t header_size;
+    uint32_t dtype;      // DType of the weights
+    uint32_t elem_size;
+    uint32_t num_layers;
+    uint32_t flags;
+    uint64_t layers_offset;
+    uint64_t optimizer_offset;
+    uint64_t file_size;
+    uint8_t reserved[8];
+};
+static_assert(sizeof(CheckpointHeader) == CHECKPOINT_ALIGN, "CheckpointHeader must stay 64 bytes");
+
+struct CheckpointLayer {
+    uint32_t type;       // LayerType
+    uint32_t input;
+    uint32_t output;
+    uint32_t reserved;
+    uint64_t weights_offset; // 0 for layers without parameters
+    uint64_t bias_offset;
+};
+static_assert(sizeof(CheckpointLayer) == 32, "CheckpointLayer must stay 32 bytes");
+
+struct CheckpointOptimizer {
+    char name[24];       // Zero padded
+    uint64_t step;
+    uint64_t count;      // Values in the state blob
+    uint64_t values_offset;
+    uint32_t dtype;      // DType of the values
+    uint32_t reserved[3];
+};
+static_assert(sizeof(CheckpointOptimizer) == CHECKPOINT_ALIGN, "CheckpointOptimizer must stay 64 bytes");
+
+// COPY reads the parameters into tensors of their own. MMAP maps the file read-only and
+// points the weight and bias tensors straight at it: loading costs a few page faults, and
+// processes serving the same file share one physical copy. A mapped model is for inference
+// only, it has no gradients and its parameters can't be written.
+enum class LoadMode {
+    COPY = 0,
+    MMAP,
+};
+
+// Optimizer state saved alongside the parameters. The layout of values is up to the
+// optimizer that wrote it, name tells which one that was.
+template <typename T>
+struct BasicOptimizerState {
+    std::string name;
+    uint64_t step = 0;
+    std::vector<acc_t<T>> values;
+};
+
+#endif // CHECKPOINT_HPP
@@ -0,0 +1,71 @@
+#ifndef DATA_LOADER_HPP
+#define DATA_LOADER_HPP
+
+#include "tensor.hpp"
+#include "dataset.hpp"
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Builds batches on a background thread into a small ring of buffers that are allocated
+// once, so the training loop only ever waits for a batch that is already assembled. Every
+// epoch walks the dataset in the rng::shuffle() permutation for (seed, epoch); the
+// permutation for the next epoch is drawn on the loader thread while the current one is
+// still training.
+template <typename T>
+class BasicDataLoader {
+public:
+    struct Batch {
+        BasicTensor<T> input;  // rows x features
+        BasicTensor<T> labels; // rows x 1
+        int epoch = 0;
+        int rows = 0;          // 0 marks the end of an epoch
+
+        Batch(int batch_size, int features)
+            : input(std::vector<int>{batch_size, features}), labels(std::vector<int>{batch_size, 1}) {}
+    };
+
+    // With drop_last the trailing rows that do not fill a whole batch are skipped, otherwise
+    // they come as one smaller batch. depth is the number of buffers in the ring.
+    BasicDataLoader(const Dataset& dataset, int batch_size, bool shuffle = true, uint64_t seed = 0,
+                    bool drop_last = true, int depth = 3);
+    ~BasicDataLoader();
+
+    BasicDataLoader(const BasicDataLoader&) = delete;
+    BasicDataLoader& operator=(const BasicDataLoader&) = delete;
+
+    // Next batch of the current epoch, or nullptr once the epoch is done (the following call
+    // starts the next epoch). The batch stays valid until the next call.
+    const Batch* next();
+
+    int batches_per_epoch() const;
+
+private:
+    const Dataset& dataset;
+    const int batch_size;
+    const bool shuffle;
+    const uint64_t seed;
+    const bool drop_last;
+
+    std::vector<Batch> ring;
+    std::vector<int> order;
+
+    std::mutex mutex;
+    std::condition_variable filled_cv;
+    std::condition_variable free_cv;
+    uint64_t produced = 0; // Batches published by the loader thread
+    uint64_t consumed = 0; // Batches handed out by next()
+    uint64_t released = 0; // Batches whose buffer can be reused
+    bool stopping = false;
+    std::thread thread;
+
+    void producer_loop();
+    Batch* acquire();
+    void publish();
+};
+
+using DataLoader = BasicDataLoader<float>;
+
+#endif // DATA_LOADER_HPP
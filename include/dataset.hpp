@@ -0,0 +1,96 @@
+#ifndef DATASET_HPP
+#define DATASET_HPP
+
+#include "../include/tensor.hpp"
+#include "../include/mapped_file.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Binary dataset file, little endian:
+//   DatasetHeader (64 bytes)
+//   count rows of features uint8 pixels, each row padded to row_stride (a multiple of 64)
+//   count uint8 labels, starting on a 64 byte boundary
+// A pixel byte q stands for offset + scale * q.
+constexpr char DATASET_MAGIC[8] = {'M', 'L', 'D', 'A', 'T', 'A', '\0', '\0'};
+constexpr uint32_t DATASET_VERSION = 1;
+constexpr size_t DATASET_ALIGN = 64;
+
+struct DatasetHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t header_size;
+    uint64_t count;
+    uint32_t features;
+    uint32_t row_stride;
+    float scale;
+    float offset;
+    uint64_t pixels_offset;
+    uint64_t labels_offset;
+    uint8_t reserved[8];
+};
+static_assert(sizeof(DatasetHeader) == DATASET_ALIGN, "DatasetHeader must stay 64 bytes");
+
+// Either float tensors parsed from the text format, or uint8 pixels and labels: straight
+// from a mapped binary file, or owned after quantize(). fill_batch() hides the difference,
+// widening quantized rows with a vector kernel as the batch is assembled.
+class Dataset {
+public:
+    int count;
+    int features;
+    std::unique_ptr<Tensor> inputs; // Text format only
+    std::unique_ptr<Tensor> actual;
+
+    // Quantized only, pointing into the mapping or into storage
+    std::shared_ptr<MappedFile> mapping;
+    std::vector<uint8_t> storage;
+    const uint8_t* pixels = nullptr;
+    const uint8_t* labels = nullptr;
+    size_t row_stride = 0;
+    float scale = 1.0f;
+    float offset = 0.0f;
+
+    Dataset(int num_datapoints, int size_per_point);
+
+    // Maps a file written by convert_text_dataset(), nothing is copied
+    static std::unique_ptr<Dataset> map_binary(const std::string& path);
+
+    bool quantized() const { return pixels != nullptr; }
+    bool mapped() const { return mapping != nullptr; }
+
+    // Swaps the float tensors for uint8 pixels and labels in memory, a quarter of the size.
+    // Same encoding as convert_text_dataset(), so integer pixels in [0, 255] come back
+    // exactly. Throws for labels outside [0, 255].
+    void quantize();
+
+    // Copies rows [first, first + rows) into input (rows x features) and batch_labels (rows x 1)
+    template <typename T>
+    void fill_batch(int first, int rows, BasicTensor<T>& input, BasicTensor<T>& batch_labels) const;
+    // Same for an arbitrary list of rows, e.g. a shuffled slice
+    template <typename T>
+    void gather(const int* indices, int rows, BasicTensor<T>& input, BasicTensor<T>& batch_labels) const;
+    int label(int index) const;
+    // Rows [first, first + rows) in place, float datasets only (throws for quantized ones,
+    // whose uint8 pixels have to go through fill_batch)
+    TensorView<const float> input_rows(int first, int rows) const;
+
+private:
+    template <typename T>
+    void copy_row(int index, T* out) const;
+};
+
+// Parses the text format into an in-memory dataset
+void MNIST_dataset(const std::string& filename, Dataset* dataset);
+
+// One-time conversion of a "p0,p1,...;label" text file to the binary format. Pixels are
+// stored exactly when they are all integers in [0, 255], otherwise quantized linearly
+// between their min and max. Returns the number of rows written.
+int convert_text_dataset(const std::string& text_path, const std::string& binary_path);
+
+// Maps path with its extension swapped for .bin, converting the text file first if the
+// binary one is missing or older
+std::unique_ptr<Dataset> load_dataset(const std::string& text_path);
+
+#endif // DATASET_HPP
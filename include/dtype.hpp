@@ -0,0 +1,69 @@
+#ifndef DTYPE_HPP
+#define DTYPE_HPP
+
+#include <cstdint>
+#include <cstring>
+
+// bfloat16: the top 16 bits of an IEEE float. Only used as a storage format,
+// all arithmetic goes through float.
+struct bf16 {
+    uint16_t bits;
+
+    bf16() = default;
+    bf16(float value) : bits(from_float(value)) {}
+
+    operator float() const {
+        uint32_t u = static_cast<uint32_t>(bits) << 16;
+        float f;
+        std::memcpy(&f, &u, sizeof(f));
+        return f;
+    }
+
+    // Round to nearest even, NaNs stay (quiet) NaNs
+    static uint16_t from_float(float value) {
+        uint32_t u;
+        std::memcpy(&u, &value, sizeof(u));
+        if ((u & 0x7fffffffu) > 0x7f800000u) {
+            return static_cast<uint16_t>((u >> 16) | 0x0040u);
+        }
+        u += 0x7fffu + ((u >> 16) & 1u);
+        return static_cast<uint16_t>(u >> 16);
+    }
+};
+
+// Element type tags, also what checkpoints and logs use to name a type
+enum class DType {
+    FLOAT32 = 1,
+    FLOAT64,
+    BFLOAT16,
+};
+
+// Per element type: the type math and gradients are carried out in
+template <typename T>
+struct dtype_traits;
+
+template <>
+struct dtype_traits<float> {
+    using acc = float;
+    static constexpr DType dtype = DType::FLOAT32;
+    static constexpr const char* name = "float32";
+};
+
+template <>
+struct dtype_traits<double> {
+    using acc = double;
+    static constexpr DType dtype = DType::FLOAT64;
+    static constexpr const char* name = "float64";
+};
+
+template <>
+struct dtype_traits<bf16> {
+    using acc = float;
+    static constexpr DType dtype = DType::BFLOAT16;
+    static constexpr const char* name = "bfloat16";
+};
+
+template <typename T>
+using acc_t = typename dtype_traits<T>::acc;
+
+#endif // DTYPE_HPP
@@ -0,0 +1,74 @@
+#ifndef EVALUATOR_HPP
+#define EVALUATOR_HPP
+
+#include "tensor.hpp"
+#include "model.hpp"
+#include "dataset.hpp"
+#include "thread_pool.hpp"
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+struct EvalResult {
+    int count = 0;
+    int correct = 0;
+    double loss = 0.0; // Mean cross-entropy of the output probabilities
+    double seconds = 0.0;
+    int classes = 0;
+    std::vector<int64_t> confusion; // classes x classes, row = actual class, column = predicted
+
+    double accuracy() const { return count ? 100.0 * correct / count : 0.0; }
+    int64_t confusion_at(int actual, int predicted) const {
+        return confusion[static_cast<size_t>(actual) * classes + predicted];
+    }
+};
+
+// Batched evaluation of a model on a dataset that is loaded once and evaluated many times,
+// e.g. after every epoch. The rows are cut into chunks of chunk_rows, every worker starts
+// with a contiguous run of them and, once its own run is done, steals half of what is left
+// of the busiest other worker's. Chunks go through infer(), so the model's PANELS layout
+// helps here too, and each worker counts into its own accuracy, loss and confusion matrix,
+// summed once at the end. The model must end in SOFTMAX.
+template <typename T>
+class BasicEvaluator {
+public:
+    // The dataset must outlive the evaluator
+    BasicEvaluator(const Dataset& dataset, int num_threads, int chunk_rows = 256);
+
+    EvalResult evaluate(const BasicModel<T>& model);
+
+    int num_threads() const { return pool.size(); }
+
+private:
+    // Chunks [next, end) still to do for one worker, the owner takes from the front and
+    // thieves split off the back
+    struct alignas(64) WorkQueue {
+        std::mutex mutex;
+        int next = 0;
+        int end = 0;
+    };
+
+    struct Counters {
+        int correct = 0;
+        double loss = 0.0;
+        std::vector<int64_t> confusion;
+    };
+
+    const Dataset& dataset;
+    const int chunk_rows;
+    int max_label = 0;
+    ThreadPool pool;
+    std::vector<WorkQueue> queues;
+    std::vector<Counters> counters;
+    std::vector<BasicTensor<T>> inputs; // Per worker, reused across chunks and calls
+    std::vector<BasicTensor<T>> labels;
+    std::vector<BasicTensor<T>> outputs;
+
+    bool take(int w, int& chunk);
+    bool steal(int w, int& chunk);
+    void run_chunk(const BasicModel<T>& model, int w, int chunk);
+};
+
+using Evaluator = BasicEvaluator<float>;
+
+#endif // EVALUATOR_HPP
@@ -0,0 +1,151 @@
+#ifndef GEMM_HPP
+#define GEMM_HPP
+
+#include "dtype.hpp"
+#include "tensor_view.hpp"
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+// Blocked GEMM, C = alpha * op(A) * op(B) + beta * C, all matrices row-major.
+// op(A) is m x k, op(B) is k x n and C is m x n.
+enum class Transpose {
+    NO = 0,
+    YES,
+};
+
+// Blocking parameters. KC x NR panels of B stay in L1, MC x KC of A in L2 and
+// KC x NC of B in L3. The MR x NR register tile comes from the active kernel table,
+// MC and NC are multiples of every tile size it can pick.
+namespace gemm_blocking {
+    constexpr int MC = 96;
+    constexpr int KC = 256;
+    constexpr int NC = 2048;
+}
+
+// Operands may have different element types (e.g. bf16 activations times float gradients).
+// Panels are widened to the compute type while packing: double if any operand accumulates
+// in double, float otherwise. A C that is not of the compute type is accumulated in a
+// compute-type scratch and rounded once at the end.
+template <typename TA, typename TB, typename TC>
+using gemm_acc_t = typename std::conditional<
+    std::is_same<acc_t<TA>, double>::value || std::is_same<acc_t<TB>, double>::value ||
+        std::is_same<acc_t<TC>, double>::value,
+    double, float>::type;
+
+// Work folded into the last pass over k: bias (one value per column of C) and ReLU are
+// applied to each register tile before it is stored, softmax to each block of rows as soon
+// as all of their columns are done, while they are still in cache
+enum class Epilogue {
+    NONE = 0,
+    BIAS,
+    BIAS_RELU,
+    BIAS_SOFTMAX,
+};
+
+template <typename TA, typename TB, typename TC>
+void gemm(Transpose trans_a, Transpose trans_b, int m, int n, int k,
+          gemm_acc_t<TA, TB, TC> alpha, const TA* A, int lda, const TB* B, int ldb,
+          gemm_acc_t<TA, TB, TC> beta, TC* C, int ldc);
+
+class ThreadPool;
+
+// With a pool, C is cut into a grid of blocks along m and n (only m for BIAS_SOFTMAX) and
+// each worker runs one block over the whole of k. Every element is summed over k in the same
+// order as on one thread, so the result is the same bits for any pool size. Calls too small
+// to be worth the hand-off stay on the calling thread. Must not be called from a job already
+// running on the pool.
+template <typename TA, typename TB, typename TC>
+void gemm(Transpose trans_a, Transpose trans_b, int m, int n, int k,
+          gemm_acc_t<TA, TB, TC> alpha, const TA* A, int lda, const TB* B, int ldb,
+          gemm_acc_t<TA, TB, TC> beta, TC* C, int ldc, Epilogue epilogue, const TC* bias,
+          ThreadPool* pool = nullptr);
+
+// op(B) repacked once into the nr-column panels the blocked driver would otherwise build on
+// every call, stored in the order it reads them: for each NC block of columns, for each KC
+// block of k, the panels of that block. Elements are in the compute type. Meant for operands
+// that are reused unchanged across many calls, like weights while serving.
+template <typename T>
+struct PackedMatrix {
+    int k = 0;  // op(B) is k x n
+    int n = 0;
+    int nr = 0; // Panel width of the kernel table it was packed for
+    std::vector<T> panels;
+
+    size_t padded(int cols) const { return static_cast<size_t>((cols + nr - 1) / nr) * nr; }
+
+    // Panels of the block starting at column jc (a multiple of NC) and row pc, nc columns wide
+    const T* block(int jc, int pc, int nc) const {
+        return panels.data() + static_cast<size_t>(k) * (jc / gemm_blocking::NC) * padded(gemm_blocking::NC) +
+               static_cast<size_t>(pc) * padded(nc);
+    }
+};
+
+template <typename T, typename TB>
+PackedMatrix<T> pack_matrix(Transpose trans_b, int k, int n, const TB* B, int ldb);
+
+// Same as gemm() with B taken from a PackedMatrix, which must be in the compute type
+template <typename TA, typename TB, typename TC>
+void gemm(Transpose trans_a, int m, int n, int k,
+          gemm_acc_t<TA, TB, TC> alpha, const TA* A, int lda, const PackedMatrix<TB>& B,
+          gemm_acc_t<TA, TB, TC> beta, TC* C, int ldc, Epilogue epilogue, const TC* bias);
+
+class SpinTeam;
+
+// Up to this many rows, gemv() beats the blocked GEMM: packing costs more than it saves
+// when every element of B is only used a few times
+constexpr int GEMV_MAX_ROWS = 4;
+
+// C = A * B with the same epilogues as gemm(), for a few rows of A (m up to GEMV_MAX_ROWS
+// is what it is meant for). B is row-major k x n and streamed once in place. With a team,
+// the columns of C are split across its workers, so a single row uses several cores.
+template <typename T>
+void gemv(int m, int n, int k, const T* A, int lda, const T* B, int ldb, T* C, int ldc, Epilogue epilogue,
+          const T* bias, SpinTeam* team = nullptr);
+
+// How the GEMM addresses a 2-D view: rows with unit column stride as is, a transposed view
+// (unit row stride) as op = Transpose::YES. Throws for views with neither.
+template <typename T>
+Transpose gemm_layout(const TensorView<T>& v, int& ld) {
+    if (v.dims() != 2) {
+        throw std::invalid_argument("gemm needs 2-D views, not " + std::to_string(v.dims()) + "-D");
+    }
+    if (v.stride(1) == 1) {
+        ld = static_cast<int>(v.stride(0));
+        return Transpose::NO;
+    }
+    if (v.stride(0) == 1) {
+        ld = static_cast<int>(v.stride(1));
+        return Transpose::YES;
+    }
+    throw std::invalid_argument("gemm needs a view with unit stride along rows or columns");
+}
+
+// gemm() on views, C = alpha * A * B + beta * C with A m x k, B k x n and C m x n. A and B
+// can be slices, transposes or broadcasts of other tensors and are read in place, C needs
+// unit column stride.
+template <typename TA, typename TB, typename TC>
+void gemm(TensorView<TA> A, TensorView<TB> B, TensorView<TC> C,
+          gemm_acc_t<std::remove_const_t<TA>, std::remove_const_t<TB>, TC> alpha = 1,
+          gemm_acc_t<std::remove_const_t<TA>, std::remove_const_t<TB>, TC> beta = 0,
+          Epilogue epilogue = Epilogue::NONE, const TC* bias = nullptr) {
+    int lda = 0, ldb = 0, ldc = 0;
+    const Transpose trans_a = gemm_layout(A, lda);
+    const Transpose trans_b = gemm_layout(B, ldb);
+    if (gemm_layout(C, ldc) != Transpose::NO) {
+        throw std::invalid_argument("gemm cannot write a transposed C");
+    }
+    if (A.size(1) != B.size(0) || A.size(0) != C.size(0) || B.size(1) != C.size(1)) {
+        throw std::invalid_argument("Invalid dims for gemm: " + std::to_string(A.size(0)) + "x" +
+                                    std::to_string(A.size(1)) + " * " + std::to_string(B.size(0)) + "x" +
+                                    std::to_string(B.size(1)) + " into " + std::to_string(C.size(0)) + "x" +
+                                    std::to_string(C.size(1)));
+    }
+    gemm<std::remove_const_t<TA>, std::remove_const_t<TB>, TC>(
+        trans_a, trans_b, C.size(0), C.size(1), A.size(1), alpha, A.data(), lda, B.data(), ldb,
+        beta, C.data(), ldc, epilogue, bias);
+}
+
+#endif // GEMM_HPP
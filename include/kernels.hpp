@@ -0,0 +1,122 @@
+#ifndef KERNELS_HPP
+#define KERNELS_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+// Instruction sets the kernels are built for, in increasing width
+enum class Isa {
+    SCALAR = 0,
+    SSE2,
+    AVX2,
+    AVX512,
+};
+
+// Per-step constants of an Adam update, worked out once by the optimizer
+template <typename T>
+struct AdamCoefficients {
+    T beta1;
+    T beta2;
+    T epsilon;
+    T step_size;      // learning_rate / (1 - beta1^t)
+    T inv_sqrt_bias2; // 1 / sqrt(1 - beta2^t)
+    T l2;             // Weight decay added to the gradient (Adam)
+    T decay;          // Parameters are scaled by this first, 1 - learning_rate * weight_decay for AdamW
+};
+
+// One set of kernels for a given element type and instruction set.
+// All pointers are assumed not to alias unless stated otherwise.
+template <typename T>
+struct KernelTable {
+    Isa isa;
+
+    // GEMM register tile, A is packed in mr-row panels and B in nr-column panels
+    int gemm_mr;
+    int gemm_nr;
+    // C[mr x nr] = alpha * a_panel * b_panel + beta * C, only the top-left rows x cols are stored.
+    // Epilogue on the tile before it is stored: + bias[j] per column if bias, then max(., 0) if relu.
+    void (*gemm_micro)(int kc, const T* a, const T* b, T* c, int ldc, T alpha, T beta, int rows, int cols,
+                       const T* bias, bool relu);
+
+    // C[m x n] = A[m x k] * B[k x n] for a few rows of A, B row-major and streamed once
+    // straight from memory with no packing. Same epilogue as gemm_micro.
+    void (*gemv)(int m, int n, int k, const T* a, int lda, const T* b, int ldb, T* c, int ldc, const T* bias,
+                 bool relu);
+
+    // x[r, :] += bias for every row
+    void (*bias_add)(T* x, const T* bias, int rows, int cols);
+    // y = max(x, 0), y may alias x
+    void (*relu_forward)(const T* x, T* y, size_t n);
+    // dx = x > 0 ? dy : 0, dx may alias dy
+    void (*relu_backward)(const T* x, const T* dy, T* dx, size_t n);
+    // Row-wise softmax with max subtraction, y may alias x
+    void (*softmax_rows)(const T* x, T* y, int rows, int cols);
+    // grad = (probs - onehot(labels)) * scale
+    void (*cross_entropy_grad)(const T* probs, const T* labels, T* grad, int rows, int cols, T scale);
+    // Softmax + cross-entropy on logits via log-sum-exp, returns the loss summed over rows.
+    // Writes probs and grad = (softmax - onehot(labels)) * scale when non-null, probs may
+    // alias logits.
+    double (*softmax_cross_entropy)(const T* logits, const T* labels, T* probs, T* grad, int rows, int cols, T scale);
+    // Bias gradient: db = beta * db + column sums of dy (beta 0 or 1). With a mask, dy is
+    // first zeroed where mask <= 0 (fused ReLU) and the masked rows are written to dy_out.
+    void (*bias_backward)(const T* dy, const T* mask, T* dy_out, T* db, int rows, int cols, T beta);
+    // dst += src
+    void (*accumulate)(T* dst, const T* src, size_t n);
+    // param -= learning_rate * grad
+    void (*sgd_update)(T* param, const T* grad, T learning_rate, size_t n);
+    // g = grad + weight_decay * param, velocity = momentum * velocity + g, then
+    // param -= learning_rate * velocity, or learning_rate * (g + momentum * velocity) for Nesterov
+    void (*momentum_update)(T* param, const T* grad, T* velocity, size_t n, T learning_rate, T momentum,
+                            T weight_decay, bool nesterov);
+    // g = grad + l2 * param, m = beta1 * m + (1 - beta1) * g, v = beta2 * v + (1 - beta2) * g^2,
+    // param = decay * param - step_size * m / (sqrt(v) * inv_sqrt_bias2 + epsilon)
+    void (*adam_update)(T* param, const T* grad, T* m, T* v, size_t n, const AdamCoefficients<T>& c);
+    // out = offset + scale * q, widening uint8 dataset pixels
+    void (*dequantize_u8)(const uint8_t* q, T* out, size_t n, T scale, T offset);
+    // out = offset + scale * q, e.g. random bits to uniform values
+    void (*scale_i32)(const int32_t* q, T* out, size_t n, T scale, T offset);
+};
+
+// Kernels for the widest instruction set this host supports, picked once via CPUID.
+// The KERNEL_ISA environment variable (scalar, sse2, avx2, avx512) can lower the choice.
+template <typename T>
+const KernelTable<T>& kernels();
+
+// Kernels for a specific instruction set, falls back to scalar if the host can't run it
+template <typename T>
+const KernelTable<T>& kernels(Isa isa);
+
+// Integer kernels for int8 quantized inference. Activations are uint8 limited to [0, 127]
+// and weights int8 in [-127, 127], so pairs of products fit pmaddubsw's int16 without
+// saturating and every build gives the same integer results.
+constexpr int INT8_K_ALIGN = 64;
+
+struct Int8Kernels {
+    const char* name; // scalar, avx2 or avx512-vnni
+    // acc[r, c] = sum over k of x[r, k] * w[c, k]. x is rows x k, w is cols x k (one row per
+    // output channel), k a multiple of INT8_K_ALIGN with both zero padded.
+    void (*gemm_u8s8)(const uint8_t* x, const int8_t* w, int32_t* acc, int rows, int cols, int k);
+};
+
+// Widest int8 kernels the host (and KERNEL_ISA) allows: VNNI vpdpbusd with AVX-512,
+// pmaddubsw with AVX2, plain loops otherwise
+const Int8Kernels& int8_kernels();
+// The int8 kernels for a specific instruction set by the same rule, scalar if the host can't
+// run it
+const Int8Kernels& int8_kernels(Isa isa);
+
+// Philox4x32-10 blocks for the counter-based generator in random.hpp, with the block
+// counters of one stream spread across vector lanes
+struct RandomKernels {
+    const char* name; // scalar, avx2 or avx512
+    // out[4 * b + lane] = value lane of block first_block + b of (seed, stream), b < blocks
+    void (*philox)(uint64_t seed, uint64_t stream, uint64_t first_block, size_t blocks, uint32_t* out);
+};
+
+// Widest generator kernels the host (and KERNEL_ISA) allows, all giving the same values
+const RandomKernels& random_kernels();
+
+Isa detect_isa();
+const char* isa_name(Isa isa);
+
+#endif // KERNELS_HPP
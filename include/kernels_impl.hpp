@@ -0,0 +1,570 @@
+// Kernel bodies shared by every instruction set. Not a public header: each kernels_*.cpp
+// defines its vector types (VecD/VecF) in an anonymous namespace, includes this file and
+// is compiled with its own -m flags. Everything here has internal linkage on purpose, so
+// code built for a wide instruction set can never be picked up by code built without it.
+// Only plain C headers are used for the same reason.
+//
+// A vector type V provides:
+//   T, R, W                      scalar type, register type, lanes per register
+//   zero, set1, loadu, storeu
+//   add, sub, mul, div, max, sqrt
+//   fmadd(a, b, c) = a * b + c, fnmadd(a, b, c) = c - a * b
+//   relu_mask(x, v) = x > 0 ? v : 0
+//   hsum, hmax                   horizontal reductions to a scalar
+
+#ifndef KERNELS_IMPL_HPP
+#define KERNELS_IMPL_HPP
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace {
+
+inline double exp_scalar(double x) { return exp(x); }
+inline float exp_scalar(float x) { return expf(x); }
+inline double sqrt_scalar(double x) { return sqrt(x); }
+inline float sqrt_scalar(float x) { return sqrtf(x); }
+
+// One Philox4x32-10 block of (seed, stream), for the odd blocks the vector generators don't
+// cover. Same rounds as rng::philox() in random.hpp, which can't be included here.
+inline void philox_block(uint64_t seed, uint64_t stream, uint64_t block, uint32_t out[4]) {
+    uint32_t c0 = static_cast<uint32_t>(block), c1 = static_cast<uint32_t>(block >> 32);
+    uint32_t c2 = static_cast<uint32_t>(stream), c3 = static_cast<uint32_t>(stream >> 32);
+    uint32_t k0 = static_cast<uint32_t>(seed), k1 = static_cast<uint32_t>(seed >> 32);
+    for (int round = 0; round < 10; ++round) {
+        const uint64_t p0 = 0xD2511F53ull * c0;
+        const uint64_t p1 = 0xCD9E8D57ull * c2;
+        const uint32_t n0 = static_cast<uint32_t>(p1 >> 32) ^ c1 ^ k0;
+        const uint32_t n2 = static_cast<uint32_t>(p0 >> 32) ^ c3 ^ k1;
+        c0 = n0;
+        c1 = static_cast<uint32_t>(p1);
+        c2 = n2;
+        c3 = static_cast<uint32_t>(p0);
+        k0 += 0x9E3779B9u;
+        k1 += 0xBB67AE85u;
+    }
+    out[0] = c0;
+    out[1] = c1;
+    out[2] = c2;
+    out[3] = c3;
+}
+
+template <class V, int MR, int NV>
+void gemm_micro(int kc, const typename V::T* a, const typename V::T* b, typename V::T* c, int ldc,
+                typename V::T alpha, typename V::T beta, int rows, int cols, const typename V::T* bias, bool relu) {
+    using T = typename V::T;
+    using R = typename V::R;
+    constexpr int NR = NV * V::W;
+
+    R acc[MR][NV];
+#pragma GCC unroll 16
+    for (int i = 0; i < MR; ++i) {
+#pragma GCC unroll 16
+        for (int j = 0; j < NV; ++j) {
+            acc[i][j] = V::zero();
+        }
+    }
+
+    for (int p = 0; p < kc; ++p) {
+        R bv[NV];
+#pragma GCC unroll 16
+        for (int j = 0; j < NV; ++j) {
+            bv[j] = V::loadu(b + j * V::W);
+        }
+#pragma GCC unroll 16
+        for (int i = 0; i < MR; ++i) {
+            const R ai = V::set1(a[i]);
+#pragma GCC unroll 16
+            for (int j = 0; j < NV; ++j) {
+                acc[i][j] = V::fmadd(ai, bv[j], acc[i][j]);
+            }
+        }
+        a += MR;
+        b += NR;
+    }
+
+    const R alpha_v = V::set1(alpha);
+    if (rows == MR && cols == NR) {
+        const R beta_v = V::set1(beta);
+        R bias_v[NV];
+#pragma GCC unroll 16
+        for (int j = 0; j < NV; ++j) {
+            bias_v[j] = bias ? V::loadu(bias + j * V::W) : V::zero();
+        }
+#pragma GCC unroll 16
+        for (int i = 0; i < MR; ++i) {
+#pragma GCC unroll 16
+            for (int j = 0; j < NV; ++j) {
+                T* out = c + i * ldc + j * V::W;
+                R r = V::mul(alpha_v, acc[i][j]);
+                if (beta != T(0)) {
+                    r = V::fmadd(beta_v, V::loadu(out), r);
+                }
+                if (bias) {
+                    r = V::add(r, bias_v[j]);
+                }
+                if (relu) {
+                    r = V::max(r, V::zero());
+                }
+                V::storeu(out, r);
+            }
+        }
+        return;
+    }
+
+    // Edge tile, go through a scratch tile so nothing outside rows x cols is touched
+    T tile[MR * NR];
+    for (int i = 0; i < MR; ++i) {
+        for (int j = 0; j < NV; ++j) {
+            V::storeu(tile + i * NR + j * V::W, V::mul(alpha_v, acc[i][j]));
+        }
+    }
+    for (int i = 0; i < rows; ++i) {
+        for (int j = 0; j < cols; ++j) {
+            T* out = c + i * ldc + j;
+            T r = beta == T(0) ? tile[i * NR + j] : tile[i * NR + j] + beta * *out;
+            if (bias) {
+                r += bias[j];
+            }
+            if (relu) {
+                r = r > T(0) ? r : T(0);
+            }
+            *out = r;
+        }
+    }
+}
+
+template <class V>
+void bias_add(typename V::T* x, const typename V::T* bias, int rows, int cols) {
+    for (int r = 0; r < rows; ++r) {
+        typename V::T* row = x + static_cast<size_t>(r) * cols;
+        int j = 0;
+        for (; j + V::W <= cols; j += V::W) {
+            V::storeu(row + j, V::add(V::loadu(row + j), V::loadu(bias + j)));
+        }
+        for (; j < cols; ++j) {
+            row[j] += bias[j];
+        }
+    }
+}
+
+template <class V>
+void relu_forward(const typename V::T* x, typename V::T* y, size_t n) {
+    using T = typename V::T;
+    const typename V::R zero = V::zero();
+    size_t i = 0;
+    for (; i + V::W <= n; i += V::W) {
+        V::storeu(y + i, V::max(V::loadu(x + i), zero));
+    }
+    for (; i < n; ++i) {
+        y[i] = x[i] > T(0) ? x[i] : T(0);
+    }
+}
+
+template <class V>
+void relu_backward(const typename V::T* x, const typename V::T* dy, typename V::T* dx, size_t n) {
+    using T = typename V::T;
+    size_t i = 0;
+    for (; i + V::W <= n; i += V::W) {
+        V::storeu(dx + i, V::relu_mask(V::loadu(x + i), V::loadu(dy + i)));
+    }
+    for (; i < n; ++i) {
+        dx[i] = x[i] > T(0) ? dy[i] : T(0);
+    }
+}
+
+template <class V>
+void softmax_rows(const typename V::T* x, typename V::T* y, int rows, int cols) {
+    using T = typename V::T;
+    using R = typename V::R;
+    for (int b = 0; b < rows; ++b) {
+        const T* in = x + static_cast<size_t>(b) * cols;
+        T* out = y + static_cast<size_t>(b) * cols;
+
+        T max_val = in[0];
+        int j = 0;
+        if (cols >= V::W) {
+            R m = V::loadu(in);
+            for (j = V::W; j + V::W <= cols; j += V::W) {
+                m = V::max(m, V::loadu(in + j));
+            }
+            max_val = V::hmax(m);
+        }
+        for (; j < cols; ++j) {
+            max_val = in[j] > max_val ? in[j] : max_val;
+        }
+
+        for (j = 0; j < cols; ++j) {
+            out[j] = exp_scalar(in[j] - max_val);
+        }
+
+        R s = V::zero();
+        for (j = 0; j + V::W <= cols; j += V::W) {
+            s = V::add(s, V::loadu(out + j));
+        }
+        T sum = V::hsum(s);
+        for (; j < cols; ++j) {
+            sum += out[j];
+        }
+
+        const R sum_v = V::set1(sum);
+        for (j = 0; j + V::W <= cols; j += V::W) {
+            V::storeu(out + j, V::div(V::loadu(out + j), sum_v));
+        }
+        for (; j < cols; ++j) {
+            out[j] /= sum;
+        }
+    }
+}
+
+template <class V>
+void cross_entropy_grad(const typename V::T* probs, const typename V::T* labels, typename V::T* grad,
+                        int rows, int cols, typename V::T scale) {
+    using T = typename V::T;
+    const typename V::R scale_v = V::set1(scale);
+    for (int b = 0; b < rows; ++b) {
+        const T* p = probs + static_cast<size_t>(b) * cols;
+        T* g = grad + static_cast<size_t>(b) * cols;
+        int j = 0;
+        for (; j + V::W <= cols; j += V::W) {
+            V::storeu(g + j, V::mul(V::loadu(p + j), scale_v));
+        }
+        for (; j < cols; ++j) {
+            g[j] = p[j] * scale;
+        }
+        const int target = static_cast<int>(labels[b]);
+        g[target] = (p[target] - T(1)) * scale;
+    }
+}
+
+template <class V>
+double softmax_cross_entropy(const typename V::T* logits, const typename V::T* labels, typename V::T* probs,
+                             typename V::T* grad, int rows, int cols, typename V::T scale) {
+    using T = typename V::T;
+    using R = typename V::R;
+    double loss = 0.0;
+    for (int b = 0; b < rows; ++b) {
+        const T* in = logits + static_cast<size_t>(b) * cols;
+        T* p = probs ? probs + static_cast<size_t>(b) * cols : nullptr;
+        T* g = grad ? grad + static_cast<size_t>(b) * cols : nullptr;
+        const int target = static_cast<int>(labels[b]);
+        const T target_logit = in[target];
+
+        T max_val = in[0];
+        int j = 0;
+        if (cols >= V::W) {
+            R m = V::loadu(in);
+            for (j = V::W; j + V::W <= cols; j += V::W) {
+                m = V::max(m, V::loadu(in + j));
+            }
+            max_val = V::hmax(m);
+        }
+        for (; j < cols; ++j) {
+            max_val = in[j] > max_val ? in[j] : max_val;
+        }
+
+        // Exponentials are staged in grad if there is one (probs may be the logits)
+        T* e = g ? g : p;
+        T sum = 0;
+        if (e) {
+            for (j = 0; j < cols; ++j) {
+                e[j] = exp_scalar(in[j] - max_val);
+            }
+            R s = V::zero();
+            for (j = 0; j + V::W <= cols; j += V::W) {
+                s = V::add(s, V::loadu(e + j));
+            }
+            sum = V::hsum(s);
+            for (; j < cols; ++j) {
+                sum += e[j];
+            }
+        } else {
+            for (j = 0; j < cols; ++j) {
+                sum += exp_scalar(in[j] - max_val);
+            }
+        }
+
+        // log(softmax(x)[target]) = x[target] - max - log(sum), no clamping needed
+        loss += log(static_cast<double>(sum)) + static_cast<double>(max_val - target_logit);
+
+        const T inv = T(1) / sum;
+        if (p) {
+            const R inv_v = V::set1(inv);
+            for (j = 0; j + V::W <= cols; j += V::W) {
+                V::storeu(p + j, V::mul(V::loadu(e + j), inv_v));
+            }
+            for (; j < cols; ++j) {
+                p[j] = e[j] * inv;
+            }
+        }
+        if (g) {
+            const R inv_v = V::set1(inv * scale);
+            for (j = 0; j + V::W <= cols; j += V::W) {
+                V::storeu(g + j, V::mul(V::loadu(g + j), inv_v));
+            }
+            for (; j < cols; ++j) {
+                g[j] *= inv * scale;
+            }
+            g[target] -= scale;
+        }
+    }
+    return loss;
+}
+
+template <class V>
+void bias_backward(const typename V::T* dy, const typename V::T* mask, typename V::T* dy_out, typename V::T* db,
+                   int rows, int cols, typename V::T beta) {
+    using T = typename V::T;
+    if (beta == T(0)) {
+        for (int j = 0; j < cols; ++j) {
+            db[j] = T(0);
+        }
+    }
+    // Row by row, so every load is contiguous and db stays in L1
+    for (int b = 0; b < rows; ++b) {
+        const T* g = dy + static_cast<size_t>(b) * cols;
+        const T* m = mask ? mask + static_cast<size_t>(b) * cols : nullptr;
+        T* out = mask ? dy_out + static_cast<size_t>(b) * cols : nullptr;
+        int j = 0;
+        for (; j + V::W <= cols; j += V::W) {
+            typename V::R v = V::loadu(g + j);
+            if (m) {
+                v = V::relu_mask(V::loadu(m + j), v);
+                V::storeu(out + j, v);
+            }
+            V::storeu(db + j, V::add(V::loadu(db + j), v));
+        }
+        for (; j < cols; ++j) {
+            T v = g[j];
+            if (m) {
+                v = m[j] > T(0) ? v : T(0);
+                out[j] = v;
+            }
+            db[j] += v;
+        }
+    }
+}
+
+template <class V>
+void accumulate(typename V::T* dst, const typename V::T* src, size_t n) {
+    size_t i = 0;
+    for (; i + V::W <= n; i += V::W) {
+        V::storeu(dst + i, V::add(V::loadu(dst + i), V::loadu(src + i)));
+    }
+    for (; i < n; ++i) {
+        dst[i] += src[i];
+    }
+}
+
+// ROWS rows of C, NV vectors of columns at a time: every row of B is loaded once and used
+// for all ROWS rows
+template <class V, int ROWS, int NV>
+void gemv_rows(int n, int k, const typename V::T* a, int lda, const typename V::T* b, int ldb, typename V::T* c,
+               int ldc, const typename V::T* bias, bool relu) {
+    using T = typename V::T;
+    using R = typename V::R;
+    constexpr int NR = NV * V::W;
+
+    auto store = [&](R r, T* out, const T* bias_j) {
+        if (bias_j) {
+            r = V::add(r, V::loadu(bias_j));
+        }
+        V::storeu(out, relu ? V::max(r, V::zero()) : r);
+    };
+
+    int j = 0;
+    for (; j + NR <= n; j += NR) {
+        R acc[ROWS][NV];
+#pragma GCC unroll 16
+        for (int i = 0; i < ROWS; ++i) {
+#pragma GCC unroll 16
+            for (int v = 0; v < NV; ++v) {
+                acc[i][v] = V::zero();
+            }
+        }
+        for (int p = 0; p < k; ++p) {
+            const T* bp = b + static_cast<size_t>(p) * ldb + j;
+            R bv[NV];
+#pragma GCC unroll 16
+            for (int v = 0; v < NV; ++v) {
+                bv[v] = V::loadu(bp + v * V::W);
+            }
+#pragma GCC unroll 16
+            for (int i = 0; i < ROWS; ++i) {
+                const R ai = V::set1(a[i * lda + p]);
+#pragma GCC unroll 16
+                for (int v = 0; v < NV; ++v) {
+                    acc[i][v] = V::fmadd(ai, bv[v], acc[i][v]);
+                }
+            }
+        }
+#pragma GCC unroll 16
+        for (int i = 0; i < ROWS; ++i) {
+#pragma GCC unroll 16
+            for (int v = 0; v < NV; ++v) {
+                store(acc[i][v], c + i * ldc + j + v * V::W, bias ? bias + j + v * V::W : nullptr);
+            }
+        }
+    }
+    for (; j + V::W <= n; j += V::W) {
+        R acc[ROWS];
+#pragma GCC unroll 16
+        for (int i = 0; i < ROWS; ++i) {
+            acc[i] = V::zero();
+        }
+        for (int p = 0; p < k; ++p) {
+            const R bv = V::loadu(b + static_cast<size_t>(p) * ldb + j);
+#pragma GCC unroll 16
+            for (int i = 0; i < ROWS; ++i) {
+                acc[i] = V::fmadd(V::set1(a[i * lda + p]), bv, acc[i]);
+            }
+        }
+#pragma GCC unroll 16
+        for (int i = 0; i < ROWS; ++i) {
+            store(acc[i], c + i * ldc + j, bias ? bias + j : nullptr);
+        }
+    }
+    for (; j < n; ++j) {
+        for (int i = 0; i < ROWS; ++i) {
+            T sum = 0;
+            for (int p = 0; p < k; ++p) {
+                sum += a[i * lda + p] * b[static_cast<size_t>(p) * ldb + j];
+            }
+            sum += bias ? bias[j] : T(0);
+            c[i * ldc + j] = relu && sum < T(0) ? T(0) : sum;
+        }
+    }
+}
+
+template <class V>
+void gemv(int m, int n, int k, const typename V::T* a, int lda, const typename V::T* b, int ldb, typename V::T* c,
+          int ldc, const typename V::T* bias, bool relu) {
+    // Fewer rows get wider column tiles, so there are always enough independent FMA chains
+    int i = 0;
+    for (; i + 4 <= m; i += 4) {
+        gemv_rows<V, 4, 2>(n, k, a + i * lda, lda, b, ldb, c + i * ldc, ldc, bias, relu);
+    }
+    switch (m - i) {
+        case 3: gemv_rows<V, 3, 2>(n, k, a + i * lda, lda, b, ldb, c + i * ldc, ldc, bias, relu); break;
+        case 2: gemv_rows<V, 2, 4>(n, k, a + i * lda, lda, b, ldb, c + i * ldc, ldc, bias, relu); break;
+        case 1: gemv_rows<V, 1, 4>(n, k, a + i * lda, lda, b, ldb, c + i * ldc, ldc, bias, relu); break;
+        default: break;
+    }
+}
+
+template <class V>
+void sgd_update(typename V::T* param, const typename V::T* grad, typename V::T learning_rate, size_t n) {
+    const typename V::R lr = V::set1(learning_rate);
+    size_t i = 0;
+    for (; i + V::W <= n; i += V::W) {
+        V::storeu(param + i, V::fnmadd(lr, V::loadu(grad + i), V::loadu(param + i)));
+    }
+    for (; i < n; ++i) {
+        param[i] -= learning_rate * grad[i];
+    }
+}
+
+template <class V>
+void dequantize_u8(const uint8_t* q, typename V::T* out, size_t n, typename V::T scale, typename V::T offset) {
+    // mul then add rather than fmadd, so every ISA rounds like the scalar loop
+    const typename V::R s = V::set1(scale);
+    const typename V::R o = V::set1(offset);
+    size_t i = 0;
+    for (; i + V::W <= n; i += V::W) {
+        V::storeu(out + i, V::add(o, V::mul(s, V::load_u8(q + i))));
+    }
+    for (; i < n; ++i) {
+        out[i] = offset + scale * static_cast<typename V::T>(q[i]);
+    }
+}
+
+template <class V>
+void scale_i32(const int32_t* q, typename V::T* out, size_t n, typename V::T scale, typename V::T offset) {
+    const typename V::R s = V::set1(scale);
+    const typename V::R o = V::set1(offset);
+    size_t i = 0;
+    for (; i + V::W <= n; i += V::W) {
+        V::storeu(out + i, V::add(o, V::mul(s, V::load_i32(q + i))));
+    }
+    for (; i < n; ++i) {
+        out[i] = offset + scale * static_cast<typename V::T>(q[i]);
+    }
+}
+
+template <class V>
+void momentum_update(typename V::T* param, const typename V::T* grad, typename V::T* velocity, size_t n,
+                     typename V::T learning_rate, typename V::T momentum, typename V::T weight_decay, bool nesterov) {
+    using T = typename V::T;
+    using R = typename V::R;
+    const R lr = V::set1(learning_rate), mu = V::set1(momentum), wd = V::set1(weight_decay);
+    size_t i = 0;
+    for (; i + V::W <= n; i += V::W) {
+        const R p = V::loadu(param + i);
+        const R g = V::fmadd(wd, p, V::loadu(grad + i));
+        const R v = V::fmadd(mu, V::loadu(velocity + i), g);
+        V::storeu(velocity + i, v);
+        V::storeu(param + i, V::fnmadd(lr, nesterov ? V::fmadd(mu, v, g) : v, p));
+    }
+    for (; i < n; ++i) {
+        const T g = grad[i] + weight_decay * param[i];
+        const T v = momentum * velocity[i] + g;
+        velocity[i] = v;
+        param[i] -= learning_rate * (nesterov ? g + momentum * v : v);
+    }
+}
+
+template <class V>
+void adam_update(typename V::T* param, const typename V::T* grad, typename V::T* m, typename V::T* v, size_t n,
+                 const AdamCoefficients<typename V::T>& c) {
+    using T = typename V::T;
+    using R = typename V::R;
+    const R b1 = V::set1(c.beta1), b2 = V::set1(c.beta2);
+    const R one_b1 = V::set1(T(1) - c.beta1), one_b2 = V::set1(T(1) - c.beta2);
+    const R eps = V::set1(c.epsilon), step = V::set1(c.step_size), bias2 = V::set1(c.inv_sqrt_bias2);
+    const R l2 = V::set1(c.l2), decay = V::set1(c.decay);
+    size_t i = 0;
+    // One pass: reads param, grad, m and v once and writes param, m and v once
+    for (; i + V::W <= n; i += V::W) {
+        const R p = V::loadu(param + i);
+        const R g = V::fmadd(l2, p, V::loadu(grad + i));
+        const R mi = V::fmadd(b1, V::loadu(m + i), V::mul(one_b1, g));
+        const R vi = V::fmadd(b2, V::loadu(v + i), V::mul(one_b2, V::mul(g, g)));
+        V::storeu(m + i, mi);
+        V::storeu(v + i, vi);
+        const R denom = V::fmadd(V::sqrt(vi), bias2, eps);
+        V::storeu(param + i, V::fnmadd(step, V::div(mi, denom), V::mul(decay, p)));
+    }
+    for (; i < n; ++i) {
+        const T g = grad[i] + c.l2 * param[i];
+        m[i] = c.beta1 * m[i] + (T(1) - c.beta1) * g;
+        v[i] = c.beta2 * v[i] + (T(1) - c.beta2) * g * g;
+        param[i] = c.decay * param[i] - c.step_size * m[i] / (sqrt_scalar(v[i]) * c.inv_sqrt_bias2 + c.epsilon);
+    }
+}
+
+template <class V, int MR, int NV>
+void fill_table(KernelTable<typename V::T>& table, Isa isa) {
+    table.isa = isa;
+    table.gemm_mr = MR;
+    table.gemm_nr = NV * V::W;
+    table.gemm_micro = &gemm_micro<V, MR, NV>;
+    table.gemv = &gemv<V>;
+    table.bias_add = &bias_add<V>;
+    table.relu_forward = &relu_forward<V>;
+    table.relu_backward = &relu_backward<V>;
+    table.softmax_rows = &softmax_rows<V>;
+    table.cross_entropy_grad = &cross_entropy_grad<V>;
+    table.softmax_cross_entropy = &softmax_cross_entropy<V>;
+    table.bias_backward = &bias_backward<V>;
+    table.accumulate = &accumulate<V>;
+    table.sgd_update = &sgd_update<V>;
+    table.momentum_update = &momentum_update<V>;
+    table.adam_update = &adam_update<V>;
+    table.dequantize_u8 = &dequantize_u8<V>;
+    table.scale_i32 = &scale_i32<V>;
+}
+
+} // namespace
+
+#endif // KERNELS_IMPL_HPP
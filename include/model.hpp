@@ -2,8 +2,13 @@
 #define MODEL_HPP
 
 #include "../include/tensor.hpp"
+#include "../include/gemm.hpp"
+#include "../include/checkpoint.hpp"
+#include "../include/random.hpp"
 #include <memory>
 #include <stdexcept>
+#include <string>
+#include <vector>
 
 // enum class for type safety
 enum class LayerType {
@@ -12,32 +17,141 @@ enum class LayerType {
     SOFTMAX,
 };
 
-class Layer {
+// How infer() reads LINEAR weights. ROW_MAJOR packs them into GEMM panels on every call,
+// PANELS keeps a packed copy next to the row-major weights (which training and checkpoints
+// keep using) so inference skips that. Batches of up to GEMV_MAX_ROWS rows read the
+// row-major weights directly either way.
+enum class WeightLayout {
+    ROW_MAJOR = 0,
+    PANELS,
+};
+
+// How BasicModel::initialize() draws LINEAR weights, fan_in and fan_out being the weight
+// matrix's rows and columns. UNIFORM is U(-1, 1) for weights and biases like a new layer,
+// the others zero the biases: XAVIER U(+-sqrt(6 / (fan_in + fan_out))) for tanh/sigmoid-like
+// layers, HE U(+-sqrt(6 / fan_in)) for ReLU, and the _NORMAL variants the same variance as
+// N(0, sqrt(2 / (fan_in + fan_out))) and N(0, sqrt(2 / fan_in)).
+enum class WeightInit {
+    UNIFORM = 0,
+    XAVIER,
+    HE,
+    XAVIER_NORMAL,
+    HE_NORMAL,
+};
+
+template <typename T>
+class BasicLayer {
 public:
     LayerType layer_type;
-    std::unique_ptr<Tensor> weights;
-    std::unique_ptr<Tensor> bias;
-    std::unique_ptr<Tensor> input;  // For grad
-    std::unique_ptr<Tensor> output; // For grad
+    std::unique_ptr<BasicTensor<T>> weights;
+    std::unique_ptr<BasicTensor<T>> bias;
+    // Copy of weights in GEMM panels with WeightLayout::PANELS, null otherwise
+    std::unique_ptr<PackedMatrix<gemm_acc_t<T, T, T>>> packed_weights;
 
-    Layer(LayerType t, int input_size, int output_size) : layer_type(t) {
+    BasicLayer(LayerType t, int input_size, int output_size) : layer_type(t) {
         if (t == LayerType::LINEAR) {
-            weights = std::make_unique<Tensor>(std::vector<int>{input_size, output_size}, true, true);
-            bias = std::make_unique<Tensor>(std::vector<int>{output_size}, true, true);
+            weights = std::make_unique<BasicTensor<T>>(std::vector<int>{input_size, output_size}, true, true);
+            bias = std::make_unique<BasicTensor<T>>(std::vector<int>{output_size}, true, true);
         }
     }
 
-    Layer(const Layer&) = default;
-    Layer(Layer&&) = default;
-    ~Layer() = default;
+    BasicLayer(const BasicLayer&) = default;
+    BasicLayer(BasicLayer&&) = default;
+    ~BasicLayer() = default;
+};
+
+// One step of a model's schedule: a single layer, or a LINEAR together with the RELU or
+// SOFTMAX right after it, run as one GEMM with the activation in its epilogue
+struct FusedStep {
+    int layer;         // First layer of the step
+    int count;         // Layers it covers, 1 or 2
+    Epilogue epilogue; // For LINEAR steps
+};
+
+template <typename T>
+class BasicModel;
+
+class MappedFile;
+
+// State of one forward/backward pass: the activations forward() caches for backward(), and
+// optionally private parameter gradients so several threads can run passes on one Model.
+//
+// Activations and gradients live in two arenas laid out once by plan() for a model and a
+// maximum batch size, so a steady-state step allocates nothing. Buffers are shared where
+// liveness allows: RELU and SOFTMAX write over their input when nothing reads it later,
+// and backward() ping-pongs between two gradient buffers.
+template <typename T>
+class BasicWorkspace {
+public:
+    using grad_type = acc_t<T>;
+
+    // inputs[l] and outputs[l] of layer l, borrowing the arena. outputs[l] and inputs[l + 1]
+    // are the same memory, and an aliased buffer holds whatever the last layer wrote to it.
+    std::vector<BasicTensor<T>> inputs;
+    std::vector<BasicTensor<T>> outputs;
+
+    // With private_grads, backward() accumulates into grads (weights and biases of every
+    // LINEAR layer back to back) instead of the layers' own grad tensors
+    bool private_grads;
+    std::vector<grad_type> grads;
+    std::vector<size_t> weight_offsets;
+    std::vector<size_t> bias_offsets;
+
+    // Pool the GEMMs of passes on this workspace are split across, see gemm(). Null runs
+    // them on the calling thread, either way the results are the same bits.
+    ThreadPool* pool = nullptr;
+
+    explicit BasicWorkspace(bool private_grads = false) : private_grads(private_grads) {}
+
+    void bind(const BasicModel<T>& model);
+    grad_type* weight_grad(BasicModel<T>& model, int layer);
+    grad_type* bias_grad(BasicModel<T>& model, int layer);
+
+    // Lays out the arenas for batches of up to max_batch rows of input_width features
+    void plan(const BasicModel<T>& model, int max_batch, int input_width);
+    // Points inputs/outputs at the arena for a batch, re-planning only if it does not fit
+    void prepare(const BasicModel<T>& model, int batch_size, int input_width);
+
+    grad_type* grad_buffer(int index) { return grad_arena.data() + grad_offsets[index]; }
+    size_t arena_bytes() const { return arena.size() * sizeof(T) + grad_arena.size() * sizeof(grad_type); }
+
+private:
+    std::vector<T> arena;
+    std::vector<grad_type> grad_arena;
+    std::vector<size_t> value_offsets; // Value k is the input of layer k, the last one the output
+    std::vector<int> value_widths;
+    size_t grad_offsets[2] = {0, 0}; // Two ping-pong buffers
+    int planned_batch = 0;
+    int planned_width = 0;
+    size_t planned_layers = 0;
 };
 
-class Model {
+template <typename T>
+class BasicModel {
 public:
+    using value_type = T;
+
+    std::vector<std::unique_ptr<BasicLayer<T>>> layers;
+    BasicWorkspace<T> workspace; // Used by forward()/backward() when no workspace is given
+
+    // What forward(), backward() and infer() actually run, rebuilt by fuse()
+    std::vector<FusedStep> schedule;
+    bool fusion = true;
+
+    // Workers infer() splits the GEMVs of batches up to GEMV_MAX_ROWS rows across, see
+    // set_inference_team()
+    std::shared_ptr<SpinTeam> inference_team;
+
+    // Checkpoint file the parameters point into, set by load() with LoadMode::MMAP
+    std::shared_ptr<const MappedFile> mapping;
 
-    std::vector<std::unique_ptr<Layer>> layers;
+    // Flat copies of every LINEAR layer's weights and bias (and their gradients) back to back,
+    // in the layout BasicWorkspace::bind() gives private gradients. Empty until
+    // pack_parameters(), after which the layers' tensors borrow them.
+    std::vector<T> parameters;
+    std::vector<acc_t<T>> gradients;
 
-    explicit Model(int num_layers) {
+    explicit BasicModel(int num_layers) {
         layers.reserve(num_layers);
     }
 
@@ -45,13 +159,122 @@ public:
         if (layers.size() >= layers.capacity()) {
             throw std::runtime_error("Trying to add more layers than initially specified");
         }
-        layers.push_back(std::make_unique<Layer>(type, input, output));
+        layers.push_back(std::make_unique<BasicLayer<T>>(type, input, output));
+        fuse();
     }
 
+    // Fusion pass over the layers: LINEAR->RELU and LINEAR->SOFTMAX become one step each
+    // (unless fusion is off), every other layer is a step of its own
+    void fuse() {
+        schedule.clear();
+        const int num_layers = static_cast<int>(layers.size());
+        for (int l = 0; l < num_layers; ++l) {
+            if (layers[l]->layer_type != LayerType::LINEAR) {
+                schedule.push_back({l, 1, Epilogue::NONE});
+                continue;
+            }
+            const LayerType next = l + 1 < num_layers ? layers[l + 1]->layer_type : LayerType::LINEAR;
+            if (fusion && next == LayerType::RELU) {
+                schedule.push_back({l, 2, Epilogue::BIAS_RELU});
+                ++l;
+            } else if (fusion && next == LayerType::SOFTMAX) {
+                schedule.push_back({l, 2, Epilogue::BIAS_SOFTMAX});
+                ++l;
+            } else {
+                schedule.push_back({l, 1, Epilogue::BIAS});
+            }
+        }
+    }
+
+    bool mapped() const { return mapping != nullptr; }
+
+    // Redraws every LINEAR layer's parameters, layer l from rng::INIT_STREAMS + 2 * l (weights)
+    // and + 1 (bias), so the result only depends on the seed and the topology. Drops packed
+    // weights like any other write.
+    void initialize(WeightInit init, uint64_t seed = rng::seed());
+
+    // Moves the parameters and gradients into the flat buffers above, so an optimizer can
+    // update the whole model in one pass. Packing again (e.g. after add_layer) re-lays them out.
+    void pack_parameters();
+    bool packed() const;
+
+    // Builds (PANELS) or drops (ROW_MAJOR) the packed weights infer() uses. Updating the
+    // weights through SGD_step, an optimizer or pack_parameters() drops them, set the layout
+    // again after training; anything else that writes weights must do the same.
+    void set_weight_layout(WeightLayout layout);
+    WeightLayout weight_layout() const;
+
+    // Lets infer() spread single rows and small batches over a spinning thread team, for a
+    // latency-critical path. Callers that find the team busy run alone. Null (the default)
+    // keeps infer() on the calling thread.
+    void set_inference_team(std::shared_ptr<SpinTeam> team) { inference_team = std::move(team); }
+
+    // Writes the topology, dtype and parameters (and optimizer state when given) to a
+    // checkpoint file, see checkpoint.hpp. Throws on I/O errors.
+    void save(const std::string& path, const BasicOptimizerState<T>* optimizer = nullptr) const;
+    // Reads a checkpoint saved from a BasicModel<T>, cast() afterwards for another type.
+    // Optimizer state is copied out when asked for, and cleared if the file has none.
+    static BasicModel load(const std::string& path, LoadMode mode = LoadMode::COPY,
+                           BasicOptimizerState<T>* optimizer = nullptr);
+
+    // Same topology and parameters in another element type, e.g. float64 for gradient checks
+    template <typename U>
+    BasicModel<U> cast() const {
+        BasicModel<U> out(static_cast<int>(layers.capacity()));
+        for (const auto& layer : layers) {
+            auto copy = std::make_unique<BasicLayer<U>>(layer->layer_type, 0, 0);
+            if (layer->weights) {
+                copy->weights = std::make_unique<BasicTensor<U>>(layer->weights->template cast<U>());
+                copy->bias = std::make_unique<BasicTensor<U>>(layer->bias->template cast<U>());
+            }
+            out.layers.push_back(std::move(copy));
+        }
+        out.fusion = fusion;
+        out.fuse();
+        return out;
+    }
 };
 
-// Function declarations
-std::unique_ptr<Tensor> forward(Model& model, const Tensor& input);
-void backward(Model& model, Tensor& pred, const Tensor& act);
+// float32 for training, float64 for gradient checks, bf16 weights/activations with fp32 math
+using Layer = BasicLayer<float>;
+using Workspace = BasicWorkspace<float>;
+using Model = BasicModel<float>;
+using Model64 = BasicModel<double>;
+using ModelBF16 = BasicModel<bf16>;
+
+// Function declarations. forward() returns the workspace's output tensor, valid until the
+// next forward() on the same workspace.
+template <typename T>
+BasicTensor<T>& forward(BasicModel<T>& model, const BasicTensor<T>& input);
+template <typename T>
+BasicTensor<T>& forward(BasicModel<T>& model, const BasicTensor<T>& input, BasicWorkspace<T>& ws);
+// Training forward for a model ending in SOFTMAX: that last softmax and the cross-entropy
+// loss run as one log-sum-exp op on the logits. Returns the loss summed over the rows and
+// leaves the probabilities in the output and their logit gradient, scaled by 1 / total_batch,
+// in its grad, ready for backward().
+template <typename T>
+double forward_loss(BasicModel<T>& model, const BasicTensor<T>& input, const BasicTensor<T>& actual,
+                    BasicWorkspace<T>& ws, int total_batch);
+template <typename T>
+void backward(BasicModel<T>& model, BasicTensor<T>& pred, const BasicTensor<T>& act);
+// Parameter gradients are added to what is there, or overwrite it with accumulate = false
+// (no zero_grad() needed then)
+template <typename T>
+void backward(BasicModel<T>& model, BasicTensor<T>& pred, const BasicTensor<T>& act, BasicWorkspace<T>& ws,
+              bool accumulate = true);
+
+// Inference only: streams activations through two per-thread buffers and writes the result
+// to output (resized to fit, must not be input). Caches nothing and never touches the model,
+// so any number of threads can call it on the same Model at once.
+template <typename T>
+void infer(const BasicModel<T>& model, const BasicTensor<T>& input, BasicTensor<T>& output);
+// Same on a view of the input rows, e.g. a slice of a dataset, read in place. Rows can be
+// strided but each row must be contiguous.
+template <typename T>
+void infer(const BasicModel<T>& model, TensorView<const T> input, BasicTensor<T>& output);
+template <typename T>
+void infer(const BasicModel<T>& model, TensorView<T> input, BasicTensor<T>& output) {
+    infer(model, TensorView<const T>(input), output);
+}
 
 #endif // MODEL_HPP
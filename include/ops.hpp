@@ -0,0 +1,64 @@
+#ifndef OPS_HPP
+#define OPS_HPP
+
+#include "dtype.hpp"
+#include "kernels.hpp"
+#include <cstddef>
+
+// Element-type front end over the kernel tables. float and double go straight to the
+// active KernelTable, bf16 is widened to float per element and rounded back on store.
+// Gradients are always in acc_t<T>.
+namespace ops {
+
+template <typename T>
+void bias_add(T* x, const T* bias, int rows, int cols);
+
+template <typename T>
+void relu_forward(const T* x, T* y, size_t n);
+
+template <typename T>
+void relu_backward(const T* x, const acc_t<T>* dy, acc_t<T>* dx, size_t n);
+
+template <typename T>
+void softmax_rows(const T* x, T* y, int rows, int cols);
+
+template <typename T>
+void cross_entropy_grad(const T* probs, const T* labels, acc_t<T>* grad, int rows, int cols, acc_t<T> scale);
+
+// Fused softmax + cross-entropy on logits, returns the summed loss. probs and grad may be
+// null, probs may alias logits.
+template <typename T>
+double softmax_cross_entropy(const T* logits, const T* labels, T* probs, acc_t<T>* grad, int rows, int cols,
+                             acc_t<T> scale);
+
+// db = beta * db + column sums of dy, with an optional ReLU mask (see KernelTable)
+template <typename T>
+void bias_backward(const acc_t<T>* dy, const T* mask, acc_t<T>* dy_out, acc_t<T>* db, int rows, int cols,
+                   acc_t<T> beta);
+
+// dst += src, on gradients so only float and double
+template <typename T>
+void accumulate(T* dst, const T* src, size_t n);
+
+template <typename T>
+void sgd_update(T* param, const acc_t<T>* grad, acc_t<T> learning_rate, size_t n);
+
+// Optimizer state is in acc_t<T> like the gradients, see KernelTable for the update rules
+template <typename T>
+void momentum_update(T* param, const acc_t<T>* grad, acc_t<T>* velocity, size_t n, acc_t<T> learning_rate,
+                     acc_t<T> momentum, acc_t<T> weight_decay, bool nesterov);
+
+template <typename T>
+void adam_update(T* param, const acc_t<T>* grad, acc_t<T>* m, acc_t<T>* v, size_t n,
+                 const AdamCoefficients<acc_t<T>>& c);
+
+// out = offset + scale * q, e.g. a row of uint8 dataset pixels into a batch
+template <typename T>
+void dequantize_u8(const uint8_t* q, T* out, size_t n, acc_t<T> scale, acc_t<T> offset);
+// Same for int32, e.g. random bits into uniform values
+template <typename T>
+void scale_i32(const int32_t* q, T* out, size_t n, acc_t<T> scale, acc_t<T> offset);
+
+} // namespace ops
+
+#endif // OPS_HPP
@@ -0,0 +1,75 @@
+#ifndef OPTIMIZER_HPP
+#define OPTIMIZER_HPP
+
+#include "model.hpp"
+#include "checkpoint.hpp"
+#include "thread_pool.hpp"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+enum class OptimizerType {
+    SGD = 0,
+    MOMENTUM,
+    NESTEROV,
+    ADAM,
+    ADAMW,
+};
+
+struct OptimizerConfig {
+    OptimizerType type = OptimizerType::SGD;
+    double learning_rate = 0.01;
+    double momentum = 0.9;     // MOMENTUM and NESTEROV
+    double beta1 = 0.9;        // ADAM and ADAMW
+    double beta2 = 0.999;
+    double epsilon = 1e-8;
+    // Added to the gradient as an L2 term, except for ADAMW where it decays the weights directly
+    double weight_decay = 0.0;
+};
+
+// sgd, momentum, nesterov, adam or adamw, with a learning rate that suits it. Throws for
+// anything else.
+OptimizerConfig optimizer_config(const std::string& name);
+const char* optimizer_name(OptimizerType type);
+
+// Updates every LINEAR layer of a model from the gradients in its grad tensors.
+//
+// The model is packed first (see BasicModel::pack_parameters), and the optimizer keeps its
+// own state (velocity, or Adam's m and v) in one flat buffer with the same layout. A step is
+// then a single fused pass over the whole model: for Adam it reads param, grad, m and v once
+// and writes param, m and v once. With a pool, each worker updates its own contiguous slice.
+template <typename T>
+class BasicOptimizer {
+public:
+    // The pool, if given, must outlive the optimizer. Throws for mapped models.
+    BasicOptimizer(BasicModel<T>& model, const OptimizerConfig& config, ThreadPool* pool = nullptr);
+
+    void step() { step(config.learning_rate); }
+    // One update with this learning rate, e.g. from a schedule
+    void step(double learning_rate);
+
+    uint64_t steps() const { return step_count; }
+    // Values of state kept per parameter: 0 for SGD, 1 for momentum, 2 for Adam
+    int state_slots() const { return num_slots; }
+    const OptimizerConfig& settings() const { return config; }
+
+    // For BasicModel::save() and load(); load_state() throws if the state was saved by
+    // another kind of optimizer or for a model of another size
+    BasicOptimizerState<T> state() const;
+    void load_state(const BasicOptimizerState<T>& state);
+
+private:
+    BasicModel<T>& model;
+    OptimizerConfig config;
+    ThreadPool* pool;
+    std::vector<acc_t<T>> slots; // State slot s of parameter i is slots[s * n + i]
+    int num_slots = 0;
+    uint64_t step_count = 0;
+
+    void update(size_t begin, size_t end, acc_t<T> learning_rate);
+};
+
+using Optimizer = BasicOptimizer<float>;
+using OptimizerState = BasicOptimizerState<float>;
+
+#endif // OPTIMIZER_HPP
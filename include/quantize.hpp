@@ -0,0 +1,53 @@
+#ifndef QUANTIZE_HPP
+#define QUANTIZE_HPP
+
+#include "../include/tensor.hpp"
+#include "../include/model.hpp"
+#include "../include/dataset.hpp"
+#include <cstdint>
+#include <vector>
+
+// Post-training int8 quantization of a float model for inference.
+//
+// Weights get one symmetric scale per output channel, w = scale[c] * q with q in [-127, 127].
+// Activations get one affine scale per tensor, x = scale * (q - zero) with q in [0, 127],
+// calibrated from the ranges a float forward pass sees on sample data. Each LINEAR runs as
+// an int8 x int8 -> int32 GEMM. Its bias and the input zero point are folded into an int32
+// offset, and the result is requantized straight to the next layer's input, with a fused
+// ReLU being nothing more than the lower clamp. Only the last layer goes back to float.
+struct QuantizedLinear {
+    int input = 0;
+    int output = 0;
+    int k = 0;                      // input rounded up to INT8_K_ALIGN
+
+    std::vector<int8_t> weights;    // output x k, one row per output channel, zero padded
+    std::vector<float> weight_scale;
+    std::vector<int32_t> offset;    // Bias over the accumulator scale minus zero * sum of the row
+
+    float in_scale = 1.0f;
+    int in_zero = 0;
+
+    bool relu = false;
+    bool last = false;              // Writes float instead of requantizing
+    float out_scale = 1.0f;         // Next layer's input scale, unused for the last layer
+    int out_zero = 0;
+    std::vector<float> multiplier;  // in_scale * weight_scale[c], over out_scale unless last
+};
+
+class QuantizedModel {
+public:
+    std::vector<QuantizedLinear> layers;
+    bool softmax = false; // Model ends in SOFTMAX, infer() then returns probabilities
+
+    // Same contract as infer() on the float model: output is resized to rows x classes
+    void infer(const Tensor& input, Tensor& output) const;
+
+    size_t weight_bytes() const;
+};
+
+// Calibrates activation ranges on the first `samples` rows of the dataset and quantizes
+// every LINEAR layer. Handles stacks of LINEAR layers, each optionally followed by a RELU,
+// with an optional SOFTMAX at the end; throws for anything else.
+QuantizedModel quantize_model(const Model& model, const Dataset& calibration, int samples = 1000);
+
+#endif // QUANTIZE_HPP
@@ -0,0 +1,111 @@
+#ifndef RANDOM_HPP
+#define RANDOM_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+class ThreadPool;
+
+// Counter-based random numbers: Philox4x32-10 (Salmon et al., SC'11). A block of four 32-bit
+// values is a pure function of (seed, stream, block index), so there is no generator state
+// to share or hand out: every tensor, thread and epoch reads its own stream, any element can
+// be computed without the ones before it, and a fill split over any number of threads gives
+// the same values as one thread.
+namespace rng {
+
+constexpr uint64_t DEFAULT_SEED = 0x5eed;
+
+// Stream ids are split into ranges so different uses never read the same stream
+constexpr uint64_t TENSOR_STREAMS = 0;           // next_stream(): tensors in creation order
+constexpr uint64_t INIT_STREAMS = 1ull << 56;    // + 2 * layer (+ 1 for the bias): initialize()
+constexpr uint64_t SHUFFLE_STREAMS = 2ull << 56; // + epoch: dataset permutations
+
+// The seed every stream is keyed by unless given one, DEFAULT_SEED until set. Set it before
+// creating tensors, it also restarts next_stream().
+void set_seed(uint64_t seed);
+uint64_t seed();
+// A fresh TENSOR_STREAMS id for each call, so runs that create the same tensors in the same
+// order get the same values
+uint64_t next_stream();
+
+// The four values of block `block` of `stream`
+inline void philox(uint64_t seed, uint64_t stream, uint64_t block, uint32_t out[4]) {
+    uint32_t c0 = static_cast<uint32_t>(block), c1 = static_cast<uint32_t>(block >> 32);
+    uint32_t c2 = static_cast<uint32_t>(stream), c3 = static_cast<uint32_t>(stream >> 32);
+    uint32_t k0 = static_cast<uint32_t>(seed), k1 = static_cast<uint32_t>(seed >> 32);
+    for (int round = 0; round < 10; ++round) {
+        const uint64_t p0 = 0xD2511F53ull * c0;
+        const uint64_t p1 = 0xCD9E8D57ull * c2;
+        const uint32_t n0 = static_cast<uint32_t>(p1 >> 32) ^ c1 ^ k0;
+        const uint32_t n2 = static_cast<uint32_t>(p0 >> 32) ^ c3 ^ k1;
+        c0 = n0;
+        c1 = static_cast<uint32_t>(p1);
+        c2 = n2;
+        c3 = static_cast<uint32_t>(p0);
+        k0 += 0x9E3779B9u;
+        k1 += 0xBB67AE85u;
+    }
+    out[0] = c0;
+    out[1] = c1;
+    out[2] = c2;
+    out[3] = c3;
+}
+
+// 32 random bits to a double in (0, 1), never exactly 0 so log() is safe. The bits are read
+// as a signed int, so the fills can convert them with the SIMD int32 instructions.
+inline double to_unit(uint32_t bits) {
+    return (static_cast<int32_t>(bits) + 2147483648.5) * (1.0 / 4294967296.0);
+}
+
+// Sequential reader over one stream (e.g. one per thread) for draws that are not a fill
+class Stream {
+public:
+    explicit Stream(uint64_t stream, uint64_t seed = rng::seed()) : key(seed), id(stream) {}
+
+    uint32_t next_u32() {
+        if (used == 4) {
+            philox(key, id, block++, buffer);
+            used = 0;
+        }
+        return buffer[used++];
+    }
+
+    double uniform() { return to_unit(next_u32()); }
+
+    // Uniform in [0, n) without modulo bias (Lemire's multiply and reject)
+    uint32_t below(uint32_t n) {
+        uint64_t m = static_cast<uint64_t>(next_u32()) * n;
+        if (static_cast<uint32_t>(m) < n) {
+            const uint32_t threshold = (0u - n) % n;
+            while (static_cast<uint32_t>(m) < threshold) {
+                m = static_cast<uint64_t>(next_u32()) * n;
+            }
+        }
+        return static_cast<uint32_t>(m >> 32);
+    }
+
+private:
+    uint64_t key;
+    uint64_t id;
+    uint64_t block = 0;
+    uint32_t buffer[4] = {0, 0, 0, 0};
+    int used = 4;
+};
+
+// out[i] is value i of the stream mapped to [lo, hi] (rounding to T may reach hi), or for
+// fill_normal the cosine (even i) or sine (odd i) half of a Box-Muller pair on values i & ~1
+// and (i & ~1) + 1. Either way out[i] depends on i alone, so with a pool the fill is split
+// over its workers and still gives the same values.
+template <typename T>
+void fill_uniform(T* out, size_t n, double lo, double hi, uint64_t stream, uint64_t seed = rng::seed(),
+                  ThreadPool* pool = nullptr);
+template <typename T>
+void fill_normal(T* out, size_t n, double mean, double stddev, uint64_t stream, uint64_t seed = rng::seed(),
+                 ThreadPool* pool = nullptr);
+
+// Fisher-Yates over values[0, n), the same permutation for a (seed, stream) on any machine
+void shuffle(int* values, size_t n, uint64_t stream, uint64_t seed = rng::seed());
+
+} // namespace rng
+
+#endif // RANDOM_HPP
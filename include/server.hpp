@@ -0,0 +1,86 @@
+#ifndef SERVER_HPP
+#define SERVER_HPP
+
+#include "model.hpp"
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct ServerConfig {
+    int max_batch = 64;      // Most requests run through one infer()
+    int max_delay_us = 2000; // Longest the oldest queued request waits for others to join it
+};
+
+struct ServerStats {
+    uint64_t requests = 0;
+    uint64_t batches = 0;
+    double mean_batch = 0.0;
+    // Time from submit() to the scores being ready, over the last LATENCY_WINDOW requests
+    double p50_us = 0.0;
+    double p99_us = 0.0;
+    double requests_per_second = 0.0; // Since the server started
+};
+
+// Dynamic batching in front of infer(). Any number of threads submit single rows; one
+// batcher thread runs whatever is queued as one batch as soon as max_batch rows are waiting
+// or the oldest has waited max_delay_us, whichever comes first. A longer delay gives bigger,
+// more efficient batches at the cost of latency under light load.
+class InferenceServer {
+public:
+    static constexpr size_t LATENCY_WINDOW = 65536;
+
+    // The model must outlive the server and not change while it runs
+    InferenceServer(const Model& model, const ServerConfig& config);
+    // Answers everything still queued, then stops the batcher
+    ~InferenceServer();
+
+    InferenceServer(const InferenceServer&) = delete;
+    InferenceServer& operator=(const InferenceServer&) = delete;
+
+    int input_width() const { return inputs; }
+    int output_width() const { return outputs; }
+    const ServerConfig& settings() const { return config; }
+
+    // Queues one row of input_width() features, throws for any other size. The future gets
+    // the output_width() class scores.
+    std::future<std::vector<float>> submit(std::vector<float> features);
+
+    ServerStats stats() const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Request {
+        std::vector<float> features;
+        std::promise<std::vector<float>> scores;
+        Clock::time_point queued;
+    };
+
+    const Model& model;
+    ServerConfig config;
+    int inputs = 0;
+    int outputs = 0;
+
+    mutable std::mutex mutex;
+    std::condition_variable ready;
+    std::deque<Request> queue;
+    bool stopping = false;
+
+    // Ring of the last LATENCY_WINDOW latencies in microseconds, guarded by mutex
+    std::vector<double> latencies;
+    size_t next_latency = 0;
+    uint64_t requests = 0;
+    uint64_t batches = 0;
+    Clock::time_point started;
+
+    std::thread batcher;
+
+    void batch_loop();
+};
+
+#endif // SERVER_HPP
@@ -0,0 +1,407 @@
+#ifndef STATIC_MODEL_HPP
+#define STATIC_MODEL_HPP
+
+#include "model.hpp"
+#include "gemm.hpp"
+#include "ops.hpp"
+#include <array>
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Layers of a StaticModel, sizes are part of the type
+template <int In, int Out>
+struct Linear {
+    static_assert(In > 0 && Out > 0, "Linear sizes must be positive");
+    static constexpr LayerType type = LayerType::LINEAR;
+    static constexpr int input = In;
+    static constexpr int output = Out;
+};
+
+struct ReLU {
+    static constexpr LayerType type = LayerType::RELU;
+    static constexpr int input = 0; // Same width as whatever comes before
+    static constexpr int output = 0;
+};
+
+struct Softmax {
+    static constexpr LayerType type = LayerType::SOFTMAX;
+    static constexpr int input = 0;
+    static constexpr int output = 0;
+};
+
+namespace static_model {
+
+// Everything BasicModel works out at runtime (widths, fused steps, parameter layout), done
+// by the compiler for a fixed list of layers
+template <typename... Layers>
+struct Plan {
+    static constexpr int num_layers = sizeof...(Layers);
+    static constexpr std::array<LayerType, num_layers> types = {Layers::type...};
+    static constexpr std::array<int, num_layers> ins = {Layers::input...};
+    static constexpr std::array<int, num_layers> outs = {Layers::output...};
+
+    // widths[l] is the input width of layer l, widths[num_layers] the model output
+    static constexpr std::array<int, num_layers + 1> make_widths() {
+        std::array<int, num_layers + 1> w{};
+        w[0] = ins[0];
+        for (int l = 0; l < num_layers; ++l) {
+            w[l + 1] = types[l] == LayerType::LINEAR ? outs[l] : w[l];
+        }
+        return w;
+    }
+    static constexpr std::array<int, num_layers + 1> widths = make_widths();
+
+    static constexpr bool dims_match() {
+        for (int l = 0; l < num_layers; ++l) {
+            if (types[l] == LayerType::LINEAR && ins[l] != widths[l]) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Same fusion as BasicModel::fuse(): LINEAR->RELU and LINEAR->SOFTMAX are one step
+    struct Steps {
+        int count = 0;
+        std::array<int, num_layers> first{};
+        std::array<int, num_layers> layers{};
+        std::array<Epilogue, num_layers> epilogue{};
+    };
+    static constexpr Steps make_steps() {
+        Steps s;
+        for (int l = 0; l < num_layers; ++l) {
+            const LayerType next = l + 1 < num_layers ? types[l + 1] : LayerType::LINEAR;
+            s.first[s.count] = l;
+            s.layers[s.count] = 1;
+            s.epilogue[s.count] = Epilogue::NONE;
+            if (types[l] == LayerType::LINEAR) {
+                s.epilogue[s.count] = next == LayerType::RELU      ? Epilogue::BIAS_RELU
+                                      : next == LayerType::SOFTMAX ? Epilogue::BIAS_SOFTMAX
+                                                                   : Epilogue::BIAS;
+                s.layers[s.count] = s.epilogue[s.count] == Epilogue::BIAS ? 1 : 2;
+            }
+            l += s.layers[s.count] - 1;
+            ++s.count;
+        }
+        return s;
+    }
+    static constexpr Steps steps = make_steps();
+    static constexpr int num_steps = steps.count;
+
+    // Width of the value step s reads (s) or writes (s + 1)
+    static constexpr int value_width(int s) {
+        return s < num_steps ? widths[steps.first[s]] : widths[num_layers];
+    }
+
+    // Activations per batch row before value v in the arena
+    static constexpr size_t value_offset(int v) {
+        size_t offset = 0;
+        for (int i = 0; i < v; ++i) {
+            offset += value_width(i);
+        }
+        return offset;
+    }
+
+    static constexpr int max_width() {
+        int w = 0;
+        for (int l = 0; l <= num_layers; ++l) {
+            w = w > widths[l] ? w : widths[l];
+        }
+        return w;
+    }
+
+    // Weights then bias of every LINEAR, the layout of BasicModel::pack_parameters()
+    static constexpr size_t weight_offset(int layer) {
+        size_t offset = 0;
+        for (int l = 0; l < layer; ++l) {
+            offset += types[l] == LayerType::LINEAR ? static_cast<size_t>(ins[l]) * outs[l] + outs[l] : 0;
+        }
+        return offset;
+    }
+    static constexpr size_t bias_offset(int layer) {
+        return weight_offset(layer) + static_cast<size_t>(ins[layer]) * outs[layer];
+    }
+    static constexpr size_t parameter_count = weight_offset(num_layers);
+};
+
+} // namespace static_model
+
+// A network whose topology is fixed at compile time, e.g.
+//
+//   StaticModel<Linear<784, 500>, ReLU, Linear<500, 100>, ReLU, Linear<100, 10>, Softmax>
+//
+// It runs the same GEMMs, fused epilogues and ops as BasicModel and gives the same results,
+// but every width, offset and fusion decision is a constant: no switch on LayerType, no
+// shapes read from tensors. Parameters sit in one flat buffer in the layout of
+// BasicModel::pack_parameters(), activations in one arena sized by the batch.
+// Convert from and to a BasicModel for checkpoints.
+template <typename T, typename... Layers>
+class BasicStaticModel {
+    static_assert(sizeof...(Layers) > 0, "A StaticModel needs at least one layer");
+    using P = static_model::Plan<Layers...>;
+    static_assert(P::types[0] == LayerType::LINEAR, "A StaticModel must start with a Linear layer");
+    static_assert(P::dims_match(), "Linear input size does not match the output of the layer before it");
+
+public:
+    using value_type = T;
+    using grad_type = acc_t<T>;
+
+    static constexpr int num_layers = P::num_layers;
+    static constexpr int input_width = P::widths[0];
+    static constexpr int output_width = P::widths[P::num_layers];
+    static constexpr size_t parameter_count = P::parameter_count;
+
+    std::vector<T> parameters;
+    std::vector<grad_type> gradients;
+
+    // Randomly initialized like the layers of a BasicModel
+    BasicStaticModel() : BasicStaticModel(make_model()) {}
+
+    // Copies the parameters of a model with this topology, throws for any other
+    explicit BasicStaticModel(const BasicModel<T>& model)
+        : parameters(parameter_count), gradients(parameter_count, grad_type(0)) {
+        for_linear(model, [&](const BasicLayer<T>& layer, int l) {
+            std::copy(layer.weights->data.begin(), layer.weights->data.end(), weights(l));
+            std::copy(layer.bias->data.begin(), layer.bias->data.end(), bias(l));
+        });
+    }
+
+    // Writes the parameters into a model with this topology, e.g. to save() it
+    void copy_to(BasicModel<T>& model) const {
+        if (model.mapped()) {
+            throw std::runtime_error("Cannot write into a model mapped from a checkpoint, load it with LoadMode::COPY");
+        }
+        for_linear(model, [&](BasicLayer<T>& layer, int l) {
+            std::copy(weights(l), weights(l) + layer.weights->total_size, layer.weights->data.begin());
+            std::copy(bias(l), bias(l) + layer.bias->total_size, layer.bias->data.begin());
+        });
+        model.set_weight_layout(WeightLayout::ROW_MAJOR);
+    }
+
+    BasicModel<T> to_model() const {
+        BasicModel<T> model = make_model();
+        copy_to(model);
+        return model;
+    }
+
+    T* weights(int layer) { return parameters.data() + P::weight_offset(layer); }
+    const T* weights(int layer) const { return parameters.data() + P::weight_offset(layer); }
+    T* bias(int layer) { return parameters.data() + P::bias_offset(layer); }
+    const T* bias(int layer) const { return parameters.data() + P::bias_offset(layer); }
+
+    // Output of the forward pass, valid until the next forward() or forward_loss()
+    const BasicTensor<T>& forward(const BasicTensor<T>& input) {
+        const int batch = check_input(input);
+        prepare(batch);
+        std::copy(input.data.begin(), input.data.begin() + input.total_size, value(0));
+        run_steps<0, P::num_steps>(batch);
+        return output;
+    }
+
+    // Same as the free forward_loss(): the final softmax and the cross-entropy run as one op,
+    // leaving probabilities in the output and their logit gradient (scaled by 1 / total_batch)
+    // ready for backward(). Returns the loss summed over the rows.
+    double forward_loss(const BasicTensor<T>& input, const BasicTensor<T>& actual, int total_batch) {
+        static_assert(P::types[P::num_layers - 1] == LayerType::SOFTMAX, "forward_loss needs a model ending in Softmax");
+        const int batch = check_input(input);
+        if (static_cast<size_t>(batch) != actual.total_size) {
+            throw std::runtime_error("Invalid dims for softmax cross entropy. Predicted: " + std::to_string(batch) +
+                                     " Actual: " + std::to_string(actual.total_size));
+        }
+        prepare(batch);
+        std::copy(input.data.begin(), input.data.begin() + input.total_size, value(0));
+        run_steps<0, P::num_steps - 1>(batch);
+
+        constexpr int last = P::num_steps - 1;
+        T* out = value(P::num_steps);
+        const T* logits = value(last);
+        if constexpr (P::steps.layers[last] == 2) {
+            constexpr int l = P::steps.first[last];
+            gemm(Transpose::NO, Transpose::NO, batch, output_width, P::widths[l],
+                 1.0, value(last), P::widths[l], weights(l), output_width,
+                 0.0, out, output_width, Epilogue::BIAS, bias(l));
+            logits = out;
+        }
+        return ops::softmax_cross_entropy(logits, actual.data.data(), out, grad_buffer(0), batch, output_width,
+                                          grad_type(1) / total_batch);
+    }
+
+    // Gradients of the last forward_loss() into gradients, added to what is there or
+    // overwriting it with accumulate = false
+    void backward(bool accumulate = true) {
+        const grad_type* grad = grad_buffer(0);
+        backward_steps<P::num_steps - 1>(accumulate ? grad_type(1) : grad_type(0), grad);
+    }
+
+    void zero_grad() { std::fill(gradients.begin(), gradients.end(), grad_type(0)); }
+
+    void sgd_step(double learning_rate) {
+        ops::sgd_update(parameters.data(), gradients.data(), static_cast<grad_type>(learning_rate), parameter_count);
+    }
+
+    // Like the free infer(): two per-thread buffers, never touches the model, so any number
+    // of threads can call it at once
+    void infer(const BasicTensor<T>& input, BasicTensor<T>& result) const {
+        const int batch = check_input(input);
+        result.resize(batch, output_width);
+        thread_local std::vector<T> ping, pong;
+        const size_t needed = static_cast<size_t>(batch) * P::max_width();
+        if (ping.size() < needed) {
+            ping.resize(needed);
+            pong.resize(needed);
+        }
+        infer_steps<0>(batch, input.data.data(), ping.data(), pong.data(), result.data.data());
+    }
+
+private:
+    std::vector<T> activations; // Value v (input of step v) at rows * value_offset(v)
+    std::vector<grad_type> grads; // Two ping-pong buffers of rows * max_width
+    BasicTensor<T> output{std::vector<int>{0, 0}};
+    int planned_batch = 0;
+    int batch_rows = 0;
+
+    static BasicModel<T> make_model() {
+        BasicModel<T> model(num_layers);
+        for (int l = 0; l < num_layers; ++l) {
+            const bool linear = P::types[l] == LayerType::LINEAR;
+            model.add_layer(P::types[l], linear ? P::ins[l] : P::widths[l], linear ? P::outs[l] : P::widths[l]);
+        }
+        return model;
+    }
+
+    template <typename Model, typename F>
+    static void for_linear(Model& model, F f) {
+        if (model.layers.size() != static_cast<size_t>(num_layers)) {
+            throw std::runtime_error("Model has " + std::to_string(model.layers.size()) + " layers, expected " +
+                                     std::to_string(num_layers));
+        }
+        for (int l = 0; l < num_layers; ++l) {
+            auto& layer = *model.layers[l];
+            if (layer.layer_type != P::types[l]) {
+                throw std::runtime_error("Layer " + std::to_string(l) + " of the model has another type");
+            }
+            if (layer.layer_type == LayerType::LINEAR) {
+                if (layer.weights->shape[0] != P::ins[l] || layer.weights->shape[1] != P::outs[l]) {
+                    throw std::runtime_error("Layer " + std::to_string(l) + " is " +
+                                             std::to_string(layer.weights->shape[0]) + "x" +
+                                             std::to_string(layer.weights->shape[1]) + ", expected " +
+                                             std::to_string(P::ins[l]) + "x" + std::to_string(P::outs[l]));
+                }
+                f(layer, l);
+            }
+        }
+    }
+
+    static int check_input(const BasicTensor<T>& input) {
+        if (input.ndim != 2 || input.shape[1] != input_width) {
+            throw std::runtime_error("Invalid input width " + std::to_string(input.shape.back()) +
+                                     " for a model expecting " + std::to_string(input_width));
+        }
+        return input.shape[0];
+    }
+
+    // Only grows, so steady-state steps allocate nothing
+    void prepare(int batch) {
+        if (batch > planned_batch) {
+            planned_batch = batch;
+            activations.assign(static_cast<size_t>(batch) * P::value_offset(P::num_steps + 1), T(0));
+            grads.assign(2 * static_cast<size_t>(batch) * P::max_width(), grad_type(0));
+        }
+        batch_rows = batch;
+        output.borrow(value(P::num_steps), grad_buffer(0), batch, output_width);
+    }
+
+    T* value(int v) { return activations.data() + static_cast<size_t>(planned_batch) * P::value_offset(v); }
+    grad_type* grad_buffer(int index) { return grads.data() + index * static_cast<size_t>(planned_batch) * P::max_width(); }
+
+    template <int S, int End>
+    void run_steps(int batch) {
+        if constexpr (S < End) {
+            constexpr int l = P::steps.first[S];
+            constexpr int in = P::value_width(S);
+            constexpr int out = P::value_width(S + 1);
+            const T* x = value(S);
+            T* y = value(S + 1);
+            if constexpr (P::types[l] == LayerType::LINEAR) {
+                gemm(Transpose::NO, Transpose::NO, batch, out, in, 1.0, x, in, weights(l), out,
+                     0.0, y, out, P::steps.epilogue[S], bias(l));
+            } else if constexpr (P::types[l] == LayerType::RELU) {
+                ops::relu_forward(x, y, static_cast<size_t>(batch) * out);
+            } else {
+                ops::softmax_rows(x, y, batch, out);
+            }
+            run_steps<S + 1, End>(batch);
+        }
+    }
+
+    // Mirrors the free backward(), ping-ponging between the two gradient buffers
+    template <int S>
+    void backward_steps(grad_type beta, const grad_type* grad) {
+        if constexpr (S >= 0) {
+            constexpr int l = P::steps.first[S];
+            constexpr int in = P::value_width(S);
+            constexpr int out = P::value_width(S + 1);
+            const int batch = batch_rows;
+            grad_type* next = grad == grad_buffer(0) ? grad_buffer(1) : grad_buffer(0);
+            if constexpr (P::types[l] == LayerType::LINEAR) {
+                grad_type* bias_grad = gradients.data() + P::bias_offset(l);
+                if constexpr (P::steps.epilogue[S] == Epilogue::BIAS_RELU) {
+                    ops::bias_backward(grad, value(S + 1), next, bias_grad, batch, out, beta);
+                    grad = next;
+                    next = grad == grad_buffer(0) ? grad_buffer(1) : grad_buffer(0);
+                } else {
+                    ops::bias_backward(grad, static_cast<const T*>(nullptr), static_cast<grad_type*>(nullptr),
+                                       bias_grad, batch, out, beta);
+                }
+                gemm(Transpose::YES, Transpose::NO, in, out, batch, 1.0, value(S), in, grad, out,
+                     beta, gradients.data() + P::weight_offset(l), out);
+                if constexpr (S > 0) {
+                    gemm(Transpose::NO, Transpose::YES, batch, in, out, 1.0, grad, out, weights(l), out,
+                         0.0, next, in);
+                    grad = next;
+                }
+            } else if constexpr (P::types[l] == LayerType::RELU) {
+                ops::relu_backward(value(S + 1), grad, next, static_cast<size_t>(batch) * out);
+                grad = next;
+            }
+            // A final SOFTMAX already has its gradient from forward_loss()
+            backward_steps<S - 1>(beta, grad);
+        }
+    }
+
+    template <int S>
+    void infer_steps(int batch, const T* x, T* ping, T* pong, T* result) const {
+        if constexpr (S < P::num_steps) {
+            constexpr int l = P::steps.first[S];
+            constexpr int in = P::value_width(S);
+            constexpr int out = P::value_width(S + 1);
+            T* y = S + 1 == P::num_steps ? result : (x == ping ? pong : ping);
+            if constexpr (P::types[l] == LayerType::LINEAR) {
+                // Small batches take the GEMV like Model's infer(), so results stay identical
+                bool small = false;
+                if constexpr (std::is_same<T, acc_t<T>>::value) {
+                    if (batch <= GEMV_MAX_ROWS) {
+                        gemv(batch, out, in, x, in, weights(l), out, y, out, P::steps.epilogue[S], bias(l));
+                        small = true;
+                    }
+                }
+                if (!small) {
+                    gemm(Transpose::NO, Transpose::NO, batch, out, in, 1.0, x, in, weights(l), out,
+                         0.0, y, out, P::steps.epilogue[S], bias(l));
+                }
+            } else if constexpr (P::types[l] == LayerType::RELU) {
+                ops::relu_forward(x, y, static_cast<size_t>(batch) * out);
+            } else {
+                ops::softmax_rows(x, y, batch, out);
+            }
+            infer_steps<S + 1>(batch, y, ping, pong, result);
+        }
+    }
+};
+
+template <typename... Layers>
+using StaticModel = BasicStaticModel<float, Layers...>;
+
+#endif // STATIC_MODEL_HPP
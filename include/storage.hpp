@@ -0,0 +1,107 @@
+#ifndef STORAGE_HPP
+#define STORAGE_HPP
+
+#include <cstddef>
+#include <stdexcept>
+#include <vector>
+
+// Flat element buffer behind a Tensor. Owns its memory like a std::vector by default, but
+// can also borrow memory that lives somewhere else (a workspace arena, a mapped file). A
+// borrowed Storage never allocates or frees; copying one always makes an owning copy.
+template <typename T>
+class Storage {
+public:
+    Storage() = default;
+    explicit Storage(size_t n, const T& value = T()) : owned(n, value) { sync(); }
+
+    Storage(const Storage& other) : owned(other.begin(), other.end()) { sync(); }
+    Storage(Storage&& other) noexcept { take(other); }
+
+    Storage& operator=(const Storage& other) {
+        if (this != &other) {
+            owned.assign(other.begin(), other.end());
+            borrowed = false;
+            sync();
+        }
+        return *this;
+    }
+
+    Storage& operator=(Storage&& other) noexcept {
+        if (this != &other) {
+            take(other);
+        }
+        return *this;
+    }
+
+    // Points at n elements owned by the caller, who keeps them alive. Drops owned memory.
+    void borrow(T* data, size_t n) {
+        if (!borrowed) {
+            std::vector<T>().swap(owned);
+        }
+        borrowed = true;
+        ptr = data;
+        count = n;
+        capacity = n;
+    }
+
+    bool is_borrowed() const { return borrowed; }
+
+    // A borrowed Storage can only shrink or regrow within what it was given
+    void resize(size_t n, const T& value = T()) {
+        if (borrowed) {
+            if (n > capacity) {
+                throw std::length_error("Cannot grow borrowed storage");
+            }
+            for (size_t i = count; i < n; ++i) {
+                ptr[i] = value;
+            }
+            count = n;
+        } else {
+            owned.resize(n, value);
+            sync();
+        }
+    }
+
+    T* data() { return ptr; }
+    const T* data() const { return ptr; }
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+
+    T& operator[](size_t i) { return ptr[i]; }
+    const T& operator[](size_t i) const { return ptr[i]; }
+
+    T* begin() { return ptr; }
+    T* end() { return ptr + count; }
+    const T* begin() const { return ptr; }
+    const T* end() const { return ptr + count; }
+
+private:
+    std::vector<T> owned;
+    T* ptr = nullptr;
+    size_t count = 0;
+    size_t capacity = 0;
+    bool borrowed = false;
+
+    void sync() {
+        ptr = owned.data();
+        count = owned.size();
+        capacity = owned.size();
+    }
+
+    void take(Storage& other) {
+        owned = std::move(other.owned);
+        borrowed = other.borrowed;
+        if (borrowed) {
+            ptr = other.ptr;
+            count = other.count;
+            capacity = other.capacity;
+        } else {
+            sync();
+        }
+        other.owned.clear();
+        other.borrowed = false;
+        other.sync();
+    }
+};
+
+#endif // STORAGE_HPP
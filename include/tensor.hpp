@@ -1,52 +1,105 @@
 #ifndef TENSOR_HPP
 #define TENSOR_HPP
 
+#include "dtype.hpp"
+#include "storage.hpp"
+#include "tensor_view.hpp"
 #include <vector>
 #include <memory>
-#include <random>
+#include <type_traits>
 
-class Tensor {
+// T is the storage type of data, grad is kept in acc_t<T> (float for bf16)
+template <typename T>
+class BasicTensor {
 public:
-    std::vector<double> data;
-    std::vector<double> grad;
+    using value_type = T;
+    using grad_type = acc_t<T>;
+
+    Storage<T> data;
+    Storage<grad_type> grad;
     std::vector<int> shape;
     int ndim;
     size_t total_size;
     bool require_grad;
 
     // Constructors
-    Tensor(const std::vector<int>& shape, bool require_grad = false);
-    Tensor(const std::vector<int>& shape, bool require_grad, bool randomize);
+    BasicTensor(const std::vector<int>& shape, bool require_grad = false);
+    // randomize fills U(-1, 1) from the next rng:: tensor stream (see random.hpp), so the
+    // values only depend on the seed and the order tensors are created in
+    BasicTensor(const std::vector<int>& shape, bool require_grad, bool randomize);
 
     // Copy constructor
-    Tensor(const Tensor& other);
+    BasicTensor(const BasicTensor& other);
 
     // Move constructor
-    Tensor(Tensor&& other) noexcept;
+    BasicTensor(BasicTensor&& other) noexcept;
 
     // Copy assignment operator
-    Tensor& operator=(const Tensor& other);
+    BasicTensor& operator=(const BasicTensor& other);
 
     // Move assignment operator
-    Tensor& operator=(Tensor&& other) noexcept;
+    BasicTensor& operator=(BasicTensor&& other) noexcept;
 
     // Destructor
-    ~Tensor() = default;
+    ~BasicTensor() = default;
+
+    // Points data (and grad, when given) at rows x cols elements owned elsewhere, e.g. a
+    // workspace arena. Does not allocate once the tensor is 2-D.
+    void borrow(T* data_ptr, grad_type* grad_ptr, int rows, int cols);
+
+    // Makes this a rows x cols tensor in place, only allocating when it grows past the
+    // largest size it has had
+    void resize(int rows, int cols);
+
+    // Zero-copy views of data (not grad) in this shape, see tensor_view.hpp. Valid until the
+    // tensor is resized or destroyed.
+    TensorView<T> view() { return TensorView<T>(data.data(), shape.data(), ndim); }
+    TensorView<const T> view() const { return TensorView<const T>(data.data(), shape.data(), ndim); }
 
     // Utility functions
     void print() const;
-    Tensor reshape(const std::vector<int>& new_shape) const;
-    double& operator()(const std::vector<int>& indices);
-    const double& operator()(const std::vector<int>& indices) const;
+    // Owning copy in another shape, view().reshape() gives the same without copying
+    BasicTensor reshape(const std::vector<int>& new_shape) const;
+    T& operator()(const std::vector<int>& indices);
+    const T& operator()(const std::vector<int>& indices) const;
+
+    // Same as the vector forms without building a vector, e.g. t(i, j)
+    template <typename... I, typename = std::enable_if_t<(std::is_integral<I>::value && ...)>>
+    T& operator()(I... indices) {
+        return view().at(indices...);
+    }
+    template <typename... I, typename = std::enable_if_t<(std::is_integral<I>::value && ...)>>
+    const T& operator()(I... indices) const {
+        return view().at(indices...);
+    }
+
+    // Converting copy, e.g. a float64 copy of float32 weights for gradient checks
+    template <typename U>
+    BasicTensor<U> cast() const {
+        BasicTensor<U> out(shape, require_grad);
+        for (size_t i = 0; i < total_size; ++i) {
+            out.data[i] = U(static_cast<acc_t<T>>(data[i]));
+        }
+        for (size_t i = 0; i < grad.size(); ++i) {
+            out.grad[i] = static_cast<acc_t<U>>(grad[i]);
+        }
+        return out;
+    }
 
     // Static factory methods
-    static std::unique_ptr<Tensor> zeros(const std::vector<int>& shape);
-    static std::unique_ptr<Tensor> ones(const std::vector<int>& shape);
-    static std::unique_ptr<Tensor> random(const std::vector<int>& shape, double min = 0.0, double max = 1.0);
+    static std::unique_ptr<BasicTensor> zeros(const std::vector<int>& shape);
+    static std::unique_ptr<BasicTensor> ones(const std::vector<int>& shape);
+    // U(min, max) from the next rng:: tensor stream
+    static std::unique_ptr<BasicTensor> random(const std::vector<int>& shape, double min = 0.0, double max = 1.0);
 
 private:
     void initialize(bool randomize);
     size_t calculate_index(const std::vector<int>& indices) const;
 };
 
-#endif // TENSOR_HPP
\ No newline at end of file
+// float32 for training, float64 for gradient checks, bf16 for storage
+using Tensor = BasicTensor<float>;
+using Tensor64 = BasicTensor<double>;
+using TensorBF16 = BasicTensor<bf16>;
+
+#endif // TENSOR_HPP
@@ -0,0 +1,185 @@
+#ifndef TENSOR_VIEW_HPP
+#define TENSOR_VIEW_HPP
+
+#include <array>
+#include <cstddef>
+#include <initializer_list>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+// Up to this many dimensions, so a view is a fixed size value with no heap memory
+constexpr int MAX_VIEW_DIMS = 4;
+
+// Shape and strides (in elements) over memory owned by someone else: a Tensor, a Storage, a
+// dataset. Reshape (of contiguous views), slice, transpose and broadcast only touch the
+// metadata, nothing is copied. Use TensorView<const T> for read-only views, a TensorView<T>
+// converts to one.
+//
+// The owner must outlive the view and must not reallocate under it.
+template <typename T>
+class TensorView {
+public:
+    using value_type = std::remove_const_t<T>;
+
+    TensorView() = default;
+
+    // Contiguous row-major view of data
+    TensorView(T* data, std::initializer_list<int> dims)
+        : TensorView(data, dims.begin(), static_cast<int>(dims.size())) {}
+
+    TensorView(T* data, const int* dims, int num_dims) : ptr(data), ndim(num_dims) {
+        if (ndim < 1 || ndim > MAX_VIEW_DIMS) {
+            throw std::invalid_argument("TensorView supports 1 to " + std::to_string(MAX_VIEW_DIMS) + " dimensions");
+        }
+        for (int d = 0; d < ndim; ++d) {
+            extents[d] = dims[d];
+        }
+        set_contiguous_strides();
+    }
+
+    // Same view, read-only
+    template <typename U = T, typename = std::enable_if_t<!std::is_const<U>::value>>
+    operator TensorView<const U>() const {
+        TensorView<const U> v;
+        v.ptr = ptr;
+        v.ndim = ndim;
+        v.extents = extents;
+        v.strides = strides;
+        return v;
+    }
+
+    T* data() const { return ptr; }
+    int dims() const { return ndim; }
+    int size(int dim) const { return extents[dim]; }
+    ptrdiff_t stride(int dim) const { return strides[dim]; }
+
+    size_t numel() const {
+        size_t n = 1;
+        for (int d = 0; d < ndim; ++d) {
+            n *= static_cast<size_t>(extents[d]);
+        }
+        return n;
+    }
+
+    // Row-major with no gaps, e.g. what a plain pointer loop or reshape() needs
+    bool contiguous() const {
+        ptrdiff_t expected = 1;
+        for (int d = ndim - 1; d >= 0; --d) {
+            if (extents[d] != 1 && strides[d] != expected) {
+                return false;
+            }
+            expected *= extents[d];
+        }
+        return true;
+    }
+
+    // Unchecked element access, one index per dimension. Debug builds check the indices.
+    template <typename... I>
+    T& operator()(I... indices) const {
+        static_assert(sizeof...(I) >= 1 && sizeof...(I) <= MAX_VIEW_DIMS, "Takes 1 to MAX_VIEW_DIMS indices");
+#ifdef DEBUG
+        return at(indices...);
+#else
+        const ptrdiff_t idx[] = {static_cast<ptrdiff_t>(indices)...};
+        ptrdiff_t offset = 0;
+        for (size_t d = 0; d < sizeof...(I); ++d) {
+            offset += idx[d] * strides[d];
+        }
+        return ptr[offset];
+#endif
+    }
+
+    // Same, throwing for a wrong number of indices or one out of bounds
+    template <typename... I>
+    T& at(I... indices) const {
+        static_assert(sizeof...(I) >= 1 && sizeof...(I) <= MAX_VIEW_DIMS, "Takes 1 to MAX_VIEW_DIMS indices");
+        if (static_cast<int>(sizeof...(I)) != ndim) {
+            throw std::invalid_argument("Number of indices does not match tensor dimensions");
+        }
+        const ptrdiff_t idx[] = {static_cast<ptrdiff_t>(indices)...};
+        ptrdiff_t offset = 0;
+        for (int d = 0; d < ndim; ++d) {
+            if (idx[d] < 0 || idx[d] >= extents[d]) {
+                throw std::out_of_range("Index out of bounds");
+            }
+            offset += idx[d] * strides[d];
+        }
+        return ptr[offset];
+    }
+
+    // Same elements in another shape, only for contiguous views
+    TensorView reshape(std::initializer_list<int> dims) const {
+        if (!contiguous()) {
+            throw std::invalid_argument("Cannot reshape a strided view without copying");
+        }
+        TensorView v(ptr, dims);
+        if (v.numel() != numel()) {
+            throw std::invalid_argument("New shape is incompatible with the current data size");
+        }
+        return v;
+    }
+
+    // Indices [begin, end) of one dimension, e.g. slice(0, b * 16, b * 16 + 16) for a batch
+    TensorView slice(int dim, int begin, int end) const {
+        check_dim(dim);
+        if (begin < 0 || end < begin || end > extents[dim]) {
+            throw std::out_of_range("Slice [" + std::to_string(begin) + ", " + std::to_string(end) +
+                                    ") out of bounds for size " + std::to_string(extents[dim]));
+        }
+        TensorView v = *this;
+        v.ptr = ptr + begin * strides[dim];
+        v.extents[dim] = end - begin;
+        return v;
+    }
+
+    // Swaps two dimensions, by default the two of a matrix
+    TensorView transpose(int a = 0, int b = 1) const {
+        check_dim(a);
+        check_dim(b);
+        TensorView v = *this;
+        std::swap(v.extents[a], v.extents[b]);
+        std::swap(v.strides[a], v.strides[b]);
+        return v;
+    }
+
+    // Repeats a dimension of size 1 n times with stride 0, e.g. a bias row across a batch
+    TensorView broadcast(int dim, int n) const {
+        check_dim(dim);
+        if (extents[dim] != 1) {
+            throw std::invalid_argument("Can only broadcast a dimension of size 1, not " +
+                                        std::to_string(extents[dim]));
+        }
+        TensorView v = *this;
+        v.extents[dim] = n;
+        v.strides[dim] = 0;
+        return v;
+    }
+
+private:
+    template <typename>
+    friend class TensorView;
+
+    T* ptr = nullptr;
+    int ndim = 0;
+    std::array<int, MAX_VIEW_DIMS> extents{};
+    std::array<ptrdiff_t, MAX_VIEW_DIMS> strides{};
+
+    void set_contiguous_strides() {
+        ptrdiff_t stride = 1;
+        for (int d = ndim - 1; d >= 0; --d) {
+            strides[d] = stride;
+            stride *= extents[d];
+        }
+    }
+
+    void check_dim(int dim) const {
+        if (dim < 0 || dim >= ndim) {
+            throw std::out_of_range("Dimension " + std::to_string(dim) + " out of range for a " +
+                                    std::to_string(ndim) + "-D view");
+        }
+    }
+};
+
+#endif // TENSOR_VIEW_HPP
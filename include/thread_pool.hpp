@@ -0,0 +1,90 @@
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed team of threads that all run the same job and then meet at a barrier.
+// The calling thread takes part as worker 0, so a pool of size 1 starts no threads.
+class ThreadPool {
+public:
+    explicit ThreadPool(int num_threads);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    int size() const { return num_threads; }
+
+    // Runs job(worker_index) on every worker and returns once all of them are done. The job
+    // is passed on as a plain pointer, so handing in a lambda never allocates.
+    template <typename F>
+    void run(const F& job) {
+        run_erased([](const void* f, int index) { (*static_cast<const F*>(f))(index); }, &job);
+    }
+
+    // Splits [0, count) into parts near-equal contiguous ranges and returns the index-th one
+    static std::pair<size_t, size_t> split(size_t count, int parts, int index);
+
+private:
+    int num_threads;
+    std::vector<std::thread> threads;
+
+    std::mutex mutex;
+    std::condition_variable start_cv;
+    std::condition_variable done_cv;
+    using JobFn = void (*)(const void*, int);
+    JobFn current_fn = nullptr;
+    const void* current_job = nullptr;
+    unsigned long generation = 0;
+    int pending = 0;
+    bool stopping = false;
+
+    void run_erased(JobFn fn, const void* job);
+    void worker_loop(int index);
+};
+
+// Same idea for jobs of a few microseconds, like one GEMV: idle workers spin on the next
+// job instead of sleeping on a condition variable, so starting one costs a cache line
+// transfer rather than a wake-up. The price is that every worker but the caller keeps a
+// core busy for as long as the team exists (it yields to other threads after a while, but
+// never sleeps), so only create one for a latency-critical path.
+class SpinTeam {
+public:
+    explicit SpinTeam(int num_threads);
+    ~SpinTeam();
+
+    SpinTeam(const SpinTeam&) = delete;
+    SpinTeam& operator=(const SpinTeam&) = delete;
+
+    int size() const { return num_threads; }
+
+    // Runs job(worker_index) on every worker and returns once all of them are done, or
+    // returns false right away without running anything if another thread is using the team
+    template <typename F>
+    bool try_run(const F& job) {
+        return try_run_erased([](const void* f, int index) { (*static_cast<const F*>(f))(index); }, &job);
+    }
+
+private:
+    using JobFn = void (*)(const void*, int);
+
+    int num_threads;
+    std::vector<std::thread> threads;
+
+    std::atomic<bool> busy{false};
+    // Workers start a job when generation moves, job and fn are published before it
+    alignas(64) std::atomic<unsigned long> generation{0};
+    JobFn current_fn = nullptr;
+    const void* current_job = nullptr;
+    alignas(64) std::atomic<int> pending{0};
+    std::atomic<bool> stopping{false};
+
+    bool try_run_erased(JobFn fn, const void* job);
+    void worker_loop(int index);
+};
+
+#endif // THREAD_POOL_HPP
@@ -0,0 +1,79 @@
+#ifndef TRACE_HPP
+#define TRACE_HPP
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+// Scoped timing spans for finding where a training run spends its time without a profiler.
+// Build with -DENABLE_TRACING (make TRACE=1) to record them, otherwise every TRACE_* macro
+// compiles to nothing and its arguments are never evaluated.
+//
+// Every thread records into a ring buffer of its own, so recording takes no lock and never
+// allocates after a thread's first span. When a ring is full the oldest spans are dropped.
+// The rings can be dumped as Chrome trace-event JSON (chrome://tracing, ui.perfetto.dev) or
+// folded into a summary table; do that while no spans are being recorded.
+namespace trace {
+
+#ifdef ENABLE_TRACING
+constexpr bool enabled = true;
+#else
+constexpr bool enabled = false;
+#endif
+
+// Spans kept per thread
+constexpr size_t RING_CAPACITY = 1 << 16;
+
+struct Event {
+    const char* category; // forward, backward, optimizer, data, ...
+    const char* name;     // Static strings only, they are kept by pointer
+    int layer;            // First layer of the step, -1 when not a layer
+    uint64_t begin_ns;
+    uint64_t end_ns;
+    double flops;         // Work done by the span, 0 when unknown
+    double bytes;         // Minimum memory traffic of the span, 0 when unknown
+};
+
+uint64_t now_ns();
+void record(const Event& event);
+// Label for the calling thread in the trace
+void set_thread_name(const std::string& name);
+
+// Writes every recorded span as Chrome trace-event JSON, throws if the file can't be written
+void write_chrome_json(const std::string& path);
+// Per (category, name, layer): calls, total and mean time, share of the traced time, GFLOP/s, GB/s
+void print_summary(std::ostream& out);
+// Drops everything recorded so far
+void clear();
+
+class Span {
+public:
+    Span(const char* category, const char* name, int layer = -1, double flops = 0.0, double bytes = 0.0)
+        : event{category, name, layer, now_ns(), 0, flops, bytes} {}
+    ~Span() {
+        event.end_ns = now_ns();
+        record(event);
+    }
+
+    Span(const Span&) = delete;
+    Span& operator=(const Span&) = delete;
+
+private:
+    Event event;
+};
+
+} // namespace trace
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+
+#ifdef ENABLE_TRACING
+// TRACE_SCOPE(category, name[, layer, flops, bytes]) times the rest of the enclosing scope
+#define TRACE_SCOPE(...) trace::Span TRACE_CONCAT(trace_span_, __LINE__)(__VA_ARGS__)
+#define TRACE_THREAD_NAME(name) trace::set_thread_name(name)
+#else
+#define TRACE_SCOPE(...) ((void)0)
+#define TRACE_THREAD_NAME(name) ((void)0)
+#endif
+
+#endif // TRACE_HPP
@@ -0,0 +1,102 @@
+#ifndef TRAINER_HPP
+#define TRAINER_HPP
+
+#include "tensor.hpp"
+#include "model.hpp"
+#include "dataset.hpp"
+#include "optimizer.hpp"
+#include "thread_pool.hpp"
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+// Synchronous data-parallel training. Each step runs forward and backward once over the
+// whole batch, with every GEMM split across the pool along the rows and columns of its
+// output but never along k (the batch, for the weight gradients). Each gradient element is
+// then summed in one fixed order, straight into the layers' grad tensors: no per-thread
+// copies and no reduction pass. One optimizer step follows, split across the workers.
+// Nothing depends on the pool size, so any num_threads gives the same weights bit for bit.
+// Afterwards the layers' grad tensors hold the gradient of the last step (they are
+// overwritten every step, not accumulated).
+template <typename T>
+class BasicDataParallelTrainer {
+public:
+    // Packs the model's parameters for the optimizer, plain SGD unless configured otherwise
+    BasicDataParallelTrainer(BasicModel<T>& model, int num_threads,
+                             const OptimizerConfig& optimizer_config = OptimizerConfig());
+
+    // One training step on the whole batch, returns the mean loss over it
+    double step(const BasicTensor<T>& input, const BasicTensor<T>& actual, double learning_rate);
+
+    int num_threads() const { return pool.size(); }
+    // E.g. for its state() when saving a checkpoint
+    BasicOptimizer<T>& optimizer() { return optim; }
+
+private:
+    BasicModel<T>& model;
+    ThreadPool pool;
+    BasicOptimizer<T> optim;
+    BasicWorkspace<T> workspace;
+};
+
+using DataParallelTrainer = BasicDataParallelTrainer<float>;
+
+struct HogwildStats {
+    uint64_t updates = 0;
+    uint64_t samples = 0;
+    double seconds = 0.0;
+    // Updates other workers applied between a worker starting its forward pass and applying
+    // its own update, i.e. how old the weights its gradient was computed on were
+    double mean_staleness = 0.0;
+    uint64_t max_staleness = 0;
+    double samples_per_second = 0.0;
+    double updates_per_second = 0.0;
+};
+
+// Asynchronous SGD without locks (Hogwild). Every worker claims the next batch of the
+// epoch's permutation, runs forward/backward into its own Workspace and then applies plain
+// SGD straight to the model's flat parameters while the others keep reading and writing
+// them. No barrier, no gradient reduction: workers only meet at the end of an epoch.
+//
+// The races are deliberate. A forward pass can see a mix of old and new weights and two
+// updates to the same element can lose one of them; with small learning rates that costs
+// little accuracy, and stats() reports how stale the gradients got. Results depend on
+// scheduling, use BasicDataParallelTrainer for reproducible runs.
+template <typename T>
+class BasicHogwildTrainer {
+public:
+    // Packs the model's parameters, so every update is one pass over one flat buffer
+    BasicHogwildTrainer(BasicModel<T>& model, int num_threads);
+
+    // One pass over dataset in the permutation for (seed, epoch), in batches of batch_size
+    // rows (the trailing partial batch is dropped). Returns the mean loss per sample.
+    double epoch(const Dataset& dataset, int batch_size, double learning_rate, uint64_t seed, int epoch);
+
+    int num_threads() const { return pool.size(); }
+    // Throughput and staleness of the last epoch
+    const HogwildStats& stats() const { return last_stats; }
+
+private:
+    // One cache line per worker, written only by its owner
+    struct alignas(64) WorkerCounters {
+        uint64_t updates = 0;
+        uint64_t samples = 0;
+        uint64_t staleness_sum = 0;
+        uint64_t staleness_max = 0;
+        double loss = 0.0;
+    };
+
+    BasicModel<T>& model;
+    ThreadPool pool;
+    std::vector<BasicWorkspace<T>> workspaces;
+    std::vector<BasicTensor<T>> batch_inputs; // Per worker, reused across batches
+    std::vector<BasicTensor<T>> batch_labels;
+    std::vector<WorkerCounters> counters;
+    std::vector<int> order;
+    std::atomic<uint64_t> version{0}; // Updates applied so far
+    HogwildStats last_stats;
+};
+
+using HogwildTrainer = BasicHogwildTrainer<float>;
+
+#endif // TRAINER_HPP
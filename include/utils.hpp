@@ -6,10 +6,24 @@
 
 class Utils {
 public:
-    static double cross_entropy_loss(const Tensor& y_pred, const Tensor& y_act);
-    static void cross_entropy_softmax_backwards(Tensor& input, Tensor& output, const Tensor& actual);
-    static void SGD_step(Model& model, double learning_rate);
-    static void zero_grad(Model& model);
+    template <typename T>
+    static double cross_entropy_loss(const BasicTensor<T>& y_pred, const BasicTensor<T>& y_act);
+    template <typename T>
+    static void cross_entropy_softmax_backwards(BasicTensor<T>& input, BasicTensor<T>& output, const BasicTensor<T>& actual);
+    // Same, but normalized by total_batch rows, for when input is a shard of a larger batch
+    template <typename T>
+    static void cross_entropy_softmax_backwards(BasicTensor<T>& input, BasicTensor<T>& output, const BasicTensor<T>& actual, int total_batch);
+    template <typename T>
+    static void SGD_step(BasicModel<T>& model, double learning_rate);
+    template <typename T>
+    static void zero_grad(BasicModel<T>& model);
+
+    // Checks backward() against central differences of the loss on a few evenly spaced
+    // weights and biases of every LINEAR layer, returns the largest relative error.
+    // Only built for float64 models, use model.cast<double>() to check a float32 one.
+    template <typename T>
+    static double gradient_check(BasicModel<T>& model, const BasicTensor<T>& input, const BasicTensor<T>& actual,
+                                 int checks_per_layer = 8, double epsilon = 1e-6);
 };
 
 #endif // UTILS_HPP
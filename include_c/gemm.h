@@ -0,0 +1,19 @@
+#ifndef GEMM_H
+#define GEMM_H
+
+#include <stdbool.h>
+
+// Blocking sizes, KC*NR panels of B sit in L1, MC*KC of A in L2, KC*NC of B in L3
+#define GEMM_MR 4
+#define GEMM_NR 8
+#define GEMM_MC 96
+#define GEMM_KC 256
+#define GEMM_NC 2048
+
+// C = alpha * op(A) * op(B) + beta * C, everything row major
+// op(A) is m x k, op(B) is k x n, trans_a/trans_b pick the transposed versions
+void gemm(bool trans_a, bool trans_b, int m, int n, int k,
+          double alpha, const double* A, int lda, const double* B, int ldb,
+          double beta, double* C, int ldc);
+
+#endif // !GEMM_H
@@ -27,7 +27,8 @@ typedef struct {
 void add_layer(Model* model, LAYER_TYPE type, int input, int output);
 Model* create_model(int num_layers);
 Tensor* forward(Model* model, Tensor* input);
-void backwards(Model* model, Tensor* pred, Tensor* act);
+// accumulate = false overwrites the parameter grads instead of adding to them, so no zero_grad is needed
+void backwards(Model* model, Tensor* pred, Tensor* act, bool accumulate);
 void free_layer(Layer *layer);
 void free_model(Model* model);
 
@@ -5,7 +5,7 @@
 
 
 Tensor* matmul(Tensor* t1, Tensor* t2);
-void matmul_d(Tensor* t1, Tensor* t2, Tensor* prev_layer_grad);
+void matmul_d(Tensor* t1, Tensor* t2, Tensor* prev_layer_grad, bool accumulate);
 Tensor* add_bias(Tensor* t1, Tensor* bias);
 Tensor* relu(Tensor* t1);
 void relu_d(Tensor* input, Tensor* grad_output);
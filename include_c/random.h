@@ -0,0 +1,21 @@
+#ifndef RANDOM_H
+#define RANDOM_H
+
+#include <stdint.h>
+
+// Counter-based random numbers, Philox4x32-10 like the C++ engine's random.hpp: block b of a
+// stream is a pure function of (seed, stream, b), so values don't depend on call order and
+// a double fill gives the same numbers as rng::fill_uniform<double> for the same stream
+#define RNG_DEFAULT_SEED 0x5eed
+
+// Also restarts rng_next_stream(), set it before creating tensors
+void rng_set_seed(uint64_t seed);
+uint64_t rng_seed(void);
+// A fresh stream id for each call, tensors get them in creation order
+uint64_t rng_next_stream(void);
+
+void rng_philox(uint64_t seed, uint64_t stream, uint64_t block, uint32_t out[4]);
+// out[i] = value i of the stream mapped to [lo, hi]
+void rng_fill_uniform(double* out, long int n, double lo, double hi, uint64_t stream);
+
+#endif // !RANDOM_H
@@ -6,6 +6,22 @@
 double cross_entropy_loss(Tensor* y_pred, Tensor* y_act);
 void cross_entropy_softmax_backwards(Tensor* input, Tensor* output, Tensor* actual);
 void SGD_step(Model* model, double learning_rate);
+
+// Adam state, m and v for the parameters of every linear layer share one buffer
+typedef struct {
+    double* m;
+    double* v;
+    long int count;
+    long int step;
+    double beta1;
+    double beta2;
+    double epsilon;
+    double weight_decay; // Decoupled like AdamW, 0 for plain Adam
+} Adam;
+
+Adam* create_adam(Model* model, double beta1, double beta2, double epsilon, double weight_decay);
+void Adam_step(Adam* adam, Model* model, double learning_rate);
+void free_adam(Adam* adam);
 void zero_grad(Model* model);
 
 #endif // !UTILS_H
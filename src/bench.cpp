@@ -0,0 +1,560 @@
+#include "../include/tensor.hpp"
+#include "../include/model.hpp"
+#include "../include/utils.hpp"
+#include "../include/gemm.hpp"
+#include "../include/ops.hpp"
+#include "../include/kernels.hpp"
+#include "../include/dataset.hpp"
+#include "../include/evaluator.hpp"
+#include "../include/optimizer.hpp"
+#include "../include/random.hpp"
+#include "../include/static_model.hpp"
+#include "../include/thread_pool.hpp"
+#include "../include/trainer.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+// Micro-benchmarks for the kernels, layers and training loop pieces, at the shapes main()
+// trains with. Every benchmark is timed as reps samples of iters calls each (iters picked so
+// a sample takes about --sample-ms), and reported as the mean per call with its variance
+// over the samples. Results go to stdout and, with --json, to a file that can be diffed
+// across builds.
+//
+//   ./benchmark [--json FILE] [--filter SUBSTR] [--reps N] [--sample-ms MS] [--data FILE]
+
+namespace {
+
+struct Options {
+    std::string json_path;
+    std::string filter;
+    int reps = 15;
+    double sample_ms = 5.0;
+    std::string data_path; // Text dataset to parse, a synthetic one is written when empty
+};
+
+struct Result {
+    std::string name;
+    int batch;
+    double flops;     // Per call
+    double bytes;     // Per call, the minimum traffic the operation has to do
+    int reps;
+    long iters;       // Calls per sample
+    double mean_ns;   // Per call
+    double stddev_ns;
+    double min_ns;
+};
+
+using Clock = std::chrono::steady_clock;
+
+double elapsed_ns(Clock::time_point start) {
+    return std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+}
+
+class Runner {
+public:
+    explicit Runner(const Options& options) : options(options) {}
+
+    // Times fn, which processes batch samples per call
+    void run(const std::string& name, int batch, double flops, double bytes, const std::function<void()>& fn) {
+        if (!options.filter.empty() && name.find(options.filter) == std::string::npos) {
+            return;
+        }
+
+        // Warm up caches and the workspace, then grow iters until a sample is long enough
+        fn();
+        long iters = 1;
+        for (;;) {
+            auto start = Clock::now();
+            for (long i = 0; i < iters; ++i) {
+                fn();
+            }
+            if (elapsed_ns(start) >= options.sample_ms * 1e6 || iters >= (1L << 30)) {
+                break;
+            }
+            iters *= 2;
+        }
+
+        std::vector<double> samples(options.reps);
+        for (double& sample : samples) {
+            auto start = Clock::now();
+            for (long i = 0; i < iters; ++i) {
+                fn();
+            }
+            sample = elapsed_ns(start) / iters;
+        }
+
+        double mean = 0.0;
+        for (double s : samples) {
+            mean += s;
+        }
+        mean /= samples.size();
+        double var = 0.0;
+        for (double s : samples) {
+            var += (s - mean) * (s - mean);
+        }
+        var = samples.size() > 1 ? var / (samples.size() - 1) : 0.0;
+
+        Result r{name, batch, flops, bytes, options.reps, iters, mean, std::sqrt(var),
+                 *std::min_element(samples.begin(), samples.end())};
+        print(r);
+        results.push_back(r);
+    }
+
+    void write_json(const std::string& path) const {
+        std::ofstream out(path);
+        if (!out.is_open()) {
+            throw std::runtime_error("Error opening " + path);
+        }
+        out << "{\n";
+        out << "  \"compiler\": \"" << compiler() << "\",\n";
+#ifdef NDEBUG
+        out << "  \"ndebug\": true,\n";
+#else
+        out << "  \"ndebug\": false,\n";
+#endif
+        out << "  \"isa\": \"" << isa_name(kernels<float>().isa) << "\",\n";
+        out << "  \"results\": [\n";
+        char line[512];
+        for (size_t i = 0; i < results.size(); ++i) {
+            const Result& r = results[i];
+            std::snprintf(line, sizeof(line),
+                          "    {\"name\": \"%s\", \"batch\": %d, \"reps\": %d, \"iters\": %ld, "
+                          "\"mean_ns\": %.1f, \"stddev_ns\": %.1f, \"variance_ns2\": %.1f, \"min_ns\": %.1f, "
+                          "\"ns_per_sample\": %.2f, \"samples_per_s\": %.1f, \"gflops\": %.3f, \"gbps\": %.3f}%s\n",
+                          r.name.c_str(), r.batch, r.reps, r.iters, r.mean_ns, r.stddev_ns,
+                          r.stddev_ns * r.stddev_ns, r.min_ns, r.mean_ns / r.batch, 1e9 * r.batch / r.mean_ns,
+                          r.flops / r.mean_ns, r.bytes / r.mean_ns, i + 1 < results.size() ? "," : "");
+            out << line;
+        }
+        out << "  ]\n}\n";
+    }
+
+    static void print_header() {
+        std::printf("%-34s %6s %12s %8s %12s %12s %9s %9s\n", "benchmark", "batch", "ns/call", "+-%", "ns/sample",
+                    "samples/s", "GFLOP/s", "GB/s");
+    }
+
+private:
+    const Options& options;
+    std::vector<Result> results;
+
+    static void print(const Result& r) {
+        std::printf("%-34s %6d %12.0f %8.2f %12.1f %12.0f %9.2f %9.2f\n", r.name.c_str(), r.batch, r.mean_ns,
+                    100.0 * r.stddev_ns / r.mean_ns, r.mean_ns / r.batch, 1e9 * r.batch / r.mean_ns,
+                    r.flops / r.mean_ns, r.bytes / r.mean_ns);
+        std::fflush(stdout);
+    }
+
+    static std::string compiler() {
+#if defined(__clang__)
+        return std::string("clang ") + __clang_version__;
+#elif defined(__GNUC__)
+        return std::string("gcc ") + __VERSION__;
+#else
+        return "unknown";
+#endif
+    }
+};
+
+// The network main() trains
+void build_mnist_model(Model& model) {
+    model.add_layer(LayerType::LINEAR, 784, 500);
+    model.add_layer(LayerType::RELU, 500, 500);
+    model.add_layer(LayerType::LINEAR, 500, 100);
+    model.add_layer(LayerType::RELU, 100, 100);
+    model.add_layer(LayerType::LINEAR, 100, 10);
+    model.add_layer(LayerType::SOFTMAX, 10, 10);
+}
+
+void fill_random(Tensor& t, std::mt19937& rng) {
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+    for (float& v : t.data) {
+        v = dist(rng);
+    }
+}
+
+void fill_labels(Tensor& t, std::mt19937& rng) {
+    std::uniform_int_distribution<int> dist(0, 9);
+    for (float& v : t.data) {
+        v = static_cast<float>(dist(rng));
+    }
+}
+
+// Work done by one pass over the model: 2*in*out flops per row for LINEAR, one per element
+// for RELU and a handful for SOFTMAX. Bytes count every activation, weight and bias once.
+void model_cost(const Model& model, int batch, bool backward, double& flops, double& bytes) {
+    flops = 0.0;
+    bytes = 0.0;
+    double width = model.layers.front()->weights ? model.layers.front()->weights->shape[0] : 0.0;
+    for (const auto& layer : model.layers) {
+        if (layer->layer_type == LayerType::LINEAR) {
+            const double in = layer->weights->shape[0];
+            const double out = layer->weights->shape[1];
+            // Backward is two GEMMs (dW and dX) and reads dY on top of the forward operands
+            flops += (backward ? 4.0 : 2.0) * batch * in * out;
+            bytes += sizeof(float) * ((backward ? 2.0 : 1.0) * (batch * in + in * out) + batch * out + out);
+            width = out;
+        } else if (!backward || layer->layer_type == LayerType::RELU) {
+            flops += (layer->layer_type == LayerType::RELU ? 1.0 : 4.0) * batch * width;
+            bytes += sizeof(float) * 2.0 * batch * width;
+        }
+    }
+}
+
+void bench_gemm(Runner& runner, std::mt19937& rng) {
+    // The model's own shapes at batch 16, then the first layer over a range of batch sizes
+    struct Shape {
+        int m, k, n;
+    };
+    std::vector<Shape> shapes = {{16, 784, 500}, {16, 500, 100}, {16, 100, 10}};
+    for (int batch : {1, 4, 64, 256}) {
+        shapes.push_back({batch, 784, 500});
+    }
+
+    for (const Shape& s : shapes) {
+        Tensor a(std::vector<int>{s.m, s.k});
+        Tensor b(std::vector<int>{s.k, s.n});
+        Tensor c(std::vector<int>{s.m, s.n});
+        fill_random(a, rng);
+        fill_random(b, rng);
+        const std::string name = "gemm." + std::to_string(s.m) + "x" + std::to_string(s.k) + "x" + std::to_string(s.n);
+        runner.run(name, s.m, 2.0 * s.m * s.k * s.n,
+                   sizeof(float) * (double(s.m) * s.k + double(s.k) * s.n + double(s.m) * s.n), [&] {
+                       gemm(Transpose::NO, Transpose::NO, s.m, s.n, s.k, 1.0f, a.data.data(), s.k, b.data.data(), s.n,
+                            0.0f, c.data.data(), s.n);
+                   });
+    }
+}
+
+// Each layer type on its own, through the same ops forward() and backward() call
+void bench_layers(Runner& runner, std::mt19937& rng, int batch) {
+    for (const auto& shape : std::vector<std::pair<int, int>>{{784, 500}, {500, 100}, {100, 10}}) {
+        const int in = shape.first;
+        const int out = shape.second;
+        Tensor x(std::vector<int>{batch, in});
+        Tensor w(std::vector<int>{in, out}, true);
+        Tensor bias(std::vector<int>{out}, true);
+        Tensor y(std::vector<int>{batch, out}, true);
+        Tensor dx(std::vector<int>{batch, in}, true);
+        fill_random(x, rng);
+        fill_random(w, rng);
+        fill_random(bias, rng);
+        fill_random(y, rng);
+        const std::string suffix = "." + std::to_string(in) + "x" + std::to_string(out);
+        const double operands = double(batch) * in + double(in) * out;
+
+        runner.run("layer.linear.forward" + suffix, batch, 2.0 * batch * in * out,
+                   sizeof(float) * (operands + batch * out + out), [&] {
+                       gemm(Transpose::NO, Transpose::NO, batch, out, in, 1.0f, x.data.data(), in, w.data.data(), out,
+                            0.0f, y.data.data(), out, Epilogue::BIAS, bias.data.data());
+                   });
+        runner.run("layer.linear.backward" + suffix, batch, 4.0 * batch * in * out,
+                   sizeof(float) * (2.0 * operands + batch * out + out), [&] {
+                       ops::bias_backward(y.grad.data(), static_cast<const float*>(nullptr),
+                                          static_cast<float*>(nullptr), bias.grad.data(), batch, out, 0.0f);
+                       gemm(Transpose::YES, Transpose::NO, in, out, batch, 1.0f, x.data.data(), in, y.grad.data(), out,
+                            0.0f, w.grad.data(), out);
+                       gemm(Transpose::NO, Transpose::YES, batch, in, out, 1.0f, y.grad.data(), out, w.data.data(), out,
+                            0.0f, dx.grad.data(), in);
+                   });
+    }
+
+    for (int width : {500, 100}) {
+        Tensor x(std::vector<int>{batch, width}, true);
+        Tensor y(std::vector<int>{batch, width}, true);
+        fill_random(x, rng);
+        fill_random(y, rng);
+        const size_t n = x.total_size;
+        const std::string suffix = "." + std::to_string(width);
+        runner.run("layer.relu.forward" + suffix, batch, double(n), sizeof(float) * 2.0 * n,
+                   [&] { ops::relu_forward(x.data.data(), y.data.data(), n); });
+        runner.run("layer.relu.backward" + suffix, batch, double(n), sizeof(float) * 3.0 * n,
+                   [&] { ops::relu_backward(x.data.data(), y.grad.data(), x.grad.data(), n); });
+    }
+
+    Tensor logits(std::vector<int>{batch, 10}, true);
+    Tensor probs(std::vector<int>{batch, 10});
+    Tensor labels(std::vector<int>{batch, 1});
+    fill_random(logits, rng);
+    fill_labels(labels, rng);
+    const double n = logits.total_size;
+    runner.run("layer.softmax.forward.10", batch, 4.0 * n, sizeof(float) * 2.0 * n,
+               [&] { ops::softmax_rows(logits.data.data(), probs.data.data(), batch, 10); });
+    runner.run("loss.softmax_cross_entropy.10", batch, 5.0 * n, sizeof(float) * (3.0 * n + batch), [&] {
+        ops::softmax_cross_entropy(logits.data.data(), labels.data.data(), probs.data.data(), logits.grad.data(),
+                                   batch, 10, 1.0f / batch);
+    });
+}
+
+void bench_model(Runner& runner, std::mt19937& rng) {
+    for (int batch : {1, 16, 64, 256}) {
+        Model model(6);
+        build_mnist_model(model);
+        Tensor input(std::vector<int>{batch, 784});
+        Tensor labels(std::vector<int>{batch, 1});
+        fill_random(input, rng);
+        fill_labels(labels, rng);
+
+        double flops, bytes;
+        model_cost(model, batch, false, flops, bytes);
+        runner.run("model.forward", batch, flops, bytes, [&] { forward(model, input); });
+        Tensor output(std::vector<int>{batch, 10});
+        runner.run("model.infer", batch, flops, bytes, [&] { infer(model, input, output); });
+        model.set_weight_layout(WeightLayout::PANELS);
+        runner.run("model.infer.panels", batch, flops, bytes, [&] { infer(model, input, output); });
+        model.set_weight_layout(WeightLayout::ROW_MAJOR);
+        if (batch <= GEMV_MAX_ROWS) {
+            // Small batches are GEMVs, here split across a spinning team of every core
+            model.set_inference_team(std::make_shared<SpinTeam>(std::max(1u, std::thread::hardware_concurrency())));
+            runner.run("model.infer.team", batch, flops, bytes, [&] { infer(model, input, output); });
+            model.set_inference_team(nullptr);
+        }
+
+        // Same topology with every size fixed at compile time
+        StaticModel<Linear<784, 500>, ReLU, Linear<500, 100>, ReLU, Linear<100, 10>, Softmax> fixed(model);
+        runner.run("static_model.forward", batch, flops, bytes, [&] { fixed.forward(input); });
+        runner.run("static_model.infer", batch, flops, bytes, [&] { fixed.infer(input, output); });
+        runner.run("static_model.forward_loss", batch, flops, bytes, [&] { fixed.forward_loss(input, labels, batch); });
+        runner.run("model.forward_loss", batch, flops, bytes,
+                   [&] { forward_loss(model, input, labels, model.workspace, batch); });
+
+        // backward() only reads what forward_loss left in the workspace, so it can be rerun
+        forward_loss(model, input, labels, model.workspace, batch);
+        model_cost(model, batch, true, flops, bytes);
+        runner.run("model.backward", batch, flops, bytes,
+                   [&] { backward(model, model.workspace.outputs.back(), labels, model.workspace, false); });
+        fixed.forward_loss(input, labels, batch);
+        runner.run("static_model.backward", batch, flops, bytes, [&] { fixed.backward(false); });
+    }
+
+    Model model(6);
+    build_mnist_model(model);
+    double params = 0.0;
+    for (const auto& layer : model.layers) {
+        if (layer->weights) {
+            params += layer->weights->total_size + layer->bias->total_size;
+        }
+    }
+    // Per parameter: SGD reads the weight and gradient and writes the weight, zero_grad writes the gradient
+    runner.run("utils.SGD_step", 1, 2.0 * params, sizeof(float) * 3.0 * params,
+               [&] { Utils::SGD_step(model, 1e-9); });
+    runner.run("utils.zero_grad", 1, 0.0, sizeof(float) * params, [&] { Utils::zero_grad(model); });
+
+    // The fused optimizers over the packed model, single threaded and split over every core.
+    // Per parameter they read param, grad and each state slot and write param and each slot.
+    ThreadPool pool(std::max(1u, std::thread::hardware_concurrency()));
+    for (const char* name : {"sgd", "momentum", "nesterov", "adam", "adamw"}) {
+        OptimizerConfig config = optimizer_config(name);
+        config.learning_rate = 1e-9;
+        for (ThreadPool* p : {static_cast<ThreadPool*>(nullptr), &pool}) {
+            Optimizer optimizer(model, config, p);
+            const int slots = optimizer.state_slots();
+            const std::string label = std::string("optimizer.") + name + (p ? ".threads" : "");
+            const double flops = (slots == 2 ? 12.0 : 2.0 + 2.0 * slots) * params;
+            runner.run(label, 1, flops, sizeof(float) * (3.0 + 2.0 * slots) * params, [&] { optimizer.step(); });
+        }
+    }
+}
+
+// Whole synchronous training steps (forward_loss, backward and an SGD step) at main()'s batch
+// size and a large one, on 1, 2, 4, ... threads and every core. samples/s over the 1-thread
+// row of the same batch is the scaling.
+void bench_trainer(Runner& runner, std::mt19937& rng) {
+    const int cores = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<int> thread_counts;
+    for (int threads = 1; threads < cores; threads *= 2) {
+        thread_counts.push_back(threads);
+    }
+    thread_counts.push_back(cores);
+
+    for (int batch : {16, 256}) {
+        Tensor input(std::vector<int>{batch, 784});
+        Tensor labels(std::vector<int>{batch, 1});
+        fill_random(input, rng);
+        fill_labels(labels, rng);
+        for (int threads : thread_counts) {
+            Model model(6);
+            build_mnist_model(model);
+            model.initialize(WeightInit::HE);
+            DataParallelTrainer trainer(model, threads, optimizer_config("sgd"));
+
+            double flops, bytes, backward_flops, backward_bytes;
+            model_cost(model, batch, false, flops, bytes);
+            model_cost(model, batch, true, backward_flops, backward_bytes);
+            // A tiny learning rate keeps the weights (and so the work) the same from step to step
+            runner.run("trainer.step.threads." + std::to_string(threads), batch, flops + backward_flops,
+                       bytes + backward_bytes, [&] { trainer.step(input, labels, 1e-9); });
+        }
+    }
+}
+
+// Weight init: the old per-tensor mt19937 against the Philox fills, per element of the
+// 784x500 layer, and a whole He init of the MNIST model
+void bench_random(Runner& runner) {
+    const int in = 784, out = 500;
+    const size_t n = static_cast<size_t>(in) * out;
+    Tensor w(std::vector<int>{in, out});
+    std::mt19937 gen(1);
+    runner.run("rng.mt19937.uniform", static_cast<int>(n), 0.0, sizeof(float) * double(n), [&] {
+        std::uniform_real_distribution<> dis(-1.0, 1.0);
+        std::generate(w.data.begin(), w.data.end(), [&] { return float(dis(gen)); });
+    });
+    uint64_t stream = 0;
+    runner.run("rng.fill_uniform", static_cast<int>(n), 0.0, sizeof(float) * double(n),
+               [&] { rng::fill_uniform(w.data.data(), n, -1.0, 1.0, stream++); });
+    runner.run("rng.fill_normal", static_cast<int>(n), 0.0, sizeof(float) * double(n),
+               [&] { rng::fill_normal(w.data.data(), n, 0.0, 1.0, stream++); });
+
+    Model model(6);
+    build_mnist_model(model);
+    double bytes = 0.0;
+    for (const auto& layer : model.layers) {
+        if (layer->layer_type == LayerType::LINEAR) {
+            bytes += sizeof(float) * double(layer->weights->total_size + layer->bias->total_size);
+        }
+    }
+    runner.run("model.initialize.he", 1, 0.0, bytes, [&] { model.initialize(WeightInit::HE); });
+}
+
+// Writes rows of MNIST-like "p0,...,p783;label" lines, returns the path
+std::string write_synthetic_dataset(int rows, std::mt19937& rng) {
+    char path[] = "/tmp/mlbench_XXXXXX";
+    const int fd = ::mkstemp(path);
+    if (fd < 0) {
+        throw std::runtime_error("Could not create a temporary dataset file");
+    }
+    ::close(fd);
+
+    std::ofstream out(path);
+    std::uniform_int_distribution<int> pixel(0, 255);
+    std::uniform_int_distribution<int> label(0, 9);
+    for (int r = 0; r < rows; ++r) {
+        for (int j = 0; j < 784; ++j) {
+            // Mostly background like the real digits
+            out << (pixel(rng) < 200 ? 0 : pixel(rng)) << (j + 1 < 784 ? "," : ";");
+        }
+        out << label(rng) << "\n";
+    }
+    return path;
+}
+
+void bench_dataset(Runner& runner, const Options& options, std::mt19937& rng) {
+    const bool synthetic = options.data_path.empty();
+    const int rows = 1000;
+    const std::string path = synthetic ? write_synthetic_dataset(rows, rng) : options.data_path;
+
+    std::ifstream file(path, std::ios::ate | std::ios::binary);
+    const double file_bytes = static_cast<double>(file.tellg());
+    int count = 0;
+    {
+        std::ifstream lines(path);
+        std::string line;
+        while (std::getline(lines, line)) {
+            count++;
+        }
+    }
+
+    Dataset dataset(count, 784);
+    runner.run("dataset.MNIST_dataset", count, 0.0, file_bytes, [&] { MNIST_dataset(path, &dataset); });
+
+    // A batch into infer() copied out with fill_batch, or read in place through a view
+    Model model(6);
+    build_mnist_model(model);
+    const int batch = std::min(64, count);
+    double flops, bytes;
+    model_cost(model, batch, false, flops, bytes);
+    Tensor input(std::vector<int>{batch, 784});
+    Tensor labels(std::vector<int>{batch, 1});
+    Tensor output(std::vector<int>{batch, 10});
+    runner.run("dataset.fill_batch+infer", batch, flops, bytes, [&] {
+        dataset.fill_batch(0, batch, input, labels);
+        infer(model, input, output);
+    });
+    runner.run("dataset.view+infer", batch, flops, bytes,
+               [&] { infer(model, dataset.input_rows(0, batch), output); });
+
+    // The whole set through the evaluator, one call per pass over it
+    Evaluator evaluator(dataset, std::max(1u, std::thread::hardware_concurrency()));
+    double eval_flops, eval_bytes;
+    model_cost(model, count, false, eval_flops, eval_bytes);
+    runner.run("eval.evaluate", count, eval_flops, eval_bytes, [&] { evaluator.evaluate(model); });
+
+    // A training batch assembled from float rows, then from uint8 rows widened on the fly
+    const int train_batch = std::min(256, count);
+    Tensor train_input(std::vector<int>{train_batch, 784});
+    Tensor train_labels(std::vector<int>{train_batch, 1});
+    const double row_bytes = 784.0 * sizeof(float);
+    runner.run("dataset.fill_batch", train_batch, 0.0, train_batch * 2 * row_bytes,
+               [&] { dataset.fill_batch(0, train_batch, train_input, train_labels); });
+    dataset.quantize();
+    runner.run("dataset.fill_batch.u8", train_batch, 0.0, train_batch * (784.0 + row_bytes),
+               [&] { dataset.fill_batch(0, train_batch, train_input, train_labels); });
+
+    if (synthetic) {
+        std::remove(path.c_str());
+    }
+}
+
+Options parse_args(int argc, char** argv) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        const bool has_value = i + 1 < argc;
+        if (arg == "--json" && has_value) {
+            options.json_path = argv[++i];
+        } else if (arg == "--filter" && has_value) {
+            options.filter = argv[++i];
+        } else if (arg == "--reps" && has_value) {
+            options.reps = std::max(2, std::atoi(argv[++i]));
+        } else if (arg == "--sample-ms" && has_value) {
+            options.sample_ms = std::max(0.1, std::atof(argv[++i]));
+        } else if (arg == "--data" && has_value) {
+            options.data_path = argv[++i];
+        } else {
+            std::cerr << "Usage: " << argv[0]
+                      << " [--json FILE] [--filter SUBSTR] [--reps N] [--sample-ms MS] [--data FILE]" << std::endl;
+            std::exit(EXIT_FAILURE);
+        }
+    }
+    return options;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const Options options = parse_args(argc, argv);
+    std::mt19937 rng(1234);
+    Runner runner(options);
+
+    std::cout << "Kernels: " << isa_name(kernels<float>().isa) << ", " << options.reps << " samples of ~"
+              << options.sample_ms << " ms each" << std::endl;
+    Runner::print_header();
+
+    bench_gemm(runner, rng);
+    for (int batch : {1, 16, 256}) {
+        bench_layers(runner, rng, batch);
+    }
+    bench_model(runner, rng);
+    bench_trainer(runner, rng);
+    bench_random(runner);
+    bench_dataset(runner, options, rng);
+
+    if (!options.json_path.empty()) {
+        runner.write_json(options.json_path);
+        std::cout << "Wrote " << options.json_path << std::endl;
+    }
+    return 0;
+}
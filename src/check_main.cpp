@@ -0,0 +1,1082 @@
+#include "../include/tensor.hpp"
+#include "../include/model.hpp"
+#include "../include/gemm.hpp"
+#include "../include/kernels.hpp"
+#include "../include/ops.hpp"
+#include "../include/utils.hpp"
+#include "../include/trainer.hpp"
+#include "../include/thread_pool.hpp"
+#include "../include/optimizer.hpp"
+#include "../include/random.hpp"
+#include "../include/static_model.hpp"
+#include "../include/quantize.hpp"
+#include "../include/dataset.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+// Checks that paths which are supposed to give the same numbers really do: bit for bit where
+// they run the same operations, within a rounding bound where they don't. Prints every failed
+// comparison and exits non-zero if there was one.
+//
+//   ./checks
+
+namespace {
+
+int failures = 0;
+
+void expect(bool ok, const std::string& what) {
+    if (!ok) {
+        ++failures;
+        std::cout << "FAIL " << what << std::endl;
+    }
+}
+
+// Same bytes, so NaNs and signed zeros have to match too
+template <typename A>
+bool same(const A* a, const A* b, size_t n) {
+    return std::memcmp(a, b, n * sizeof(A)) == 0;
+}
+
+// Within rel of the larger magnitude, for paths that may round differently
+template <typename T>
+bool close(const T* a, const T* b, size_t n, double rel) {
+    for (size_t i = 0; i < n; ++i) {
+        const double x = static_cast<float>(a[i]), y = static_cast<float>(b[i]);
+        if (!(std::fabs(x - y) <= rel * std::max(std::fabs(x), std::fabs(y)))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Blocked GEMM against a plain triple loop in double. The sum order differs, so each element
+// may be off by the usual bound for a length-k dot product: about k roundings of the sum of
+// the absolute products.
+template <typename T>
+void check_gemm(const std::string& type) {
+    struct Shape {
+        int m, n, k;
+    };
+    // The model's layers, then sizes that end mid-tile and cross the MC, KC and NC blocks
+    const Shape shapes[] = {{16, 500, 784}, {16, 100, 500}, {16, 10, 100}, {1, 1, 1},  {7, 13, 5},
+                            {97, 33, 300},  {5, 2100, 3},   {130, 17, 513}};
+    const double eps = std::numeric_limits<T>::epsilon();
+    uint64_t stream = 3000;
+    for (const Shape& s : shapes) {
+        for (Transpose ta : {Transpose::NO, Transpose::YES}) {
+            for (Transpose tb : {Transpose::NO, Transpose::YES}) {
+                // Leading dimensions a few elements wider than the rows, to catch stride mixups
+                const bool a_t = ta == Transpose::YES, b_t = tb == Transpose::YES;
+                const int lda = (a_t ? s.m : s.k) + 3, ldb = (b_t ? s.k : s.n) + 2, ldc = s.n + 1;
+                std::vector<T> a(static_cast<size_t>(a_t ? s.k : s.m) * lda);
+                std::vector<T> b(static_cast<size_t>(b_t ? s.n : s.k) * ldb);
+                std::vector<T> c(static_cast<size_t>(s.m) * ldc);
+                rng::fill_uniform(a.data(), a.size(), -1.0, 1.0, stream++);
+                rng::fill_uniform(b.data(), b.size(), -1.0, 1.0, stream++);
+                rng::fill_uniform(c.data(), c.size(), -1.0, 1.0, stream++);
+                const std::vector<T> c0 = c;
+                const T alpha = T(0.75), beta = T(-0.5);
+                gemm(ta, tb, s.m, s.n, s.k, alpha, a.data(), lda, b.data(), ldb, beta, c.data(), ldc);
+
+                // Element (row, col) of op(A) and op(B)
+                auto op_a = [&](size_t i, size_t p) -> double { return a_t ? a[p * lda + i] : a[i * lda + p]; };
+                auto op_b = [&](size_t p, size_t j) -> double { return b_t ? b[j * ldb + p] : b[p * ldb + j]; };
+                bool ok = true;
+                for (int i = 0; i < s.m && ok; ++i) {
+                    for (int j = 0; j < s.n && ok; ++j) {
+                        double sum = 0.0, magnitude = 0.0;
+                        for (int p = 0; p < s.k; ++p) {
+                            const double x = op_a(i, p), y = op_b(p, j);
+                            sum += x * y;
+                            magnitude += std::fabs(x * y);
+                        }
+                        const double old = c0[static_cast<size_t>(i) * ldc + j];
+                        const double expected = alpha * sum + beta * old;
+                        const double bound = (s.k + 2) * eps * (std::fabs(alpha) * magnitude + std::fabs(beta * old));
+                        ok = std::fabs(c[static_cast<size_t>(i) * ldc + j] - expected) <= bound;
+                    }
+                }
+                // Padding past each row of C must be left alone
+                for (int i = 0; i < s.m && ok; ++i) {
+                    ok = c[static_cast<size_t>(i) * ldc + s.n] == c0[static_cast<size_t>(i) * ldc + s.n];
+                }
+                expect(ok, "gemm<" + type + "> " + std::to_string(s.m) + "x" + std::to_string(s.n) + "x" +
+                               std::to_string(s.k) + (a_t ? " A^T" : " A") + (b_t ? " B^T" : " B"));
+            }
+        }
+    }
+}
+
+// gemm() split over a pool against the same call on one thread. The pool only cuts C into
+// blocks, so every element must come out the same bits, epilogues included.
+template <typename T>
+void check_gemm_pool(const std::string& type) {
+    struct Shape {
+        int m, n, k;
+    };
+    // The model's forward and weight-gradient shapes at batch 16 and 256, then one with both
+    // edges mid-tile
+    const Shape shapes[] = {{16, 500, 784}, {784, 500, 16}, {256, 500, 784}, {256, 10, 100}, {301, 403, 257}};
+    std::vector<std::unique_ptr<ThreadPool>> pools;
+    for (int threads : {2, 3, 7}) {
+        pools.push_back(std::make_unique<ThreadPool>(threads));
+    }
+    uint64_t stream = 3500;
+    for (const Shape& s : shapes) {
+        for (Transpose ta : {Transpose::NO, Transpose::YES}) {
+            for (Transpose tb : {Transpose::NO, Transpose::YES}) {
+                const int lda = ta == Transpose::YES ? s.m : s.k, ldb = tb == Transpose::YES ? s.k : s.n;
+                std::vector<T> a(static_cast<size_t>(s.m) * s.k), b(static_cast<size_t>(s.k) * s.n), bias(s.n);
+                std::vector<T> c0(static_cast<size_t>(s.m) * s.n);
+                rng::fill_uniform(a.data(), a.size(), -1.0, 1.0, stream++);
+                rng::fill_uniform(b.data(), b.size(), -1.0, 1.0, stream++);
+                rng::fill_uniform(bias.data(), bias.size(), -1.0, 1.0, stream++);
+                rng::fill_uniform(c0.data(), c0.size(), -1.0, 1.0, stream++);
+                for (Epilogue e : {Epilogue::NONE, Epilogue::BIAS_RELU, Epilogue::BIAS_SOFTMAX}) {
+                    // beta = 1 with NONE, so C's old values have to be read by the right block
+                    const double beta = e == Epilogue::NONE ? 1.0 : 0.0;
+                    std::vector<T> expected = c0;
+                    gemm(ta, tb, s.m, s.n, s.k, 1.0, a.data(), lda, b.data(), ldb, beta, expected.data(), s.n, e,
+                         bias.data());
+                    for (const auto& pool : pools) {
+                        std::vector<T> actual = c0;
+                        gemm(ta, tb, s.m, s.n, s.k, 1.0, a.data(), lda, b.data(), ldb, beta, actual.data(), s.n, e,
+                             bias.data(), pool.get());
+                        expect(same(expected.data(), actual.data(), expected.size()),
+                               "gemm<" + type + "> on " + std::to_string(pool->size()) + " threads " +
+                                   std::to_string(s.m) + "x" + std::to_string(s.n) + "x" + std::to_string(s.k) +
+                                   (ta == Transpose::YES ? " A^T" : " A") + (tb == Transpose::YES ? " B^T" : " B") +
+                                   " epilogue " + std::to_string(static_cast<int>(e)));
+                    }
+                }
+            }
+        }
+    }
+}
+
+// The optimizer update rules for one parameter in double, with the sum of the magnitudes that
+// went into each result. Bounds scale with those rather than the result, so a value that
+// cancels to nearly zero isn't held to a tighter bound than its inputs allow.
+struct UpdateReference {
+    double param, first, second;
+    double param_magnitude, first_magnitude, second_magnitude;
+};
+
+UpdateReference momentum_reference(double param, double grad, double velocity, double learning_rate,
+                                   double momentum, double weight_decay, bool nesterov) {
+    UpdateReference r{};
+    const double g = grad + weight_decay * param, g_magnitude = std::fabs(grad) + weight_decay * std::fabs(param);
+    r.first = momentum * velocity + g;
+    r.first_magnitude = momentum * std::fabs(velocity) + g_magnitude;
+    r.param = param - learning_rate * (nesterov ? g + momentum * r.first : r.first);
+    r.param_magnitude =
+        std::fabs(param) + learning_rate * (nesterov ? g_magnitude + momentum * r.first_magnitude : r.first_magnitude);
+    return r;
+}
+
+UpdateReference adam_reference(double param, double grad, double m, double v, const AdamCoefficients<double>& c) {
+    UpdateReference r{};
+    const double g = grad + c.l2 * param, g_magnitude = std::fabs(grad) + c.l2 * std::fabs(param);
+    r.first = c.beta1 * m + (1 - c.beta1) * g;
+    r.first_magnitude = c.beta1 * std::fabs(m) + (1 - c.beta1) * g_magnitude;
+    r.second = c.beta2 * v + (1 - c.beta2) * g * g;
+    r.second_magnitude = c.beta2 * v + (1 - c.beta2) * g_magnitude * g_magnitude;
+    const double denominator = std::sqrt(r.second) * c.inv_sqrt_bias2 + c.epsilon;
+    r.param = c.decay * param - c.step_size * r.first / denominator;
+    r.param_magnitude = c.decay * std::fabs(param) + c.step_size * r.first_magnitude / denominator;
+    return r;
+}
+
+// Adam's coefficients for step t, worked out in A like BasicOptimizer does
+template <typename A>
+AdamCoefficients<A> adam_coefficients(const OptimizerConfig& config, int t) {
+    const bool decoupled = config.type == OptimizerType::ADAMW;
+    AdamCoefficients<A> c;
+    c.beta1 = static_cast<A>(config.beta1);
+    c.beta2 = static_cast<A>(config.beta2);
+    c.epsilon = static_cast<A>(config.epsilon);
+    c.step_size = static_cast<A>(config.learning_rate / (1.0 - std::pow(config.beta1, t)));
+    c.inv_sqrt_bias2 = static_cast<A>(1.0 / std::sqrt(1.0 - std::pow(config.beta2, t)));
+    c.l2 = decoupled ? A(0) : static_cast<A>(config.weight_decay);
+    c.decay = decoupled ? A(1) - static_cast<A>(config.learning_rate) * static_cast<A>(config.weight_decay) : A(1);
+    return c;
+}
+
+template <typename A>
+AdamCoefficients<double> widened(const AdamCoefficients<A>& c) {
+    return {c.beta1, c.beta2, c.epsilon, c.step_size, c.inv_sqrt_bias2, c.l2, c.decay};
+}
+
+// Every ISA's KernelTable up to the one in use (KERNEL_ISA lowers it) against plain loops in
+// double, and against the scalar table. Kernels that do the same operations in the same order
+// on every ISA (relu_backward, bias_backward, dequantize_u8) must match exactly. The rest
+// may use FMA or sum in lanes, so each value has to be within a few ulps of the magnitudes
+// that went into it, and twice that of the scalar table.
+template <typename T>
+void check_kernel_isas(const std::string& type) {
+    struct Case {
+        std::string name;
+        std::function<std::vector<T>(const KernelTable<T>&)> run;
+        std::vector<double> reference, magnitude;
+        double ulps;
+    };
+    std::vector<Case> cases;
+    const double eps = static_cast<double>(std::numeric_limits<T>::epsilon());
+    auto random = [](size_t n, double lo, double hi, uint64_t stream) {
+        std::vector<T> v(n);
+        rng::fill_uniform(v.data(), n, lo, hi, stream);
+        return v;
+    };
+    auto add_exact = [&cases](const std::string& name, std::function<std::vector<T>(const KernelTable<T>&)> run,
+                              const std::vector<T>& expected) {
+        std::vector<double> reference(expected.begin(), expected.end());
+        cases.push_back({name, std::move(run), reference, reference, 0.0});
+    };
+
+    // Lengths that leave a tail after every vector width
+    const size_t n = 1027;
+    const std::vector<T> x = random(n, -1.0, 1.0, 5000), dy = random(n, -1.0, 1.0, 5001);
+    std::vector<T> dx(n);
+    for (size_t i = 0; i < n; ++i) {
+        dx[i] = x[i] > T(0) ? dy[i] : T(0);
+    }
+    add_exact("relu_backward", [&](const KernelTable<T>& k) {
+        std::vector<T> out(n);
+        k.relu_backward(x.data(), dy.data(), out.data(), n);
+        return out;
+    }, dx);
+
+    for (int cols : {3, 37}) {
+        const int rows = 5;
+        const std::vector<T> logits = random(static_cast<size_t>(rows) * cols, -8.0, 8.0, 5002 + cols);
+        std::vector<double> probs(logits.size());
+        for (int r = 0; r < rows; ++r) {
+            const T* in = logits.data() + static_cast<size_t>(r) * cols;
+            const double max = static_cast<double>(*std::max_element(in, in + cols));
+            double sum = 0;
+            for (int j = 0; j < cols; ++j) {
+                sum += std::exp(static_cast<double>(in[j]) - max);
+            }
+            for (int j = 0; j < cols; ++j) {
+                probs[static_cast<size_t>(r) * cols + j] = std::exp(static_cast<double>(in[j]) - max) / sum;
+            }
+        }
+        // exp, a sum of cols positive terms and a division
+        cases.push_back({"softmax_rows " + std::to_string(rows) + "x" + std::to_string(cols),
+                         [logits, rows, cols](const KernelTable<T>& k) {
+                             std::vector<T> out(logits.size());
+                             k.softmax_rows(logits.data(), out.data(), rows, cols);
+                             return out;
+                         },
+                         probs, probs, cols + 4.0});
+
+        // With a ReLU mask and beta 0, then without and beta 1; columns are summed in row order
+        // on every ISA
+        const std::vector<T> g = random(logits.size(), -1.0, 1.0, 5100 + cols);
+        const std::vector<T> db0 = random(cols, -1.0, 1.0, 5200 + cols);
+        for (bool masked : {true, false}) {
+            std::vector<T> expected(masked ? logits.size() + cols : static_cast<size_t>(cols));
+            T* db = expected.data();
+            T* dy_out = db + cols;
+            std::copy(db0.begin(), db0.end(), db);
+            for (int j = 0; masked && j < cols; ++j) {
+                db[j] = T(0);
+            }
+            for (int r = 0; r < rows; ++r) {
+                for (int j = 0; j < cols; ++j) {
+                    const size_t at = static_cast<size_t>(r) * cols + j;
+                    T v = g[at];
+                    if (masked) {
+                        v = logits[at] > T(0) ? v : T(0);
+                        dy_out[at] = v;
+                    }
+                    db[j] += v;
+                }
+            }
+            add_exact(std::string("bias_backward ") + (masked ? "with mask " : "") + std::to_string(rows) + "x" +
+                          std::to_string(cols),
+                      [logits, g, db0, rows, cols, masked](const KernelTable<T>& k) {
+                          std::vector<T> out(masked ? logits.size() + cols : static_cast<size_t>(cols));
+                          std::copy(db0.begin(), db0.end(), out.begin());
+                          k.bias_backward(g.data(), masked ? logits.data() : nullptr, out.data() + cols, out.data(),
+                                          rows, cols, masked ? T(0) : T(1));
+                          return out;
+                      },
+                      expected);
+        }
+    }
+
+    // mul then add on every ISA, so every table rounds like this loop
+    std::vector<uint8_t> pixels(n);
+    for (size_t i = 0; i < n; ++i) {
+        pixels[i] = static_cast<uint8_t>(i * 37);
+    }
+    const T scale = T(1) / T(255), offset = T(-0.5);
+    std::vector<T> dequantized(n);
+    for (size_t i = 0; i < n; ++i) {
+        const T scaled = scale * static_cast<T>(pixels[i]);
+        dequantized[i] = offset + scaled;
+    }
+    add_exact("dequantize_u8", [&](const KernelTable<T>& k) {
+        std::vector<T> out(n);
+        k.dequantize_u8(pixels.data(), out.data(), n, scale, offset);
+        return out;
+    }, dequantized);
+
+    // Updates return the parameters followed by each state slot
+    const std::vector<T> param = random(n, -1.0, 1.0, 5300), grad = random(n, -1.0, 1.0, 5301);
+    const std::vector<T> first = random(n, -0.1, 0.1, 5302), second = random(n, 0.0, 0.01, 5303);
+    const T lr = T(0.01), momentum = T(0.9), weight_decay = T(0.01);
+    {
+        std::vector<double> reference(n), magnitude(n);
+        for (size_t i = 0; i < n; ++i) {
+            reference[i] = static_cast<double>(param[i]) - static_cast<double>(lr) * static_cast<double>(grad[i]);
+            magnitude[i] = std::fabs(static_cast<double>(param[i])) + static_cast<double>(lr) * std::fabs(grad[i]);
+        }
+        cases.push_back({"sgd_update",
+                         [&](const KernelTable<T>& k) {
+                             std::vector<T> out = param;
+                             k.sgd_update(out.data(), grad.data(), lr, n);
+                             return out;
+                         },
+                         reference, magnitude, 4.0});
+    }
+    for (bool nesterov : {false, true}) {
+        std::vector<double> reference(2 * n), magnitude(2 * n);
+        for (size_t i = 0; i < n; ++i) {
+            const UpdateReference r =
+                momentum_reference(param[i], grad[i], first[i], lr, momentum, weight_decay, nesterov);
+            reference[i] = r.param;
+            magnitude[i] = r.param_magnitude;
+            reference[n + i] = r.first;
+            magnitude[n + i] = r.first_magnitude;
+        }
+        cases.push_back({nesterov ? "momentum_update nesterov" : "momentum_update",
+                         [&, nesterov](const KernelTable<T>& k) {
+                             std::vector<T> out = param;
+                             out.insert(out.end(), first.begin(), first.end());
+                             k.momentum_update(out.data(), grad.data(), out.data() + n, n, lr, momentum, weight_decay,
+                                               nesterov);
+                             return out;
+                         },
+                         reference, magnitude, 8.0});
+    }
+    for (bool decoupled : {false, true}) {
+        // Step 3 of Adam or AdamW
+        OptimizerConfig config = optimizer_config(decoupled ? "adamw" : "adam");
+        config.weight_decay = 0.01;
+        const AdamCoefficients<T> c = adam_coefficients<T>(config, 3);
+        const AdamCoefficients<double> wide = widened(c);
+        std::vector<double> reference(3 * n), magnitude(3 * n);
+        for (size_t i = 0; i < n; ++i) {
+            const UpdateReference r = adam_reference(param[i], grad[i], first[i], second[i], wide);
+            reference[i] = r.param;
+            magnitude[i] = r.param_magnitude;
+            reference[n + i] = r.first;
+            magnitude[n + i] = r.first_magnitude;
+            reference[2 * n + i] = r.second;
+            magnitude[2 * n + i] = r.second_magnitude;
+        }
+        cases.push_back({decoupled ? "adam_update adamw" : "adam_update",
+                         [&, c](const KernelTable<T>& k) {
+                             std::vector<T> out = param;
+                             out.insert(out.end(), first.begin(), first.end());
+                             out.insert(out.end(), second.begin(), second.end());
+                             k.adam_update(out.data(), grad.data(), out.data() + n, out.data() + 2 * n, n, c);
+                             return out;
+                         },
+                         reference, magnitude, 16.0});
+    }
+
+    auto within = [eps](const std::vector<T>& x, const std::vector<double>& y, const std::vector<double>& magnitude,
+                        double ulps) {
+        for (size_t i = 0; i < x.size(); ++i) {
+            if (!(std::fabs(static_cast<double>(x[i]) - y[i]) <= ulps * eps * magnitude[i])) {
+                return false;
+            }
+        }
+        return x.size() == y.size();
+    };
+    const Isa top = kernels<T>().isa;
+    for (const Case& c : cases) {
+        const std::vector<T> scalar = c.run(kernels<T>(Isa::SCALAR));
+        const std::vector<double> scalar_wide(scalar.begin(), scalar.end());
+        for (Isa isa : {Isa::SCALAR, Isa::SSE2, Isa::AVX2, Isa::AVX512}) {
+            if (isa > top) {
+                break;
+            }
+            const KernelTable<T>& k = kernels<T>(isa);
+            const std::string what = "kernels<" + type + "> " + isa_name(isa) + " " + c.name;
+            expect(k.isa == isa, what + ": table is built for this ISA");
+            const std::vector<T> out = c.run(k);
+            expect(within(out, c.reference, c.magnitude, c.ulps), what + " matches the plain loop");
+            expect(within(out, scalar_wide, c.magnitude, 2 * c.ulps), what + " matches the scalar table");
+        }
+    }
+}
+
+template <typename T>
+BasicModel<T> make_model() {
+    BasicModel<T> model(6);
+    model.add_layer(LayerType::LINEAR, 784, 500);
+    model.add_layer(LayerType::RELU, 500, 500);
+    model.add_layer(LayerType::LINEAR, 500, 100);
+    model.add_layer(LayerType::RELU, 100, 100);
+    model.add_layer(LayerType::LINEAR, 100, 10);
+    model.add_layer(LayerType::SOFTMAX, 10, 10);
+    model.initialize(WeightInit::HE, rng::DEFAULT_SEED);
+    return model;
+}
+
+// Random inputs in [0, 1) and labels in [0, 10), the same for a given stream
+template <typename T>
+void random_batch(BasicTensor<T>& input, BasicTensor<T>& labels, int rows, uint64_t stream) {
+    input.resize(rows, 784);
+    labels.resize(rows, 1);
+    rng::fill_uniform(input.data.data(), input.total_size, 0.0, 1.0, stream);
+    rng::Stream draws(stream + 1);
+    for (int r = 0; r < rows; ++r) {
+        labels.data[r] = static_cast<T>(static_cast<float>(draws.below(10)));
+    }
+}
+
+// Every LINEAR layer's weight and bias gradients byte for byte
+template <typename T>
+bool same_grads(const BasicModel<T>& a, const BasicModel<T>& b) {
+    for (size_t l = 0; l < a.layers.size(); ++l) {
+        const BasicLayer<T>& x = *a.layers[l];
+        const BasicLayer<T>& y = *b.layers[l];
+        if (x.weights && (!same(x.weights->grad.data(), y.weights->grad.data(), x.weights->total_size) ||
+                          !same(x.bias->grad.data(), y.bias->grad.data(), x.bias->total_size))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// The fused LINEAR+RELU and LINEAR+SOFTMAX steps against one step per layer. With bf16 the
+// fused softmax reads the logits before they are rounded to bf16 and the unfused one after,
+// so their probabilities may be a few bf16 ulps apart; every other result has to be equal.
+template <typename T>
+void check_fusion(const std::string& type) {
+    auto probabilities_match = [](const T* a, const T* b, size_t n) {
+        return std::is_same<T, bf16>::value ? close(a, b, n, 1.0 / 64) : same(a, b, n);
+    };
+    BasicModel<T> fused = make_model<T>();
+    BasicModel<T> unfused = fused.template cast<T>();
+    unfused.fusion = false;
+    unfused.fuse();
+
+    BasicTensor<T> input(std::vector<int>{1, 784});
+    BasicTensor<T> labels(std::vector<int>{1, 1});
+    BasicTensor<T> expected(std::vector<int>{1, 10});
+    BasicTensor<T> actual(std::vector<int>{1, 10});
+    for (int batch : {1, 7, 64}) {
+        const std::string what = "fusion<" + type + "> batch " + std::to_string(batch) + ": ";
+        random_batch(input, labels, batch, 4000 + batch);
+        const size_t outputs = static_cast<size_t>(batch) * 10;
+
+        infer(unfused, input, expected);
+        infer(fused, input, actual);
+        expect(probabilities_match(expected.data.data(), actual.data.data(), outputs), what + "infer");
+
+        BasicTensor<T>& out_unfused = forward(unfused, input);
+        BasicTensor<T>& out_fused = forward(fused, input);
+        expect(probabilities_match(out_unfused.data.data(), out_fused.data.data(), outputs), what + "forward");
+
+        // forward_loss() takes the softmax from the logits either way, so from here on the
+        // two have to agree exactly
+        const double loss_unfused = forward_loss(unfused, input, labels, unfused.workspace, batch);
+        const double loss_fused = forward_loss(fused, input, labels, fused.workspace, batch);
+        expect(loss_unfused == loss_fused, what + "forward_loss loss");
+        expect(same(out_unfused.data.data(), out_fused.data.data(), outputs), what + "forward_loss probabilities");
+
+        Utils::zero_grad(unfused);
+        Utils::zero_grad(fused);
+        backward(unfused, out_unfused, labels);
+        backward(fused, out_fused, labels);
+        expect(same_grads(unfused, fused), what + "backward");
+    }
+}
+
+// The fused log-sum-exp softmax cross-entropy against softmax_rows() then
+// cross_entropy_grad(), and its loss against log-sum-exp in double. The large logits make
+// some predictions so confident that log(p) of a rounded p would lose the loss entirely.
+template <typename T>
+void check_softmax_cross_entropy(const std::string& type) {
+    using A = acc_t<T>;
+    const int rows = 37, cols = 10;
+    const size_t n = static_cast<size_t>(rows) * cols;
+    const double eps = std::numeric_limits<T>::epsilon();
+    uint64_t stream = 5000;
+    for (double spread : {1.0, 8.0, 40.0}) {
+        const std::string what = "softmax_cross_entropy<" + type + "> logits in +-" + std::to_string(int(spread)) +
+                                 ": ";
+        std::vector<T> logits(n), labels(rows), probs(n), separate(n);
+        std::vector<A> grad(n), separate_grad(n);
+        rng::fill_uniform(logits.data(), n, -spread, spread, stream++);
+        rng::Stream draws(stream++);
+        for (int r = 0; r < rows; ++r) {
+            labels[r] = static_cast<T>(draws.below(cols));
+        }
+        const A scale = A(1) / rows;
+
+        const double loss =
+            ops::softmax_cross_entropy(logits.data(), labels.data(), probs.data(), grad.data(), rows, cols, scale);
+        ops::softmax_rows(logits.data(), separate.data(), rows, cols);
+        ops::cross_entropy_grad(separate.data(), labels.data(), separate_grad.data(), rows, cols, scale);
+        // Each probability a few roundings apart, each gradient (p - 1 or p, times scale) too
+        bool probs_ok = true, grad_ok = true;
+        for (size_t i = 0; i < n; ++i) {
+            const double p = separate[i];
+            probs_ok = probs_ok && std::fabs(double(probs[i]) - p) <= 4 * eps * p;
+            grad_ok = grad_ok && std::fabs(double(grad[i]) - double(separate_grad[i])) <= 4 * eps * scale;
+        }
+        expect(probs_ok, what + "probabilities");
+        expect(grad_ok, what + "gradient");
+
+        double expected = 0.0, bound = 0.0;
+        for (int r = 0; r < rows; ++r) {
+            const T* z = logits.data() + static_cast<size_t>(r) * cols;
+            const double top = *std::max_element(z, z + cols);
+            double sum = 0.0;
+            for (int j = 0; j < cols; ++j) {
+                sum += std::exp(double(z[j]) - top);
+            }
+            const double target = z[static_cast<int>(labels[r])];
+            expected += top + std::log(sum) - target;
+            bound += 8 * eps * (std::fabs(top) + std::fabs(target) + std::log(double(cols)) + 1);
+        }
+        expect(std::fabs(loss - expected) <= bound, what + "loss");
+    }
+}
+
+// backward() on LINEAR -> RELU -> LINEAR -> SOFTMAX against the gradients worked out in double
+// with plain loops, overwriting garbage with accumulate = false and then adding a second copy
+// with accumulate = true
+template <typename T>
+void check_linear_backward(const std::string& type) {
+    using G = acc_t<T>;
+    const int in = 13, hidden = 9, out = 5;
+    BasicModel<T> model(4);
+    model.add_layer(LayerType::LINEAR, in, hidden);
+    model.add_layer(LayerType::RELU, hidden, hidden);
+    model.add_layer(LayerType::LINEAR, hidden, out);
+    model.add_layer(LayerType::SOFTMAX, out, out);
+    model.initialize(WeightInit::HE, rng::DEFAULT_SEED);
+    const T* w[2] = {model.layers[0]->weights->data.data(), model.layers[2]->weights->data.data()};
+    const T* b[2] = {model.layers[0]->bias->data.data(), model.layers[2]->bias->data.data()};
+    const double eps = std::numeric_limits<G>::epsilon();
+
+    for (int batch : {1, 19}) {
+        const std::string what = "linear_backward<" + type + "> batch " + std::to_string(batch) + ": ";
+        BasicTensor<T> input(std::vector<int>{batch, in});
+        BasicTensor<T> labels(std::vector<int>{batch, 1});
+        rng::fill_uniform(input.data.data(), input.total_size, -1.0, 1.0, 6000 + batch);
+        rng::Stream draws(6100 + batch);
+        for (int r = 0; r < batch; ++r) {
+            labels.data[r] = static_cast<T>(static_cast<float>(draws.below(out)));
+        }
+
+        // Reference: h = relu(x W0 + b0), p = softmax(h W1 + b1), dz = (p - onehot) / batch
+        std::vector<double> h(static_cast<size_t>(batch) * hidden), dz(static_cast<size_t>(batch) * out);
+        std::vector<double> dh(h.size(), 0.0);
+        std::vector<double> dw0(static_cast<size_t>(in) * hidden, 0.0), db0(hidden, 0.0);
+        std::vector<double> dw1(static_cast<size_t>(hidden) * out, 0.0), db1(out, 0.0);
+        for (int r = 0; r < batch; ++r) {
+            const T* x = input.data.data() + static_cast<size_t>(r) * in;
+            double* hr = h.data() + static_cast<size_t>(r) * hidden;
+            double* z = dz.data() + static_cast<size_t>(r) * out;
+            for (int j = 0; j < hidden; ++j) {
+                double sum = b[0][j];
+                for (int p = 0; p < in; ++p) {
+                    sum += double(x[p]) * double(w[0][p * hidden + j]);
+                }
+                hr[j] = std::max(sum, 0.0);
+            }
+            double top = -1e300, total = 0.0;
+            for (int j = 0; j < out; ++j) {
+                double sum = b[1][j];
+                for (int p = 0; p < hidden; ++p) {
+                    sum += hr[p] * double(w[1][p * out + j]);
+                }
+                z[j] = sum;
+                top = std::max(top, sum);
+            }
+            for (int j = 0; j < out; ++j) {
+                z[j] = std::exp(z[j] - top);
+                total += z[j];
+            }
+            for (int j = 0; j < out; ++j) {
+                z[j] = (z[j] / total - (j == static_cast<int>(labels.data[r]) ? 1.0 : 0.0)) / batch;
+            }
+            for (int j = 0; j < out; ++j) {
+                db1[j] += z[j];
+                for (int p = 0; p < hidden; ++p) {
+                    dw1[p * out + j] += hr[p] * z[j];
+                    dh[static_cast<size_t>(r) * hidden + p] += hr[p] > 0.0 ? z[j] * double(w[1][p * out + j]) : 0.0;
+                }
+            }
+            for (int j = 0; j < hidden; ++j) {
+                const double d = dh[static_cast<size_t>(r) * hidden + j];
+                db0[j] += d;
+                for (int p = 0; p < in; ++p) {
+                    dw0[p * hidden + j] += double(x[p]) * d;
+                }
+            }
+        }
+
+        // Within a few roundings per term of the largest value of each gradient
+        auto matches = [&](const G* got, const std::vector<double>& expected, double copies) {
+            double largest = 0.0;
+            for (double e : expected) {
+                largest = std::max(largest, std::fabs(e));
+            }
+            const double bound = 16 * (in + hidden + out + batch) * eps * copies * largest;
+            for (size_t i = 0; i < expected.size(); ++i) {
+                if (!(std::fabs(double(got[i]) - copies * expected[i]) <= bound)) {
+                    return false;
+                }
+            }
+            return true;
+        };
+        auto check_all = [&](double copies, const std::string& mode) {
+            expect(matches(model.workspace.weight_grad(model, 0), dw0, copies), what + mode + " dW0");
+            expect(matches(model.workspace.bias_grad(model, 0), db0, copies), what + mode + " db0");
+            expect(matches(model.workspace.weight_grad(model, 2), dw1, copies), what + mode + " dW1");
+            expect(matches(model.workspace.bias_grad(model, 2), db1, copies), what + mode + " db1");
+        };
+
+        for (auto& layer : model.layers) {
+            if (layer->weights) {
+                std::fill(layer->weights->grad.data(), layer->weights->grad.data() + layer->weights->total_size, G(7));
+                std::fill(layer->bias->grad.data(), layer->bias->grad.data() + layer->bias->total_size, G(7));
+            }
+        }
+        forward_loss(model, input, labels, model.workspace, batch);
+        backward(model, model.workspace.outputs.back(), labels, model.workspace, false);
+        check_all(1.0, "overwrite");
+        // backward() reuses the buffer the logit gradient is in, so recompute it first
+        forward_loss(model, input, labels, model.workspace, batch);
+        backward(model, model.workspace.outputs.back(), labels, model.workspace, true);
+        check_all(2.0, "accumulate");
+    }
+}
+
+// StaticModel runs the same kernels as Model, so every path has to give the same bits
+template <typename T>
+void check_static_model(const std::string& type) {
+    BasicModel<T> model = make_model<T>();
+    model.pack_parameters();
+    BasicStaticModel<T, Linear<784, 500>, ReLU, Linear<500, 100>, ReLU, Linear<100, 10>, Softmax> fixed(model);
+
+    BasicTensor<T> input(std::vector<int>{1, 784});
+    BasicTensor<T> labels(std::vector<int>{1, 1});
+    BasicTensor<T> expected(std::vector<int>{1, 10});
+    BasicTensor<T> actual(std::vector<int>{1, 10});
+    for (int batch : {1, 7, 64}) {
+        const std::string what = "static_model<" + type + "> batch " + std::to_string(batch) + ": ";
+        random_batch(input, labels, batch, 2000 + batch);
+        const size_t outputs = static_cast<size_t>(batch) * 10;
+
+        infer(model, input, expected);
+        fixed.infer(input, actual);
+        expect(same(expected.data.data(), actual.data.data(), outputs), what + "infer");
+
+        const BasicTensor<T>& forward_model = forward(model, input);
+        const BasicTensor<T>& forward_fixed = fixed.forward(input);
+        expect(same(forward_model.data.data(), forward_fixed.data.data(), outputs), what + "forward");
+
+        const double loss_model = forward_loss(model, input, labels, model.workspace, batch);
+        const double loss_fixed = fixed.forward_loss(input, labels, batch);
+        expect(loss_model == loss_fixed, what + "forward_loss loss");
+        // Both outputs are the same tensors forward() returned, now holding the probabilities
+        expect(same(forward_model.data.data(), forward_fixed.data.data(), outputs), what + "forward_loss probabilities");
+
+        backward(model, model.workspace.outputs.back(), labels, model.workspace, false);
+        fixed.backward(false);
+        expect(same(model.gradients.data(), fixed.gradients.data(), model.gradients.size()), what + "backward");
+    }
+}
+
+// infer() runs batches of up to GEMV_MAX_ROWS rows through gemv() instead of the blocked GEMM
+// forward() uses, so the two sum in a different order. The probabilities come out around ten
+// ulps apart, the check allows 256, far less than a wrong row or column would give. A
+// SpinTeam only splits the gemv() columns across its workers, so with one the result must be
+// the same bits as without.
+template <typename T>
+void check_small_batch_infer(const std::string& type) {
+    const double rel = 256 * static_cast<double>(std::numeric_limits<T>::epsilon());
+    BasicModel<T> model = make_model<T>();
+    auto team = std::make_shared<SpinTeam>(3);
+
+    BasicTensor<T> input(std::vector<int>{1, 784});
+    BasicTensor<T> labels(std::vector<int>{1, 1});
+    BasicTensor<T> alone(std::vector<int>{1, 10});
+    BasicTensor<T> with_team(std::vector<int>{1, 10});
+    for (int batch = 1; batch <= GEMV_MAX_ROWS; ++batch) {
+        const std::string what = "infer<" + type + "> batch " + std::to_string(batch) + ": ";
+        random_batch(input, labels, batch, 2500 + batch);
+        const size_t outputs = static_cast<size_t>(batch) * 10;
+
+        const BasicTensor<T>& expected = forward(model, input);
+        model.set_inference_team(nullptr);
+        infer(model, input, alone);
+        model.set_inference_team(team);
+        infer(model, input, with_team);
+        model.set_inference_team(nullptr);
+
+        expect(close(alone.data.data(), expected.data.data(), outputs, rel), what + "matches forward");
+        expect(same(with_team.data.data(), alone.data.data(), outputs), what + "with a team matches without");
+    }
+}
+
+// Every int8 GEMM the host can run, up to the one KERNEL_ISA picks, against a plain int32
+// loop over the unpadded k. The integer results have to match exactly, including rows of
+// 127 against weights of +-127, the largest sums pmaddubsw's int16 pairs have to hold.
+void check_gemm_u8s8() {
+    struct Shape {
+        int rows, cols, input;
+    };
+    const Shape shapes[] = {{1, 10, 100}, {3, 17, 784}, {4, 33, 64}, {7, 5, 1}, {16, 500, 784}};
+    rng::Stream draws(6000);
+    for (const Shape& s : shapes) {
+        const int k = (s.input + INT8_K_ALIGN - 1) / INT8_K_ALIGN * INT8_K_ALIGN;
+        std::vector<uint8_t> x(static_cast<size_t>(s.rows) * k, 0);
+        std::vector<int8_t> w(static_cast<size_t>(s.cols) * k, 0);
+        for (int r = 0; r < s.rows; ++r) {
+            for (int i = 0; i < s.input; ++i) {
+                x[static_cast<size_t>(r) * k + i] = static_cast<uint8_t>(r == 0 ? 127 : draws.below(128));
+            }
+        }
+        for (int c = 0; c < s.cols; ++c) {
+            for (int i = 0; i < s.input; ++i) {
+                const int value = c == 0 ? 127 : c == 1 ? -127 : static_cast<int>(draws.below(255)) - 127;
+                w[static_cast<size_t>(c) * k + i] = static_cast<int8_t>(value);
+            }
+        }
+        std::vector<int32_t> expected(static_cast<size_t>(s.rows) * s.cols);
+        for (int r = 0; r < s.rows; ++r) {
+            for (int c = 0; c < s.cols; ++c) {
+                int32_t sum = 0;
+                for (int i = 0; i < s.input; ++i) {
+                    sum += x[static_cast<size_t>(r) * k + i] * w[static_cast<size_t>(c) * k + i];
+                }
+                expected[static_cast<size_t>(r) * s.cols + c] = sum;
+            }
+        }
+
+        const Isa top = kernels<float>().isa;
+        for (Isa isa : {Isa::SCALAR, Isa::SSE2, Isa::AVX2, Isa::AVX512}) {
+            if (isa > top) {
+                break;
+            }
+            const Int8Kernels& kernel = int8_kernels(isa);
+            std::vector<int32_t> actual(expected.size(), -1);
+            kernel.gemm_u8s8(x.data(), w.data(), actual.data(), s.rows, s.cols, k);
+            expect(actual == expected, std::string("gemm_u8s8 ") + isa_name(isa) + " (" + kernel.name + ") " +
+                                           std::to_string(s.rows) + "x" + std::to_string(s.cols) + "x" +
+                                           std::to_string(s.input) + " padded to " + std::to_string(k));
+        }
+    }
+}
+
+// The int8 model against the float one it was quantized from, on random rows it was
+// calibrated on. Quantization moves the logits a little, so every row where the float model's
+// top two probabilities are clearly apart has to get the same class, and nearly all of the
+// close ones.
+void check_quantized_model() {
+    const int rows = 256;
+    Model model = make_model<float>();
+    Dataset data(rows, 784);
+    rng::fill_uniform(data.inputs->data.data(), data.inputs->total_size, 0.0, 1.0, 6100);
+    const QuantizedModel quantized = quantize_model(model, data, rows);
+
+    Tensor expected(std::vector<int>{rows, 10});
+    Tensor actual(std::vector<int>{rows, 10});
+    infer(model, *data.inputs, expected);
+    quantized.infer(*data.inputs, actual);
+
+    int clear = 0, agree = 0, clear_agree = 0;
+    for (int r = 0; r < rows; ++r) {
+        const float* p = expected.data.data() + static_cast<size_t>(r) * 10;
+        const float* q = actual.data.data() + static_cast<size_t>(r) * 10;
+        const int best = static_cast<int>(std::max_element(p, p + 10) - p);
+        const int quantized_best = static_cast<int>(std::max_element(q, q + 10) - q);
+        float second = 0;
+        for (int j = 0; j < 10; ++j) {
+            second = j != best ? std::max(second, p[j]) : second;
+        }
+        agree += best == quantized_best;
+        if (p[best] - second > 0.05f) {
+            ++clear;
+            clear_agree += best == quantized_best;
+        }
+    }
+    expect(clear > 0 && clear_agree == clear, "quantized model: all " + std::to_string(clear) +
+                                                  " clear rows get the float model's class, " +
+                                                  std::to_string(clear_agree) + " do");
+    expect(agree >= rows * 95 / 100,
+           "quantized model: 95% of rows get the float model's class, " + std::to_string(agree) + " of " +
+               std::to_string(rows) + " do");
+}
+
+std::vector<char> read_file(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    return std::vector<char>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+void write_file(const std::string& path, const std::vector<char>& bytes) {
+    std::ofstream file(path, std::ios::binary);
+    file.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+}
+
+// save() then load() in both modes must give back the same parameter and optimizer state
+// bytes, and a damaged file must be refused rather than loaded
+template <typename T>
+void check_checkpoint(const std::string& type) {
+    BasicModel<T> model = make_model<T>();
+    BasicOptimizerState<T> state;
+    state.name = "adam";
+    state.step = 7;
+    state.values.resize(1234);
+    rng::fill_uniform(state.values.data(), state.values.size(), -1.0, 1.0, 7000);
+
+    const std::string path = "check_checkpoint.ckpt";
+    model.save(path, &state);
+    for (LoadMode mode : {LoadMode::COPY, LoadMode::MMAP}) {
+        const std::string what = "checkpoint<" + type + "> " + (mode == LoadMode::COPY ? "copy" : "mmap") + ": ";
+        BasicOptimizerState<T> loaded_state;
+        BasicModel<T> loaded = BasicModel<T>::load(path, mode, &loaded_state);
+        bool ok = loaded.layers.size() == model.layers.size();
+        for (size_t l = 0; ok && l < model.layers.size(); ++l) {
+            const BasicLayer<T>& x = *model.layers[l];
+            const BasicLayer<T>& y = *loaded.layers[l];
+            ok = x.layer_type == y.layer_type && !x.weights == !y.weights;
+            if (ok && x.weights) {
+                ok = x.weights->shape == y.weights->shape && x.bias->total_size == y.bias->total_size &&
+                     same(x.weights->data.data(), y.weights->data.data(), x.weights->total_size) &&
+                     same(x.bias->data.data(), y.bias->data.data(), x.bias->total_size);
+            }
+        }
+        expect(ok, what + "parameters");
+        expect(loaded_state.name == state.name && loaded_state.step == state.step &&
+                   loaded_state.values.size() == state.values.size() &&
+                   same(loaded_state.values.data(), state.values.data(), state.values.size()),
+               what + "optimizer state");
+    }
+
+    const std::vector<char> good = read_file(path);
+    auto rejected = [&](const std::vector<char>& bytes) {
+        write_file(path, bytes);
+        for (LoadMode mode : {LoadMode::COPY, LoadMode::MMAP}) {
+            try {
+                BasicOptimizerState<T> loaded_state;
+                BasicModel<T>::load(path, mode, &loaded_state);
+                return false;
+            } catch (const std::runtime_error&) {
+            }
+        }
+        return true;
+    };
+    // Field at offset within the record of layer l
+    auto layer_field = [&](std::vector<char>& bytes, int l, size_t offset) -> char* {
+        CheckpointHeader header;
+        std::memcpy(&header, bytes.data(), sizeof(header));
+        return bytes.data() + header.layers_offset + l * sizeof(CheckpointLayer) + offset;
+    };
+
+    std::vector<char> bad(good.begin(), good.end() - 1);
+    expect(rejected(bad), "checkpoint<" + type + "> truncated by a byte");
+    bad.assign(good.begin(), good.begin() + good.size() / 2);
+    expect(rejected(bad), "checkpoint<" + type + "> truncated by half");
+    bad = good;
+    bad[0] = 'X';
+    expect(rejected(bad), "checkpoint<" + type + "> bad magic");
+    // The second LINEAR no longer takes the first one's 500 outputs
+    bad = good;
+    const uint32_t width = 499;
+    std::memcpy(layer_field(bad, 2, offsetof(CheckpointLayer, input)), &width, sizeof(width));
+    expect(rejected(bad), "checkpoint<" + type + "> layer widths that do not chain");
+    bad = good;
+    uint64_t offset;
+    std::memcpy(&offset, layer_field(bad, 0, offsetof(CheckpointLayer, weights_offset)), sizeof(offset));
+    offset += 1;
+    std::memcpy(layer_field(bad, 0, offsetof(CheckpointLayer, weights_offset)), &offset, sizeof(offset));
+    expect(rejected(bad), "checkpoint<" + type + "> misaligned weights");
+    bad = good;
+    offset = good.size();
+    std::memcpy(layer_field(bad, 4, offsetof(CheckpointLayer, bias_offset)), &offset, sizeof(offset));
+    expect(rejected(bad), "checkpoint<" + type + "> bias past the end");
+    std::remove(path.c_str());
+}
+
+// One step of BasicOptimizer for every kind of update against the same rule in double over the
+// flat buffers, starting each step from the optimizer's own parameters and state so errors
+// don't pile up. The coefficients are rounded to acc_t like the optimizer does, and each value
+// may be off by a few roundings of the magnitudes that went into it. With a pool the update is
+// cut into MIN_SLICE slices, which have to give the single-thread result bit for bit.
+template <typename T>
+void check_optimizer(const std::string& type) {
+    using A = acc_t<T>;
+    const double bound = 16 * static_cast<double>(std::numeric_limits<A>::epsilon());
+    auto within = [bound](double x, double ref, double magnitude) {
+        return std::fabs(x - ref) <= bound * magnitude;
+    };
+
+    struct Case {
+        const char* name;
+        double weight_decay;
+    };
+    const Case cases[] = {{"sgd", 0.0},      {"sgd", 0.01},  {"momentum", 0.01},
+                          {"nesterov", 0.0}, {"adam", 0.01}, {"adamw", 0.01}};
+    ThreadPool pool3(3), pool7(7);
+    for (const Case& c : cases) {
+        OptimizerConfig config = optimizer_config(c.name);
+        config.weight_decay = c.weight_decay;
+        const std::string what = "optimizer: " + type + " " + c.name + (c.weight_decay ? " with weight decay" : "");
+
+        BasicModel<T> model = make_model<T>(), model3 = make_model<T>(), model7 = make_model<T>();
+        BasicOptimizer<T> optimizer(model, config), optimizer3(model3, config, &pool3),
+            optimizer7(model7, config, &pool7);
+        const size_t n = model.parameters.size();
+        const int slots = optimizer.state_slots();
+        const A lr = static_cast<A>(config.learning_rate), wd = static_cast<A>(config.weight_decay);
+        const A momentum = config.type == OptimizerType::SGD ? A(0) : static_cast<A>(config.momentum);
+        const bool nesterov = config.type == OptimizerType::NESTEROV;
+        const bool adam = config.type == OptimizerType::ADAM || config.type == OptimizerType::ADAMW;
+        expect(slots == (adam ? 2 : config.type == OptimizerType::SGD && !c.weight_decay ? 0 : 1),
+               what + " keeps the expected state");
+
+        for (int t = 1; t <= 3; ++t) {
+            rng::fill_uniform(model.gradients.data(), n, -1.0, 1.0, 4000 + t);
+            std::copy(model.gradients.begin(), model.gradients.end(), model3.gradients.begin());
+            std::copy(model.gradients.begin(), model.gradients.end(), model7.gradients.begin());
+            const std::vector<T> before = model.parameters;
+            const std::vector<A> state = optimizer.state().values;
+
+            optimizer.step();
+            optimizer3.step();
+            optimizer7.step();
+            const std::vector<A> after = optimizer.state().values;
+
+            const AdamCoefficients<double> coefficients = widened(adam_coefficients<A>(config, t));
+
+            bool ok = true;
+            for (size_t i = 0; i < n && ok; ++i) {
+                const double p = static_cast<double>(before[i]), grad = model.gradients[i];
+                UpdateReference r{};
+                if (adam) {
+                    r = adam_reference(p, grad, state[i], state[n + i], coefficients);
+                    ok = within(after[i], r.first, r.first_magnitude) &&
+                         within(after[n + i], r.second, r.second_magnitude);
+                } else if (slots == 1) {
+                    r = momentum_reference(p, grad, state[i], lr, momentum, wd, nesterov);
+                    ok = within(after[i], r.first, r.first_magnitude);
+                } else {
+                    r.param = p - lr * grad;
+                    r.param_magnitude = std::fabs(p) + lr * std::fabs(grad);
+                }
+                ok = ok && within(model.parameters[i], r.param, r.param_magnitude);
+            }
+            expect(ok, what + " step " + std::to_string(t) + " matches the double reference");
+            struct Threaded {
+                int threads;
+                const BasicModel<T>& model;
+                const BasicOptimizer<T>& optimizer;
+            };
+            for (const Threaded& other : {Threaded{3, model3, optimizer3}, Threaded{7, model7, optimizer7}}) {
+                const std::vector<A> other_state = other.optimizer.state().values;
+                expect(same(other.model.parameters.data(), model.parameters.data(), n) &&
+                           same(other_state.data(), after.data(), after.size()),
+                       what + " step " + std::to_string(t) + " on " + std::to_string(other.threads) +
+                           " threads matches 1 thread");
+            }
+        }
+    }
+}
+
+// A few Adam steps on batches whose GEMMs split into uneven blocks across the threads, saved
+// with the optimizer state like main() does
+std::vector<char> trained_checkpoint(int threads) {
+    rng::set_seed(rng::DEFAULT_SEED);
+    Model model = make_model<float>();
+    model.initialize(WeightInit::HE);
+    DataParallelTrainer trainer(model, threads, optimizer_config("adam"));
+
+    Tensor input(std::vector<int>{1, 784});
+    Tensor labels(std::vector<int>{1, 1});
+    const int batches[] = {16, 37, 5, 16};
+    uint64_t stream = 1000;
+    for (int rows : batches) {
+        random_batch(input, labels, rows, stream);
+        stream += 2;
+        trainer.step(input, labels, 1e-3);
+    }
+
+    const std::string path = "check_threads.ckpt";
+    const OptimizerState state = trainer.optimizer().state();
+    model.save(path, &state);
+    std::vector<char> bytes = read_file(path);
+    std::remove(path.c_str());
+    return bytes;
+}
+
+void check_trainer_threads() {
+    const std::vector<char> reference = trained_checkpoint(1);
+    expect(!reference.empty(), "trainer: 1-thread checkpoint was written");
+    for (int threads : {2, 3, 4, 9}) {
+        expect(trained_checkpoint(threads) == reference,
+               "trainer: " + std::to_string(threads) + "-thread checkpoint matches the 1-thread one");
+    }
+}
+
+} // namespace
+
+int main() {
+    check_gemm<float>("float");
+    check_gemm<double>("double");
+    check_gemm_pool<float>("float");
+    check_gemm_pool<double>("double");
+    check_gemm_pool<bf16>("bf16");
+    check_kernel_isas<float>("float");
+    check_kernel_isas<double>("double");
+    check_fusion<float>("float");
+    check_fusion<bf16>("bf16");
+    check_softmax_cross_entropy<float>("float");
+    check_softmax_cross_entropy<double>("double");
+    check_linear_backward<float>("float");
+    check_linear_backward<double>("double");
+    check_static_model<float>("float");
+    check_static_model<bf16>("bf16");
+    check_small_batch_infer<float>("float");
+    check_small_batch_infer<double>("double");
+    check_gemm_u8s8();
+    check_quantized_model();
+    check_checkpoint<float>("float");
+    check_checkpoint<bf16>("bf16");
+    check_checkpoint<double>("double");
+    check_optimizer<float>("float");
+    check_optimizer<double>("double");
+    check_trainer_threads();
+
+    if (failures) {
+        std::cout << failures << " check(s) failed" << std::endl;
+        return 1;
+    }
+    std::cout << "All checks passed" << std::endl;
+    return 0;
+}
@@ -0,0 +1,243 @@
+#include "../include/model.hpp"
+#include "../include/checkpoint.hpp"
+#include "../include/mapped_file.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+std::runtime_error io_error(const std::string& what, const std::string& path) {
+    return std::runtime_error(what + " " + path + ": " + std::strerror(errno));
+}
+
+uint64_t align_up(uint64_t n) {
+    return (n + CHECKPOINT_ALIGN - 1) / CHECKPOINT_ALIGN * CHECKPOINT_ALIGN;
+}
+
+const char* dtype_name(uint32_t dtype) {
+    switch (static_cast<DType>(dtype)) {
+        case DType::FLOAT32:
+            return dtype_traits<float>::name;
+        case DType::FLOAT64:
+            return dtype_traits<double>::name;
+        case DType::BFLOAT16:
+            return dtype_traits<bf16>::name;
+    }
+    return "unknown";
+}
+
+// Tensor of the given shape over count elements of the mapping, nothing is allocated
+template <typename T>
+std::unique_ptr<BasicTensor<T>> mapped_tensor(const std::vector<int>& shape, const uint8_t* data, size_t count) {
+    auto tensor = std::make_unique<BasicTensor<T>>(std::vector<int>(shape.size(), 0), false);
+    tensor->shape = shape;
+    tensor->total_size = count;
+    // Mapped read-only: writing through this pointer faults, which is what we want
+    tensor->data.borrow(reinterpret_cast<T*>(const_cast<uint8_t*>(data)), count);
+    return tensor;
+}
+
+template <typename T>
+std::unique_ptr<BasicTensor<T>> copied_tensor(const std::vector<int>& shape, const uint8_t* data, size_t count) {
+    auto tensor = std::make_unique<BasicTensor<T>>(shape, true);
+    std::memcpy(tensor->data.data(), data, count * sizeof(T));
+    return tensor;
+}
+
+} // namespace
+
+template <typename T>
+void BasicModel<T>::save(const std::string& path, const BasicOptimizerState<T>* optimizer) const {
+    using A = acc_t<T>;
+    const uint32_t num_layers = static_cast<uint32_t>(layers.size());
+
+    // Lay out the records, then every blob on its own aligned offset
+    CheckpointHeader header = {};
+    std::memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic));
+    header.version = CHECKPOINT_VERSION;
+    header.header_size = sizeof(header);
+    header.dtype = static_cast<uint32_t>(dtype_traits<T>::dtype);
+    header.elem_size = sizeof(T);
+    header.num_layers = num_layers;
+    header.layers_offset = sizeof(header);
+    uint64_t offset = header.layers_offset + num_layers * sizeof(CheckpointLayer);
+
+    CheckpointOptimizer opt = {};
+    if (optimizer) {
+        if (optimizer->name.size() >= sizeof(opt.name)) {
+            throw std::runtime_error("Optimizer name too long for a checkpoint: " + optimizer->name);
+        }
+        header.flags |= CHECKPOINT_HAS_OPTIMIZER;
+        header.optimizer_offset = offset = align_up(offset);
+        offset += sizeof(opt);
+    }
+
+    std::vector<CheckpointLayer> records(num_layers);
+    for (uint32_t l = 0; l < num_layers; ++l) {
+        const BasicLayer<T>& layer = *layers[l];
+        CheckpointLayer& r = records[l];
+        r = {};
+        r.type = static_cast<uint32_t>(layer.layer_type);
+        if (layer.layer_type == LayerType::LINEAR) {
+            r.input = static_cast<uint32_t>(layer.weights->shape[0]);
+            r.output = static_cast<uint32_t>(layer.weights->shape[1]);
+            r.weights_offset = offset = align_up(offset);
+            offset += layer.weights->total_size * sizeof(T);
+            r.bias_offset = offset = align_up(offset);
+            offset += layer.bias->total_size * sizeof(T);
+        } else {
+            // Elementwise layers keep the width of whatever came before them
+            r.input = r.output = l > 0 ? records[l - 1].output : 0;
+        }
+    }
+    if (optimizer) {
+        std::memcpy(opt.name, optimizer->name.data(), optimizer->name.size());
+        opt.step = optimizer->step;
+        opt.count = optimizer->values.size();
+        opt.dtype = static_cast<uint32_t>(dtype_traits<A>::dtype);
+        opt.values_offset = offset = align_up(offset);
+        offset += opt.count * sizeof(A);
+    }
+    header.file_size = offset;
+
+    // Write to a temporary file and rename, so a crash never leaves a half checkpoint behind
+    const std::string tmp_path = path + ".tmp";
+    FILE* out = std::fopen(tmp_path.c_str(), "wb");
+    if (!out) {
+        throw io_error("Error creating", tmp_path);
+    }
+    uint64_t written = 0;
+    bool ok = true;
+    auto write_at = [&](uint64_t at, const void* data, size_t bytes) {
+        static const char zeros[CHECKPOINT_ALIGN] = {};
+        while (ok && written < at) {
+            const size_t pad = std::min<uint64_t>(at - written, sizeof(zeros));
+            ok = std::fwrite(zeros, 1, pad, out) == pad;
+            written += pad;
+        }
+        ok = ok && (bytes == 0 || std::fwrite(data, 1, bytes, out) == bytes);
+        written += bytes;
+    };
+    write_at(0, &header, sizeof(header));
+    write_at(header.layers_offset, records.data(), records.size() * sizeof(CheckpointLayer));
+    if (optimizer) {
+        write_at(header.optimizer_offset, &opt, sizeof(opt));
+    }
+    for (uint32_t l = 0; l < num_layers; ++l) {
+        if (layers[l]->layer_type == LayerType::LINEAR) {
+            write_at(records[l].weights_offset, layers[l]->weights->data.data(), layers[l]->weights->total_size * sizeof(T));
+            write_at(records[l].bias_offset, layers[l]->bias->data.data(), layers[l]->bias->total_size * sizeof(T));
+        }
+    }
+    if (optimizer) {
+        write_at(opt.values_offset, optimizer->values.data(), opt.count * sizeof(A));
+    }
+    ok = std::fclose(out) == 0 && ok;
+    if (!ok || std::rename(tmp_path.c_str(), path.c_str()) != 0) {
+        std::remove(tmp_path.c_str());
+        throw io_error("Error writing", path);
+    }
+}
+
+template <typename T>
+BasicModel<T> BasicModel<T>::load(const std::string& path, LoadMode mode, BasicOptimizerState<T>* optimizer) {
+    using A = acc_t<T>;
+    auto file = std::make_shared<MappedFile>(path);
+    const uint8_t* base = file->data();
+    const uint64_t size = file->size();
+
+    CheckpointHeader header;
+    if (size < sizeof(header)) {
+        throw std::runtime_error("Not a checkpoint: " + path);
+    }
+    std::memcpy(&header, base, sizeof(header));
+    if (std::memcmp(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic)) != 0 || header.header_size != sizeof(header)) {
+        throw std::runtime_error("Not a checkpoint: " + path);
+    }
+    if (header.version != CHECKPOINT_VERSION) {
+        throw std::runtime_error("Unsupported checkpoint version " + std::to_string(header.version) + " in " + path);
+    }
+    if (header.dtype != static_cast<uint32_t>(dtype_traits<T>::dtype) || header.elem_size != sizeof(T)) {
+        throw std::runtime_error("Checkpoint " + path + " holds " + dtype_name(header.dtype) +
+                                 " weights, load it as that type and cast() it to " + dtype_traits<T>::name);
+    }
+    if (header.file_size != size || header.layers_offset + uint64_t(header.num_layers) * sizeof(CheckpointLayer) > size) {
+        throw std::runtime_error("Truncated checkpoint: " + path);
+    }
+
+    // Every blob has to lie inside the file and, for MMAP, be aligned for T
+    auto blob = [&](uint64_t offset, uint64_t count, size_t elem) -> const uint8_t* {
+        if (offset % CHECKPOINT_ALIGN != 0 || offset > size || count > (size - offset) / elem) {
+            throw std::runtime_error("Corrupt checkpoint: " + path);
+        }
+        return base + offset;
+    };
+
+    BasicModel<T> model(static_cast<int>(header.num_layers));
+    int64_t width = -1; // Output width of the last LINEAR so far, elementwise layers keep it
+    for (uint32_t l = 0; l < header.num_layers; ++l) {
+        CheckpointLayer r;
+        std::memcpy(&r, base + header.layers_offset + l * sizeof(CheckpointLayer), sizeof(r));
+        const LayerType type = static_cast<LayerType>(r.type);
+        if (type != LayerType::LINEAR && type != LayerType::RELU && type != LayerType::SOFTMAX) {
+            throw std::runtime_error("Unknown layer type " + std::to_string(r.type) + " in checkpoint " + path);
+        }
+
+        auto layer = std::make_unique<BasicLayer<T>>(type, 0, 0);
+        if (type == LayerType::LINEAR) {
+            if (r.input > INT_MAX || r.output > INT_MAX || (width >= 0 && r.input != width)) {
+                throw std::runtime_error("Corrupt checkpoint: " + path);
+            }
+            width = r.output;
+            const std::vector<int> weight_shape = {static_cast<int>(r.input), static_cast<int>(r.output)};
+            const std::vector<int> bias_shape = {static_cast<int>(r.output)};
+            const uint64_t weight_count = uint64_t(r.input) * r.output;
+            const uint8_t* weights = blob(r.weights_offset, weight_count, sizeof(T));
+            const uint8_t* bias = blob(r.bias_offset, r.output, sizeof(T));
+            if (mode == LoadMode::MMAP) {
+                layer->weights = mapped_tensor<T>(weight_shape, weights, weight_count);
+                layer->bias = mapped_tensor<T>(bias_shape, bias, r.output);
+            } else {
+                layer->weights = copied_tensor<T>(weight_shape, weights, weight_count);
+                layer->bias = copied_tensor<T>(bias_shape, bias, r.output);
+            }
+        }
+        model.layers.push_back(std::move(layer));
+    }
+    model.fuse();
+
+    if (optimizer) {
+        *optimizer = BasicOptimizerState<T>();
+        if (header.flags & CHECKPOINT_HAS_OPTIMIZER) {
+            CheckpointOptimizer opt;
+            std::memcpy(&opt, blob(header.optimizer_offset, 1, sizeof(opt)), sizeof(opt));
+            if (opt.dtype != static_cast<uint32_t>(dtype_traits<A>::dtype)) {
+                throw std::runtime_error("Corrupt optimizer state in checkpoint " + path);
+            }
+            const A* values = reinterpret_cast<const A*>(blob(opt.values_offset, opt.count, sizeof(A)));
+            optimizer->name.assign(opt.name, strnlen(opt.name, sizeof(opt.name)));
+            optimizer->step = opt.step;
+            optimizer->values.assign(values, values + opt.count);
+        }
+    }
+
+    if (mode == LoadMode::MMAP) {
+        model.mapping = std::move(file);
+    }
+    return model;
+}
+
+#define INSTANTIATE_CHECKPOINT(T) \
+    template void BasicModel<T>::save(const std::string&, const BasicOptimizerState<T>*) const; \
+    template BasicModel<T> BasicModel<T>::load(const std::string&, LoadMode, BasicOptimizerState<T>*);
+
+INSTANTIATE_CHECKPOINT(float)
+INSTANTIATE_CHECKPOINT(double)
+INSTANTIATE_CHECKPOINT(bf16)
@@ -0,0 +1,111 @@
+#include "../include/data_loader.hpp"
+#include "../include/random.hpp"
+#include "../include/trace.hpp"
+
+#include <algorithm>
+#include <numeric>
+#include <stdexcept>
+
+template <typename T>
+BasicDataLoader<T>::BasicDataLoader(const Dataset& dataset, int batch_size, bool shuffle, uint64_t seed,
+                                    bool drop_last, int depth)
+    : dataset(dataset), batch_size(batch_size), shuffle(shuffle), seed(seed), drop_last(drop_last),
+      order(dataset.count) {
+    if (batch_size <= 0 || depth < 2) {
+        throw std::runtime_error("DataLoader needs a positive batch size and at least two buffers");
+    }
+    ring.reserve(depth);
+    for (int i = 0; i < depth; ++i) {
+        ring.emplace_back(batch_size, dataset.features);
+    }
+    thread = std::thread(&BasicDataLoader::producer_loop, this);
+}
+
+template <typename T>
+BasicDataLoader<T>::~BasicDataLoader() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    free_cv.notify_all();
+    thread.join();
+}
+
+template <typename T>
+int BasicDataLoader<T>::batches_per_epoch() const {
+    return drop_last ? dataset.count / batch_size : (dataset.count + batch_size - 1) / batch_size;
+}
+
+template <typename T>
+const typename BasicDataLoader<T>::Batch* BasicDataLoader<T>::next() {
+    TRACE_SCOPE("data", "wait_batch");
+    std::unique_lock<std::mutex> lock(mutex);
+    // Whatever was handed out last time is no longer in use
+    if (released < consumed) {
+        released = consumed;
+        free_cv.notify_one();
+    }
+    filled_cv.wait(lock, [this] { return produced > consumed; });
+    Batch* batch = &ring[consumed % ring.size()];
+    consumed++;
+    return batch->rows > 0 ? batch : nullptr;
+}
+
+// Waits for a free buffer, nullptr when the loader is shutting down
+template <typename T>
+typename BasicDataLoader<T>::Batch* BasicDataLoader<T>::acquire() {
+    std::unique_lock<std::mutex> lock(mutex);
+    free_cv.wait(lock, [this] { return stopping || produced - released < ring.size(); });
+    return stopping ? nullptr : &ring[produced % ring.size()];
+}
+
+template <typename T>
+void BasicDataLoader<T>::publish() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        produced++;
+    }
+    filled_cv.notify_one();
+}
+
+template <typename T>
+void BasicDataLoader<T>::producer_loop() {
+    TRACE_THREAD_NAME("data loader");
+    const int features = dataset.features;
+    const int num_batches = batches_per_epoch();
+    std::iota(order.begin(), order.end(), 0);
+
+    for (int epoch = 0;; ++epoch) {
+        if (shuffle) {
+            // Each epoch starts from the identity, so epoch e is reproducible on its own
+            std::iota(order.begin(), order.end(), 0);
+            rng::shuffle(order.data(), order.size(), rng::SHUFFLE_STREAMS + epoch, seed);
+        }
+
+        for (int b = 0; b <= num_batches; ++b) {
+            Batch* batch = acquire();
+            if (!batch) {
+                return;
+            }
+            batch->epoch = epoch;
+            batch->rows = b < num_batches ? std::min(batch_size, dataset.count - b * batch_size) : 0;
+            if (batch->rows > 0) {
+                TRACE_SCOPE("data", "assemble_batch", -1, 0.0,
+                            double(batch->rows) * features * ((dataset.quantized() ? 1 : sizeof(float)) + sizeof(T)));
+                // Shrinking or regrowing within the preallocated capacity never reallocates
+                batch->input.shape[0] = batch->rows;
+                batch->input.total_size = static_cast<size_t>(batch->rows) * features;
+                batch->input.data.resize(batch->input.total_size);
+                batch->labels.shape[0] = batch->rows;
+                batch->labels.total_size = batch->rows;
+                batch->labels.data.resize(batch->rows);
+                dataset.gather(&order[static_cast<size_t>(b) * batch_size], batch->rows, batch->input, batch->labels);
+            }
+            publish();
+        }
+    }
+}
+
+template class BasicDataLoader<float>;
+template class BasicDataLoader<double>;
+template class BasicDataLoader<bf16>;
@@ -0,0 +1,364 @@
+#include "../include/dataset.hpp"
+#include "../include/ops.hpp"
+#include "../include/trace.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+#include <sys/stat.h>
+
+namespace {
+
+std::runtime_error io_error(const std::string& what, const std::string& path) {
+    return std::runtime_error(what + " " + path + ": " + std::strerror(errno));
+}
+
+size_t align_up(size_t n) {
+    return (n + DATASET_ALIGN - 1) / DATASET_ALIGN * DATASET_ALIGN;
+}
+
+// Calls fn(pixels, label) for every "p0,p1,...;label" line, with strtod instead of streams
+void for_each_text_row(const std::string& path, const std::function<void(const std::vector<double>&, double)>& fn) {
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        throw io_error("Error opening file", path);
+    }
+
+    std::string line;
+    std::vector<double> values;
+    while (std::getline(file, line)) {
+        const size_t split = line.find(';');
+        if (split == std::string::npos) {
+            continue;
+        }
+        line[split] = '\0';
+
+        values.clear();
+        const char* p = line.c_str();
+        const char* end = p + split;
+        while (p < end) {
+            char* next;
+            values.push_back(std::strtod(p, &next));
+            if (next == p) {
+                throw std::runtime_error("Malformed pixel in " + path);
+            }
+            p = next;
+            while (p < end && (*p == ',' || *p == ' ')) {
+                ++p;
+            }
+        }
+        const char* label_text = line.c_str() + split + 1;
+        char* label_end;
+        const double label = std::strtod(label_text, &label_end);
+        while (*label_end == ' ' || *label_end == '\r' || *label_end == '\t') {
+            ++label_end;
+        }
+        if (label_end == label_text || *label_end != '\0') {
+            throw std::runtime_error("Malformed label in " + path);
+        }
+        fn(values, label);
+    }
+}
+
+// Pixel encoding shared by the binary format and Dataset::quantize(): exact for integers in
+// [0, 255], otherwise linear between min and max
+struct Encoding {
+    float scale = 1.0f;
+    float offset = 0.0f;
+
+    Encoding(double min_val, double max_val, bool integral) {
+        if (!(integral && min_val >= 0.0 && max_val <= 255.0)) {
+            scale = max_val > min_val ? static_cast<float>((max_val - min_val) / 255.0) : 1.0f;
+            offset = static_cast<float>(min_val);
+        }
+    }
+
+    uint8_t operator()(double v) const {
+        const double q = std::round((v - offset) / scale);
+        return static_cast<uint8_t>(std::min(255.0, std::max(0.0, q)));
+    }
+};
+
+bool valid_label(double label) {
+    return label >= 0 && label <= 255 && label == std::floor(label);
+}
+
+} // namespace
+
+Dataset::Dataset(int num_datapoints, int size_per_point) : count(num_datapoints), features(size_per_point) {
+    std::vector<int> shape = {num_datapoints, size_per_point};
+    inputs = std::make_unique<Tensor>(shape, false);
+    shape[0] = 1;
+    shape[1] = num_datapoints;
+    actual = std::make_unique<Tensor>(shape, false);
+}
+
+std::unique_ptr<Dataset> Dataset::map_binary(const std::string& path) {
+    auto file = std::make_shared<MappedFile>(path);
+    if (file->size() < sizeof(DatasetHeader)) {
+        throw std::runtime_error("Not a dataset file: " + path);
+    }
+    DatasetHeader header;
+    std::memcpy(&header, file->data(), sizeof(header));
+    if (std::memcmp(header.magic, DATASET_MAGIC, sizeof(header.magic)) != 0 || header.header_size != sizeof(header)) {
+        throw std::runtime_error("Not a dataset file: " + path);
+    }
+    if (header.version != DATASET_VERSION) {
+        throw std::runtime_error("Unsupported dataset version " + std::to_string(header.version) + " in " + path);
+    }
+    if (header.count > INT_MAX || header.features > INT_MAX) {
+        throw std::runtime_error("Dataset too large: " + path);
+    }
+    if (header.pixels_offset % DATASET_ALIGN != 0) {
+        throw std::runtime_error("Misaligned pixels in dataset file: " + path);
+    }
+    // Both offsets are bounded by the file size and count * row_stride by 2^63 before they
+    // are added up, so none of the sums can wrap around
+    const uint64_t size = file->size();
+    if (header.row_stride < header.features || header.pixels_offset > size || header.labels_offset > size ||
+        header.pixels_offset + header.count * header.row_stride > header.labels_offset ||
+        header.labels_offset + header.count > size) {
+        throw std::runtime_error("Truncated dataset file: " + path);
+    }
+
+    auto dataset = std::make_unique<Dataset>(0, static_cast<int>(header.features));
+    dataset->count = static_cast<int>(header.count);
+    dataset->inputs.reset();
+    dataset->actual.reset();
+    dataset->pixels = file->data() + header.pixels_offset;
+    dataset->labels = file->data() + header.labels_offset;
+    dataset->row_stride = header.row_stride;
+    dataset->scale = header.scale;
+    dataset->offset = header.offset;
+    dataset->mapping = std::move(file);
+    return dataset;
+}
+
+void Dataset::quantize() {
+    if (quantized()) {
+        return;
+    }
+    TRACE_SCOPE("data", "quantize");
+    double min_val = 0.0, max_val = 0.0;
+    bool integral = true;
+    if (inputs->total_size > 0) {
+        min_val = max_val = inputs->data[0];
+    }
+    for (size_t i = 0; i < inputs->total_size; i++) {
+        const double v = inputs->data[i];
+        min_val = std::min(min_val, v);
+        max_val = std::max(max_val, v);
+        integral = integral && v == std::floor(v);
+    }
+    for (int i = 0; i < count; i++) {
+        if (!valid_label(actual->data[i])) {
+            throw std::runtime_error("Cannot quantize label " + std::to_string(actual->data[i]) + " of row " +
+                                     std::to_string(i));
+        }
+    }
+
+    // Rows packed back to back, labels after them
+    const Encoding encode(min_val, max_val, integral);
+    const size_t n = static_cast<size_t>(count) * features;
+    storage.resize(n + count);
+    for (size_t i = 0; i < n; i++) {
+        storage[i] = encode(inputs->data[i]);
+    }
+    for (int i = 0; i < count; i++) {
+        storage[n + i] = static_cast<uint8_t>(actual->data[i]);
+    }
+    pixels = storage.data();
+    labels = storage.data() + n;
+    row_stride = features;
+    scale = encode.scale;
+    offset = encode.offset;
+    inputs.reset();
+    actual.reset();
+}
+
+int Dataset::label(int index) const {
+    return quantized() ? labels[index] : static_cast<int>(actual->data[index]);
+}
+
+template <typename T>
+void Dataset::copy_row(int index, T* out) const {
+    if (quantized()) {
+        ops::dequantize_u8(pixels + static_cast<size_t>(index) * row_stride, out, features, scale, offset);
+    } else {
+        const float* row = &inputs->data[static_cast<size_t>(index) * features];
+        for (int j = 0; j < features; j++) {
+            out[j] = T(row[j]);
+        }
+    }
+}
+
+template <typename T>
+void Dataset::fill_batch(int first, int rows, BasicTensor<T>& input, BasicTensor<T>& batch_labels) const {
+    for (int i = 0; i < rows; i++) {
+        copy_row(first + i, &input.data[static_cast<size_t>(i) * features]);
+        batch_labels.data[i] = T(static_cast<float>(label(first + i)));
+    }
+}
+
+template <typename T>
+void Dataset::gather(const int* indices, int rows, BasicTensor<T>& input, BasicTensor<T>& batch_labels) const {
+    for (int i = 0; i < rows; i++) {
+        copy_row(indices[i], &input.data[static_cast<size_t>(i) * features]);
+        batch_labels.data[i] = T(static_cast<float>(label(indices[i])));
+    }
+}
+
+TensorView<const float> Dataset::input_rows(int first, int rows) const {
+    if (quantized()) {
+        throw std::runtime_error("Cannot view the rows of a quantized dataset, copy them out with fill_batch");
+    }
+    return inputs->view().slice(0, first, first + rows);
+}
+
+template void Dataset::fill_batch(int, int, BasicTensor<float>&, BasicTensor<float>&) const;
+template void Dataset::fill_batch(int, int, BasicTensor<double>&, BasicTensor<double>&) const;
+template void Dataset::fill_batch(int, int, BasicTensor<bf16>&, BasicTensor<bf16>&) const;
+template void Dataset::gather(const int*, int, BasicTensor<float>&, BasicTensor<float>&) const;
+template void Dataset::gather(const int*, int, BasicTensor<double>&, BasicTensor<double>&) const;
+template void Dataset::gather(const int*, int, BasicTensor<bf16>&, BasicTensor<bf16>&) const;
+
+void MNIST_dataset(const std::string& filename, Dataset* dataset) {
+    std::ifstream file(filename);
+    if (!file.is_open()) {
+        std::cerr << "Error opening file: " << filename << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    std::string line;
+    int datapoint_index = 0;
+
+    while (std::getline(file, line) && datapoint_index < dataset->count) {
+        std::istringstream iss(line);
+        std::string input, actual;
+
+        if (std::getline(iss, input, ';') && std::getline(iss, actual)) {
+            std::istringstream input_stream(input);
+            std::string token;
+            int i = 0;
+            while (std::getline(input_stream, token, ',') && i < dataset->features) {
+                dataset->inputs->data[datapoint_index * dataset->features + i] = std::stod(token);
+                i++;
+            }
+
+            dataset->actual->data[datapoint_index] = std::stod(actual);
+            datapoint_index++;
+        }
+    }
+
+    file.close();
+}
+
+int convert_text_dataset(const std::string& text_path, const std::string& binary_path) {
+    TRACE_SCOPE("data", "convert_text");
+    // First pass: shape and value range
+    uint64_t count = 0;
+    size_t features = 0;
+    double min_val = 0.0, max_val = 0.0;
+    bool integral = true;
+    for_each_text_row(text_path, [&](const std::vector<double>& values, double label) {
+        if (count == 0) {
+            features = values.size();
+            min_val = max_val = values.empty() ? 0.0 : values[0];
+        } else if (values.size() != features) {
+            throw std::runtime_error("Row " + std::to_string(count) + " of " + text_path + " has " +
+                                     std::to_string(values.size()) + " pixels, expected " + std::to_string(features));
+        }
+        for (double v : values) {
+            min_val = std::min(min_val, v);
+            max_val = std::max(max_val, v);
+            integral = integral && v == std::floor(v);
+        }
+        if (!valid_label(label)) {
+            throw std::runtime_error("Label out of range in " + text_path);
+        }
+        count++;
+    });
+    if (count == 0) {
+        throw std::runtime_error("No rows in " + text_path);
+    }
+    if (count > INT_MAX || features > INT_MAX) {
+        throw std::runtime_error("Too many rows or pixels in " + text_path);
+    }
+
+    DatasetHeader header = {};
+    std::memcpy(header.magic, DATASET_MAGIC, sizeof(header.magic));
+    header.version = DATASET_VERSION;
+    header.header_size = sizeof(header);
+    header.count = count;
+    header.features = static_cast<uint32_t>(features);
+    header.row_stride = static_cast<uint32_t>(align_up(features));
+    const Encoding encode(min_val, max_val, integral);
+    header.scale = encode.scale;
+    header.offset = encode.offset;
+    header.pixels_offset = sizeof(header);
+    header.labels_offset = align_up(header.pixels_offset + count * header.row_stride);
+
+    // Second pass: write to a temporary file and rename, so a crash never leaves a half file behind
+    const std::string tmp_path = binary_path + ".tmp";
+    FILE* out = std::fopen(tmp_path.c_str(), "wb");
+    if (!out) {
+        throw io_error("Error creating", tmp_path);
+    }
+    std::vector<uint8_t> row(header.row_stride, 0);
+    std::vector<uint8_t> labels;
+    labels.reserve(count);
+    bool ok = std::fwrite(&header, sizeof(header), 1, out) == 1;
+    try {
+        for_each_text_row(text_path, [&](const std::vector<double>& values, double label) {
+            // The file may have changed since the first pass
+            if (values.size() != features || !valid_label(label) || labels.size() == count) {
+                throw std::runtime_error(text_path + " changed while it was being converted");
+            }
+            for (size_t j = 0; j < features; j++) {
+                row[j] = encode(values[j]);
+            }
+            ok = ok && std::fwrite(row.data(), 1, row.size(), out) == row.size();
+            labels.push_back(static_cast<uint8_t>(label));
+        });
+    } catch (...) {
+        std::fclose(out);
+        std::remove(tmp_path.c_str());
+        throw;
+    }
+    const std::vector<uint8_t> padding(header.labels_offset - (header.pixels_offset + count * header.row_stride), 0);
+    ok = ok && std::fwrite(padding.data(), 1, padding.size(), out) == padding.size();
+    ok = ok && std::fwrite(labels.data(), 1, labels.size(), out) == labels.size();
+    ok = std::fclose(out) == 0 && ok;
+    if (!ok || labels.size() != count || std::rename(tmp_path.c_str(), binary_path.c_str()) != 0) {
+        std::remove(tmp_path.c_str());
+        throw io_error("Error writing", binary_path);
+    }
+    return static_cast<int>(count);
+}
+
+std::unique_ptr<Dataset> load_dataset(const std::string& text_path) {
+    const size_t dot = text_path.find_last_of('.');
+    const size_t slash = text_path.find_last_of('/');
+    const bool has_ext = dot != std::string::npos && (slash == std::string::npos || dot > slash);
+    const std::string binary_path = (has_ext ? text_path.substr(0, dot) : text_path) + ".bin";
+
+    struct stat text_st, binary_st;
+    const bool have_text = ::stat(text_path.c_str(), &text_st) == 0;
+    const bool have_binary = ::stat(binary_path.c_str(), &binary_st) == 0;
+    if (!have_binary || (have_text && binary_st.st_mtime < text_st.st_mtime)) {
+        std::cout << "Converting " << text_path << " to " << binary_path << std::endl;
+        convert_text_dataset(text_path, binary_path);
+    }
+    return Dataset::map_binary(binary_path);
+}
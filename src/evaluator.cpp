@@ -0,0 +1,162 @@
+#include "../include/evaluator.hpp"
+#include "../include/trace.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+template <typename T>
+BasicEvaluator<T>::BasicEvaluator(const Dataset& dataset, int num_threads, int chunk_rows)
+    : dataset(dataset), chunk_rows(chunk_rows), pool(num_threads), queues(pool.size()), counters(pool.size()) {
+    if (chunk_rows < 1) {
+        throw std::invalid_argument("Evaluator chunks need at least one row");
+    }
+    for (int i = 0; i < dataset.count; ++i) {
+        max_label = std::max(max_label, dataset.label(i));
+    }
+    for (int w = 0; w < pool.size(); ++w) {
+        inputs.emplace_back(std::vector<int>{chunk_rows, dataset.features});
+        labels.emplace_back(std::vector<int>{chunk_rows, 1});
+        outputs.emplace_back(std::vector<int>{chunk_rows, 1});
+    }
+}
+
+template <typename T>
+EvalResult BasicEvaluator<T>::evaluate(const BasicModel<T>& model) {
+    if (model.layers.empty() || model.layers.back()->layer_type != LayerType::SOFTMAX) {
+        throw std::runtime_error("Evaluator needs a model ending in SOFTMAX");
+    }
+    EvalResult result;
+    for (const auto& layer : model.layers) {
+        if (layer->layer_type == LayerType::LINEAR) {
+            result.classes = layer->bias->shape[0];
+        }
+    }
+    if (max_label >= result.classes) {
+        throw std::runtime_error("Dataset has label " + std::to_string(max_label) + " but the model only has " +
+                                 std::to_string(result.classes) + " classes");
+    }
+    TRACE_SCOPE("eval", "evaluate");
+    const auto start = std::chrono::steady_clock::now();
+
+    // Worker w starts on the w-th contiguous run of chunks
+    const int num_chunks = (dataset.count + chunk_rows - 1) / chunk_rows;
+    for (int w = 0; w < pool.size(); ++w) {
+        auto range = ThreadPool::split(num_chunks, pool.size(), w);
+        queues[w].next = static_cast<int>(range.first);
+        queues[w].end = static_cast<int>(range.second);
+        counters[w].correct = 0;
+        counters[w].loss = 0.0;
+        counters[w].confusion.assign(static_cast<size_t>(result.classes) * result.classes, 0);
+    }
+
+    pool.run([&](int w) {
+        TRACE_SCOPE("eval", "worker");
+        int chunk;
+        while (take(w, chunk) || steal(w, chunk)) {
+            run_chunk(model, w, chunk);
+        }
+    });
+
+    result.count = dataset.count;
+    result.confusion.assign(static_cast<size_t>(result.classes) * result.classes, 0);
+    for (const Counters& c : counters) {
+        result.correct += c.correct;
+        result.loss += c.loss;
+        for (size_t i = 0; i < c.confusion.size(); ++i) {
+            result.confusion[i] += c.confusion[i];
+        }
+    }
+    result.loss = result.count ? result.loss / result.count : 0.0;
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return result;
+}
+
+template <typename T>
+bool BasicEvaluator<T>::take(int w, int& chunk) {
+    std::lock_guard<std::mutex> lock(queues[w].mutex);
+    if (queues[w].next >= queues[w].end) {
+        return false;
+    }
+    chunk = queues[w].next++;
+    return true;
+}
+
+template <typename T>
+bool BasicEvaluator<T>::steal(int w, int& chunk) {
+    while (true) {
+        // The victim is whoever has the most left, a stale guess only costs a retry
+        int victim = -1;
+        int most = 0;
+        for (int v = 0; v < pool.size(); ++v) {
+            if (v == w) {
+                continue;
+            }
+            std::lock_guard<std::mutex> lock(queues[v].mutex);
+            if (queues[v].end - queues[v].next > most) {
+                most = queues[v].end - queues[v].next;
+                victim = v;
+            }
+        }
+        if (victim < 0) {
+            return false;
+        }
+
+        int first, last;
+        {
+            std::lock_guard<std::mutex> lock(queues[victim].mutex);
+            const int left = queues[victim].end - queues[victim].next;
+            if (left <= 0) {
+                continue;
+            }
+            last = queues[victim].end;
+            first = last - (left + 1) / 2;
+            queues[victim].end = first;
+        }
+        std::lock_guard<std::mutex> lock(queues[w].mutex);
+        queues[w].next = first + 1;
+        queues[w].end = last;
+        chunk = first;
+        return true;
+    }
+}
+
+template <typename T>
+void BasicEvaluator<T>::run_chunk(const BasicModel<T>& model, int w, int chunk) {
+    const int first = chunk * chunk_rows;
+    const int rows = std::min(chunk_rows, dataset.count - first);
+    BasicTensor<T>& output = outputs[w];
+    bool in_place = false;
+    if constexpr (std::is_same<T, float>::value) {
+        if (!dataset.quantized()) {
+            // Float rows are read where they are, no copy
+            infer(model, dataset.input_rows(first, rows), output);
+            in_place = true;
+        }
+    }
+    if (!in_place) {
+        BasicTensor<T>& input = inputs[w];
+        input.resize(rows, dataset.features);
+        labels[w].resize(rows, 1);
+        dataset.fill_batch(first, rows, input, labels[w]);
+        infer(model, input, output);
+    }
+
+    Counters& c = counters[w];
+    const int classes = output.shape[1];
+    for (int i = 0; i < rows; ++i) {
+        const T* scores = &output.data[static_cast<size_t>(i) * classes];
+        const int predicted = static_cast<int>(std::max_element(scores, scores + classes) - scores);
+        const int actual = dataset.label(first + i);
+        c.correct += predicted == actual;
+        c.loss -= std::log(std::max(static_cast<double>(static_cast<acc_t<T>>(scores[actual])), 1e-7));
+        c.confusion[static_cast<size_t>(actual) * classes + predicted]++;
+    }
+}
+
+template class BasicEvaluator<float>;
+template class BasicEvaluator<double>;
+template class BasicEvaluator<bf16>;
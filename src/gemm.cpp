@@ -0,0 +1,379 @@
+#include "../include/gemm.hpp"
+#include "../include/kernels.hpp"
+#include "../include/thread_pool.hpp"
+
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+using namespace gemm_blocking;
+
+namespace {
+
+// Pack an mc x kc block of op(A) into mr-row panels, each panel stored column by column
+// (kc columns of mr values). Short panels at the bottom edge are zero padded.
+template <typename T, typename S>
+void pack_a(Transpose trans, int mc, int kc, const S* A, int lda, T* packed, int MR) {
+    for (int ir = 0; ir < mc; ir += MR) {
+        const int mr = std::min(MR, mc - ir);
+        for (int p = 0; p < kc; ++p) {
+            for (int i = 0; i < mr; ++i) {
+                packed[p * MR + i] = static_cast<T>(trans == Transpose::NO ? A[(ir + i) * lda + p] : A[p * lda + ir + i]);
+            }
+            for (int i = mr; i < MR; ++i) {
+                packed[p * MR + i] = T(0);
+            }
+        }
+        packed += kc * MR;
+    }
+}
+
+// Pack a kc x nc block of op(B) into nr-column panels, each panel stored row by row
+// (kc rows of nr values). Short panels at the right edge are zero padded.
+template <typename T, typename S>
+void pack_b(Transpose trans, int kc, int nc, const S* B, int ldb, T* packed, int NR) {
+    for (int jr = 0; jr < nc; jr += NR) {
+        const int nr = std::min(NR, nc - jr);
+        for (int p = 0; p < kc; ++p) {
+            if (trans == Transpose::NO) {
+                const S* row = B + p * ldb + jr;
+                for (int j = 0; j < nr; ++j) {
+                    packed[p * NR + j] = static_cast<T>(row[j]);
+                }
+            } else {
+                for (int j = 0; j < nr; ++j) {
+                    packed[p * NR + j] = static_cast<T>(B[(jr + j) * ldb + p]);
+                }
+            }
+            for (int j = nr; j < NR; ++j) {
+                packed[p * NR + j] = T(0);
+            }
+        }
+        packed += kc * NR;
+    }
+}
+
+template <typename T>
+void scale_c(int m, int n, T beta, T* C, int ldc) {
+    for (int i = 0; i < m; ++i) {
+        T* c = C + i * ldc;
+        if (beta == T(0)) {
+            std::fill(c, c + n, T(0));
+        } else {
+            for (int j = 0; j < n; ++j) {
+                c[j] *= beta;
+            }
+        }
+    }
+}
+
+// Applies an epilogue to finished rows of C, for when it can't ride along in the micro-kernel
+template <typename T>
+void epilogue_rows(const KernelTable<T>& k_table, Epilogue epilogue, const T* bias,
+                   int rows, int n, T* C, int ldc) {
+    for (int i = 0; i < rows; ++i) {
+        T* c = C + static_cast<size_t>(i) * ldc;
+        if (bias && epilogue != Epilogue::NONE) {
+            k_table.bias_add(c, bias, 1, n);
+        }
+        if (epilogue == Epilogue::BIAS_RELU) {
+            k_table.relu_forward(c, c, n);
+        } else if (epilogue == Epilogue::BIAS_SOFTMAX) {
+            k_table.softmax_rows(c, c, 1, n);
+        }
+    }
+}
+
+// Packing buffers are reused across calls, one set per thread
+template <typename T>
+T* pack_buffer_a() {
+    thread_local std::vector<T> buffer(MC * KC);
+    return buffer.data();
+}
+
+template <typename T>
+T* pack_buffer_b() {
+    thread_local std::vector<T> buffer(KC * NC);
+    return buffer.data();
+}
+
+// Packed-panel driver, everything already in the compute type except the A and B sources
+// B comes from prepacked when given, otherwise it is packed block by block as it goes.
+template <typename T, typename TA, typename TB>
+void gemm_blocked(Transpose trans_a, Transpose trans_b, int m, int n, int k,
+                  T alpha, const TA* A, int lda, const TB* B, int ldb, const PackedMatrix<T>* prepacked,
+                  T beta, T* C, int ldc, Epilogue epilogue, const T* bias) {
+    const KernelTable<T>& k_table = kernels<T>();
+    const int MR = k_table.gemm_mr;
+    const int NR = k_table.gemm_nr;
+    T* packed_a = pack_buffer_a<T>();
+    T* packed_b = pack_buffer_b<T>();
+    const bool relu = epilogue == Epilogue::BIAS_RELU;
+    // Softmax needs whole rows, fine as long as one pass over n covers them
+    const bool softmax = epilogue == Epilogue::BIAS_SOFTMAX;
+    const bool softmax_in_block = softmax && n <= NC;
+
+    for (int jc = 0; jc < n; jc += NC) {
+        const int nc = std::min(NC, n - jc);
+
+        for (int pc = 0; pc < k; pc += KC) {
+            const int kc = std::min(KC, k - pc);
+            // Only the first pass over k applies the caller's beta, the rest accumulate,
+            // and only the last one runs the epilogue
+            const T beta_pc = pc == 0 ? beta : T(1);
+            const bool last_pc = pc + kc >= k;
+            const T* bias_jc = last_pc && bias && epilogue != Epilogue::NONE ? bias + jc : nullptr;
+
+            const T* panels_b = packed_b;
+            if (prepacked) {
+                panels_b = prepacked->block(jc, pc, nc);
+            } else {
+                const TB* b_block = trans_b == Transpose::NO ? B + pc * ldb + jc : B + jc * ldb + pc;
+                pack_b(trans_b, kc, nc, b_block, ldb, packed_b, NR);
+            }
+
+            for (int ic = 0; ic < m; ic += MC) {
+                const int mc = std::min(MC, m - ic);
+
+                const TA* a_block = trans_a == Transpose::NO ? A + ic * lda + pc : A + pc * lda + ic;
+                pack_a(trans_a, mc, kc, a_block, lda, packed_a, MR);
+
+                for (int jr = 0; jr < nc; jr += NR) {
+                    const int nr = std::min(NR, nc - jr);
+                    for (int ir = 0; ir < mc; ir += MR) {
+                        const int mr = std::min(MR, mc - ir);
+                        k_table.gemm_micro(kc, packed_a + ir * kc, panels_b + jr * kc,
+                                           C + (ic + ir) * ldc + jc + jr, ldc, alpha, beta_pc, mr, nr,
+                                           bias_jc ? bias_jc + jr : nullptr, last_pc && relu);
+                    }
+                }
+
+                if (last_pc && softmax_in_block) {
+                    epilogue_rows(k_table, Epilogue::BIAS_SOFTMAX, static_cast<const T*>(nullptr), mc, n, C + ic * ldc, ldc);
+                }
+            }
+        }
+    }
+
+    if (softmax && !softmax_in_block) {
+        epilogue_rows(k_table, Epilogue::BIAS_SOFTMAX, static_cast<const T*>(nullptr), m, n, C, ldc);
+    }
+}
+
+// Checks and the narrow-C path shared by both gemm() front ends
+template <typename TA, typename TB, typename TC>
+void gemm_dispatch(Transpose trans_a, Transpose trans_b, int m, int n, int k,
+                   gemm_acc_t<TA, TB, TC> alpha, const TA* A, int lda, const TB* B, int ldb,
+                   const PackedMatrix<gemm_acc_t<TA, TB, TC>>* prepacked,
+                   gemm_acc_t<TA, TB, TC> beta, TC* C, int ldc, Epilogue epilogue, const TC* bias) {
+    using T = gemm_acc_t<TA, TB, TC>;
+    if (m < 0 || n < 0 || k < 0) {
+        throw std::invalid_argument("Invalid dims for gemm: " + std::to_string(m) + "x" +
+                                    std::to_string(k) + " * " + std::to_string(k) + "x" + std::to_string(n));
+    }
+    if (m == 0 || n == 0) {
+        return;
+    }
+
+    if constexpr (std::is_same<TC, T>::value) {
+        if (k == 0 || alpha == T(0)) {
+            scale_c(m, n, beta, C, ldc);
+            epilogue_rows(kernels<T>(), epilogue, bias, m, n, C, ldc);
+            return;
+        }
+        gemm_blocked(trans_a, trans_b, m, n, k, alpha, A, lda, B, ldb, prepacked, beta, C, ldc, epilogue, bias);
+    } else {
+        // Narrow C (bf16): accumulate the whole product and run the epilogue in the compute
+        // type, round once
+        thread_local std::vector<T> scratch;
+        thread_local std::vector<T> wide_bias;
+        scratch.resize(static_cast<size_t>(m) * n);
+        for (int i = 0; i < m; ++i) {
+            for (int j = 0; j < n; ++j) {
+                scratch[static_cast<size_t>(i) * n + j] = beta == T(0) ? T(0) : static_cast<T>(C[i * ldc + j]);
+            }
+        }
+        const T* bias_t = nullptr;
+        if (bias) {
+            wide_bias.assign(bias, bias + n);
+            bias_t = wide_bias.data();
+        }
+        gemm_dispatch(trans_a, trans_b, m, n, k, alpha, A, lda, B, ldb, prepacked, beta, scratch.data(), n, epilogue,
+                      bias_t);
+        for (int i = 0; i < m; ++i) {
+            for (int j = 0; j < n; ++j) {
+                C[i * ldc + j] = TC(scratch[static_cast<size_t>(i) * n + j]);
+            }
+        }
+    }
+}
+
+} // namespace
+
+template <typename TA, typename TB, typename TC>
+void gemm(Transpose trans_a, Transpose trans_b, int m, int n, int k,
+          gemm_acc_t<TA, TB, TC> alpha, const TA* A, int lda, const TB* B, int ldb,
+          gemm_acc_t<TA, TB, TC> beta, TC* C, int ldc) {
+    gemm(trans_a, trans_b, m, n, k, alpha, A, lda, B, ldb, beta, C, ldc, Epilogue::NONE, static_cast<const TC*>(nullptr));
+}
+
+template <typename TA, typename TB, typename TC>
+void gemm(Transpose trans_a, Transpose trans_b, int m, int n, int k,
+          gemm_acc_t<TA, TB, TC> alpha, const TA* A, int lda, const TB* B, int ldb,
+          gemm_acc_t<TA, TB, TC> beta, TC* C, int ldc, Epilogue epilogue, const TC* bias, ThreadPool* pool) {
+    using T = gemm_acc_t<TA, TB, TC>;
+    const PackedMatrix<T>* no_packing = nullptr;
+
+    // At least GEMM_MIN_WORK multiply-adds per worker, below that waking it costs more
+    constexpr double GEMM_MIN_WORK = 1 << 18;
+    const double work = static_cast<double>(m) * n * k;
+    const int parts = pool ? static_cast<int>(std::min<double>(pool->size(), std::max(1.0, work / GEMM_MIN_WORK))) : 1;
+    if (parts == 1) {
+        gemm_dispatch(trans_a, trans_b, m, n, k, alpha, A, lda, B, ldb, no_packing, beta, C, ldc, epilogue, bias);
+        return;
+    }
+
+    // Blocks are whole register tiles. Splitting m repacks all of op(B) in every worker and
+    // splitting n all of op(A), so the grid goes along the dimension that repacks less first.
+    // Softmax needs whole rows.
+    const KernelTable<T>& k_table = kernels<T>();
+    const int row_tiles = (m + k_table.gemm_mr - 1) / k_table.gemm_mr;
+    const int col_tiles = (n + k_table.gemm_nr - 1) / k_table.gemm_nr;
+    int grid_m = 1, grid_n = 1;
+    if (epilogue == Epilogue::BIAS_SOFTMAX) {
+        grid_m = std::min(parts, row_tiles);
+    } else if (m < n) {
+        grid_n = std::min(parts, col_tiles);
+        grid_m = std::min(parts / grid_n, row_tiles);
+    } else {
+        grid_m = std::min(parts, row_tiles);
+        grid_n = std::min(parts / grid_m, col_tiles);
+    }
+
+    pool->run([&](int w) {
+        if (w >= grid_m * grid_n) {
+            return;
+        }
+        auto rows = ThreadPool::split(row_tiles, grid_m, w / grid_n);
+        auto cols = ThreadPool::split(col_tiles, grid_n, w % grid_n);
+        const int i0 = static_cast<int>(rows.first) * k_table.gemm_mr;
+        const int i1 = std::min(m, static_cast<int>(rows.second) * k_table.gemm_mr);
+        const int j0 = static_cast<int>(cols.first) * k_table.gemm_nr;
+        const int j1 = std::min(n, static_cast<int>(cols.second) * k_table.gemm_nr);
+        if (i0 >= i1 || j0 >= j1) {
+            return;
+        }
+        const TA* a = trans_a == Transpose::NO ? A + static_cast<size_t>(i0) * lda : A + i0;
+        const TB* b = trans_b == Transpose::NO ? B + j0 : B + static_cast<size_t>(j0) * ldb;
+        gemm_dispatch(trans_a, trans_b, i1 - i0, j1 - j0, k, alpha, a, lda, b, ldb, no_packing, beta,
+                      C + static_cast<size_t>(i0) * ldc + j0, ldc, epilogue, bias ? bias + j0 : nullptr);
+    });
+}
+
+template <typename T, typename TB>
+PackedMatrix<T> pack_matrix(Transpose trans_b, int k, int n, const TB* B, int ldb) {
+    PackedMatrix<T> packed;
+    packed.k = k;
+    packed.n = n;
+    packed.nr = kernels<T>().gemm_nr;
+    size_t total = 0;
+    for (int jc = 0; jc < n; jc += NC) {
+        total += static_cast<size_t>(k) * packed.padded(std::min(NC, n - jc));
+    }
+    packed.panels.resize(total);
+
+    for (int jc = 0; jc < n; jc += NC) {
+        const int nc = std::min(NC, n - jc);
+        for (int pc = 0; pc < k; pc += KC) {
+            const int kc = std::min(KC, k - pc);
+            const TB* b_block = trans_b == Transpose::NO ? B + pc * ldb + jc : B + jc * ldb + pc;
+            pack_b(trans_b, kc, nc, b_block, ldb, const_cast<T*>(packed.block(jc, pc, nc)), packed.nr);
+        }
+    }
+    return packed;
+}
+
+template <typename TA, typename TB, typename TC>
+void gemm(Transpose trans_a, int m, int n, int k,
+          gemm_acc_t<TA, TB, TC> alpha, const TA* A, int lda, const PackedMatrix<TB>& B,
+          gemm_acc_t<TA, TB, TC> beta, TC* C, int ldc, Epilogue epilogue, const TC* bias) {
+    static_assert(std::is_same<TB, gemm_acc_t<TA, TB, TC>>::value, "PackedMatrix must hold the compute type");
+    if (B.k != k || B.n != n || B.nr != kernels<TB>().gemm_nr) {
+        throw std::invalid_argument("Packed matrix is " + std::to_string(B.k) + "x" + std::to_string(B.n) +
+                                    " in panels of " + std::to_string(B.nr) + ", gemm needs " + std::to_string(k) +
+                                    "x" + std::to_string(n) + " in panels of " +
+                                    std::to_string(kernels<TB>().gemm_nr));
+    }
+    gemm_dispatch(trans_a, Transpose::NO, m, n, k, alpha, A, lda, static_cast<const TB*>(nullptr), n, &B, beta, C,
+                  ldc, epilogue, bias);
+}
+
+template <typename T>
+void gemv(int m, int n, int k, const T* A, int lda, const T* B, int ldb, T* C, int ldc, Epilogue epilogue,
+          const T* bias, SpinTeam* team) {
+    if (m < 0 || n < 0 || k < 0) {
+        throw std::invalid_argument("Invalid dims for gemv: " + std::to_string(m) + "x" + std::to_string(k) + " * " +
+                                    std::to_string(k) + "x" + std::to_string(n));
+    }
+    if (m == 0 || n == 0) {
+        return;
+    }
+    const KernelTable<T>& k_table = kernels<T>();
+    const T* bias_c = epilogue != Epilogue::NONE ? bias : nullptr;
+    const bool relu = epilogue == Epilogue::BIAS_RELU;
+
+    // Columns go out in whole cache lines and at least GEMV_MIN_COLUMNS per worker, a
+    // narrow layer is not worth the hand-off
+    constexpr int GEMV_MIN_COLUMNS = 64;
+    constexpr int LINE = 64 / sizeof(T);
+    const int lines = (n + LINE - 1) / LINE;
+    const int parts = team ? std::min(team->size(), std::max(1, n / GEMV_MIN_COLUMNS)) : 1;
+    auto columns = [&](int w) {
+        if (w >= parts) {
+            return;
+        }
+        auto range = ThreadPool::split(lines, parts, w);
+        const int first = static_cast<int>(range.first) * LINE;
+        const int last = std::min(n, static_cast<int>(range.second) * LINE);
+        if (first < last) {
+            k_table.gemv(m, last - first, k, A, lda, B + first, ldb, C + first, ldc, bias_c ? bias_c + first : nullptr,
+                         relu);
+        }
+    };
+    // A team busy with another caller's GEMV is skipped rather than waited for
+    if (parts == 1 || !team->try_run(columns)) {
+        k_table.gemv(m, n, k, A, lda, B, ldb, C, ldc, bias_c, relu);
+    }
+
+    if (epilogue == Epilogue::BIAS_SOFTMAX) {
+        epilogue_rows(k_table, Epilogue::BIAS_SOFTMAX, static_cast<const T*>(nullptr), m, n, C, ldc);
+    }
+}
+
+template void gemv<float>(int, int, int, const float*, int, const float*, int, float*, int, Epilogue, const float*,
+                          SpinTeam*);
+template void gemv<double>(int, int, int, const double*, int, const double*, int, double*, int, Epilogue,
+                           const double*, SpinTeam*);
+
+#define INSTANTIATE_GEMM(TA, TB, TC) \
+    template void gemm<TA, TB, TC>(Transpose, Transpose, int, int, int, gemm_acc_t<TA, TB, TC>, const TA*, int, \
+                                   const TB*, int, gemm_acc_t<TA, TB, TC>, TC*, int); \
+    template void gemm<TA, TB, TC>(Transpose, Transpose, int, int, int, gemm_acc_t<TA, TB, TC>, const TA*, int, \
+                                   const TB*, int, gemm_acc_t<TA, TB, TC>, TC*, int, Epilogue, const TC*, \
+                                   ThreadPool*);
+
+INSTANTIATE_GEMM(double, double, double)
+INSTANTIATE_GEMM(float, float, float)
+INSTANTIATE_GEMM(bf16, bf16, bf16)
+INSTANTIATE_GEMM(bf16, float, float)
+INSTANTIATE_GEMM(float, bf16, float)
+
+#define INSTANTIATE_PACKED_GEMM(TA, TB, TC) \
+    template PackedMatrix<TB> pack_matrix<TB, TA>(Transpose, int, int, const TA*, int); \
+    template void gemm<TA, TB, TC>(Transpose, int, int, int, gemm_acc_t<TA, TB, TC>, const TA*, int, \
+                                   const PackedMatrix<TB>&, gemm_acc_t<TA, TB, TC>, TC*, int, Epilogue, const TC*);
+
+INSTANTIATE_PACKED_GEMM(double, double, double)
+INSTANTIATE_PACKED_GEMM(float, float, float)
+INSTANTIATE_PACKED_GEMM(bf16, float, bf16)
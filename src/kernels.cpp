@@ -0,0 +1,197 @@
+#include "../include/kernels.hpp"
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <initializer_list>
+
+namespace {
+
+// One-lane "vector" so the scalar fallback shares its code with the SIMD builds
+template <typename S>
+struct VecScalar {
+    using T = S;
+    using R = S;
+    static constexpr int W = 1;
+    static R zero() { return S(0); }
+    static R set1(T x) { return x; }
+    static R loadu(const T* p) { return *p; }
+    static R load_u8(const uint8_t* p) { return static_cast<T>(*p); }
+    static R load_i32(const int32_t* p) { return static_cast<T>(*p); }
+    static void storeu(T* p, R a) { *p = a; }
+    static R add(R a, R b) { return a + b; }
+    static R sub(R a, R b) { return a - b; }
+    static R mul(R a, R b) { return a * b; }
+    static R div(R a, R b) { return a / b; }
+    static R max(R a, R b) { return a > b ? a : b; }
+    static R sqrt(R a) { return std::sqrt(a); }
+    static R fmadd(R a, R b, R c) { return a * b + c; }
+    static R fnmadd(R a, R b, R c) { return c - a * b; }
+    static R relu_mask(R x, R v) { return x > S(0) ? v : S(0); }
+    static T hsum(R a) { return a; }
+    static T hmax(R a) { return a; }
+};
+
+} // namespace
+
+#include "../include/kernels_impl.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define HAVE_X86_KERNELS 1
+void fill_kernels_sse2(KernelTable<double>& d, KernelTable<float>& f);
+void fill_kernels_avx2(KernelTable<double>& d, KernelTable<float>& f);
+void fill_kernels_avx512(KernelTable<double>& d, KernelTable<float>& f);
+void fill_int8_kernels_avx2(Int8Kernels& k);
+void fill_int8_kernels_vnni(Int8Kernels& k);
+void fill_random_kernels_avx2(RandomKernels& k);
+void fill_random_kernels_avx512(RandomKernels& k);
+#endif
+
+namespace {
+
+void gemm_u8s8_scalar(const uint8_t* x, const int8_t* w, int32_t* acc, int rows, int cols, int k) {
+    for (int r = 0; r < rows; ++r) {
+        const uint8_t* xr = x + static_cast<size_t>(r) * k;
+        for (int c = 0; c < cols; ++c) {
+            const int8_t* wc = w + static_cast<size_t>(c) * k;
+            int32_t sum = 0;
+            for (int i = 0; i < k; ++i) {
+                sum += static_cast<int32_t>(xr[i]) * wc[i];
+            }
+            acc[static_cast<size_t>(r) * cols + c] = sum;
+        }
+    }
+}
+
+void philox_scalar(uint64_t seed, uint64_t stream, uint64_t first_block, size_t blocks, uint32_t* out) {
+    for (size_t b = 0; b < blocks; ++b) {
+        philox_block(seed, stream, first_block + b, out + 4 * b);
+    }
+}
+
+struct Tables {
+    KernelTable<double> d[4];
+    KernelTable<float> f[4];
+    Int8Kernels int8[4];
+    Isa detected;
+    Isa best;
+
+    Tables() {
+        for (int i = 0; i < 4; ++i) {
+            fill_table<VecScalar<double>, 4, 4>(d[i], Isa::SCALAR);
+            fill_table<VecScalar<float>, 4, 4>(f[i], Isa::SCALAR);
+            int8[i] = {"scalar", &gemm_u8s8_scalar};
+        }
+#ifdef HAVE_X86_KERNELS
+        fill_kernels_sse2(d[static_cast<int>(Isa::SSE2)], f[static_cast<int>(Isa::SSE2)]);
+        fill_kernels_avx2(d[static_cast<int>(Isa::AVX2)], f[static_cast<int>(Isa::AVX2)]);
+        fill_kernels_avx512(d[static_cast<int>(Isa::AVX512)], f[static_cast<int>(Isa::AVX512)]);
+        // pmaddubsw from AVX2 up, VNNI needs AVX-512 BW and VNNI on top of F
+        fill_int8_kernels_avx2(int8[static_cast<int>(Isa::AVX2)]);
+        fill_int8_kernels_avx2(int8[static_cast<int>(Isa::AVX512)]);
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512bw") && __builtin_cpu_supports("avx512vnni")) {
+            fill_int8_kernels_vnni(int8[static_cast<int>(Isa::AVX512)]);
+        }
+#endif
+        detected = detect_isa();
+        best = detected;
+
+        // Allow forcing a narrower set for testing, never a wider one than the host has
+        if (const char* forced = std::getenv("KERNEL_ISA")) {
+            for (Isa isa : {Isa::SCALAR, Isa::SSE2, Isa::AVX2, Isa::AVX512}) {
+                if (std::strcmp(forced, isa_name(isa)) == 0 && isa < best) {
+                    best = isa;
+                }
+            }
+        }
+    }
+};
+
+const Tables& tables() {
+    static const Tables t;
+    return t;
+}
+
+template <typename T>
+const KernelTable<T>& pick(const Tables& t, Isa isa);
+
+template <>
+const KernelTable<double>& pick(const Tables& t, Isa isa) { return t.d[static_cast<int>(isa)]; }
+
+template <>
+const KernelTable<float>& pick(const Tables& t, Isa isa) { return t.f[static_cast<int>(isa)]; }
+
+} // namespace
+
+Isa detect_isa() {
+#ifdef HAVE_X86_KERNELS
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) {
+        return Isa::AVX512;
+    }
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        return Isa::AVX2;
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        return Isa::SSE2;
+    }
+#endif
+    return Isa::SCALAR;
+}
+
+const char* isa_name(Isa isa) {
+    switch (isa) {
+        case Isa::SCALAR: return "scalar";
+        case Isa::SSE2: return "sse2";
+        case Isa::AVX2: return "avx2";
+        case Isa::AVX512: return "avx512";
+    }
+    return "unknown";
+}
+
+const Int8Kernels& int8_kernels() {
+    return tables().int8[static_cast<int>(tables().best)];
+}
+
+const Int8Kernels& int8_kernels(Isa isa) {
+    if (isa > tables().detected) {
+        isa = Isa::SCALAR;
+    }
+    return tables().int8[static_cast<int>(isa)];
+}
+
+const RandomKernels& random_kernels() {
+    static const RandomKernels table = [] {
+        RandomKernels k = {"scalar", &philox_scalar};
+#ifdef HAVE_X86_KERNELS
+        const Isa best = tables().best;
+        if (best == Isa::AVX512) {
+            fill_random_kernels_avx512(k);
+        } else if (best >= Isa::AVX2) {
+            fill_random_kernels_avx2(k);
+        }
+#endif
+        return k;
+    }();
+    return table;
+}
+
+template <typename T>
+const KernelTable<T>& kernels() {
+    static const KernelTable<T>& table = pick<T>(tables(), tables().best);
+    return table;
+}
+
+template <typename T>
+const KernelTable<T>& kernels(Isa isa) {
+    if (isa > tables().detected) {
+        isa = Isa::SCALAR;
+    }
+    return pick<T>(tables(), isa);
+}
+
+template const KernelTable<double>& kernels<double>();
+template const KernelTable<float>& kernels<float>();
+template const KernelTable<double>& kernels<double>(Isa);
+template const KernelTable<float>& kernels<float>(Isa);
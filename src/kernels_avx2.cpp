@@ -0,0 +1,231 @@
+// AVX2 + FMA kernels, built with -mavx2 -mfma
+#include "../include/kernels.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#include <cstring>
+
+namespace {
+
+struct VecD {
+    using T = double;
+    using R = __m256d;
+    static constexpr int W = 4;
+    static R zero() { return _mm256_setzero_pd(); }
+    static R set1(T x) { return _mm256_set1_pd(x); }
+    static R loadu(const T* p) { return _mm256_loadu_pd(p); }
+    static R load_u8(const uint8_t* p) {
+        int32_t bytes;
+        std::memcpy(&bytes, p, sizeof(bytes));
+        return _mm256_cvtepi32_pd(_mm_cvtepu8_epi32(_mm_cvtsi32_si128(bytes)));
+    }
+    static R load_i32(const int32_t* p) { return _mm256_cvtepi32_pd(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p))); }
+    static void storeu(T* p, R a) { _mm256_storeu_pd(p, a); }
+    static R add(R a, R b) { return _mm256_add_pd(a, b); }
+    static R sub(R a, R b) { return _mm256_sub_pd(a, b); }
+    static R mul(R a, R b) { return _mm256_mul_pd(a, b); }
+    static R div(R a, R b) { return _mm256_div_pd(a, b); }
+    static R max(R a, R b) { return _mm256_max_pd(a, b); }
+    static R sqrt(R a) { return _mm256_sqrt_pd(a); }
+    static R fmadd(R a, R b, R c) { return _mm256_fmadd_pd(a, b, c); }
+    static R fnmadd(R a, R b, R c) { return _mm256_fnmadd_pd(a, b, c); }
+    static R relu_mask(R x, R v) { return _mm256_and_pd(_mm256_cmp_pd(x, _mm256_setzero_pd(), _CMP_GT_OQ), v); }
+    static T hsum(R a) {
+        __m128d s = _mm_add_pd(_mm256_castpd256_pd128(a), _mm256_extractf128_pd(a, 1));
+        return _mm_cvtsd_f64(_mm_add_sd(s, _mm_unpackhi_pd(s, s)));
+    }
+    static T hmax(R a) {
+        __m128d s = _mm_max_pd(_mm256_castpd256_pd128(a), _mm256_extractf128_pd(a, 1));
+        return _mm_cvtsd_f64(_mm_max_sd(s, _mm_unpackhi_pd(s, s)));
+    }
+};
+
+struct VecF {
+    using T = float;
+    using R = __m256;
+    static constexpr int W = 8;
+    static R zero() { return _mm256_setzero_ps(); }
+    static R set1(T x) { return _mm256_set1_ps(x); }
+    static R loadu(const T* p) { return _mm256_loadu_ps(p); }
+    static R load_u8(const uint8_t* p) {
+        return _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(p))));
+    }
+    static R load_i32(const int32_t* p) { return _mm256_cvtepi32_ps(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p))); }
+    static void storeu(T* p, R a) { _mm256_storeu_ps(p, a); }
+    static R add(R a, R b) { return _mm256_add_ps(a, b); }
+    static R sub(R a, R b) { return _mm256_sub_ps(a, b); }
+    static R mul(R a, R b) { return _mm256_mul_ps(a, b); }
+    static R div(R a, R b) { return _mm256_div_ps(a, b); }
+    static R max(R a, R b) { return _mm256_max_ps(a, b); }
+    static R sqrt(R a) { return _mm256_sqrt_ps(a); }
+    static R fmadd(R a, R b, R c) { return _mm256_fmadd_ps(a, b, c); }
+    static R fnmadd(R a, R b, R c) { return _mm256_fnmadd_ps(a, b, c); }
+    static R relu_mask(R x, R v) { return _mm256_and_ps(_mm256_cmp_ps(x, _mm256_setzero_ps(), _CMP_GT_OQ), v); }
+    static T hsum(R a) {
+        __m128 s = _mm_add_ps(_mm256_castps256_ps128(a), _mm256_extractf128_ps(a, 1));
+        s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+        return _mm_cvtss_f32(_mm_add_ss(s, _mm_shuffle_ps(s, s, 1)));
+    }
+    static T hmax(R a) {
+        __m128 s = _mm_max_ps(_mm256_castps256_ps128(a), _mm256_extractf128_ps(a, 1));
+        s = _mm_max_ps(s, _mm_movehl_ps(s, s));
+        return _mm_cvtss_f32(_mm_max_ss(s, _mm_shuffle_ps(s, s, 1)));
+    }
+};
+
+} // namespace
+
+#include "../include/kernels_impl.hpp"
+
+void fill_kernels_avx2(KernelTable<double>& d, KernelTable<float>& f) {
+    fill_table<VecD, 6, 2>(d, Isa::AVX2);
+    fill_table<VecF, 6, 2>(f, Isa::AVX2);
+}
+
+namespace {
+
+// u8 x s8 products summed in pairs to int16 (pmaddubsw), then in pairs to int32 (pmaddwd)
+inline __m256i dot_step(__m256i acc, __m256i x, __m256i w) {
+    return _mm256_add_epi32(acc, _mm256_madd_epi16(_mm256_maddubs_epi16(x, w), _mm256_set1_epi16(1)));
+}
+
+inline int32_t sum(__m256i a) {
+    __m128i s = _mm_add_epi32(_mm256_castsi256_si128(a), _mm256_extracti128_si256(a, 1));
+    s = _mm_hadd_epi32(s, s);
+    s = _mm_hadd_epi32(s, s);
+    return _mm_cvtsi128_si32(s);
+}
+
+// R rows by C output channels, every load of x is shared by C channels and every load of w
+// by R rows
+template <int R, int C>
+void tile(const uint8_t* x, const int8_t* w, int32_t* out, int cols, int k) {
+    __m256i a[R][C];
+#pragma GCC unroll 16
+    for (int r = 0; r < R; ++r) {
+#pragma GCC unroll 16
+        for (int c = 0; c < C; ++c) {
+            a[r][c] = _mm256_setzero_si256();
+        }
+    }
+    for (int i = 0; i < k; i += 32) {
+        __m256i wv[C];
+#pragma GCC unroll 16
+        for (int c = 0; c < C; ++c) {
+            wv[c] = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(w + static_cast<size_t>(c) * k + i));
+        }
+#pragma GCC unroll 16
+        for (int r = 0; r < R; ++r) {
+            const __m256i xv = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(x + static_cast<size_t>(r) * k + i));
+#pragma GCC unroll 16
+            for (int c = 0; c < C; ++c) {
+                a[r][c] = dot_step(a[r][c], xv, wv[c]);
+            }
+        }
+    }
+#pragma GCC unroll 16
+    for (int r = 0; r < R; ++r) {
+        int32_t* row = out + static_cast<size_t>(r) * cols;
+        if constexpr (C == 4) {
+            const __m256i s = _mm256_hadd_epi32(_mm256_hadd_epi32(a[r][0], a[r][1]),
+                                                _mm256_hadd_epi32(a[r][2], a[r][3]));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(row),
+                             _mm_add_epi32(_mm256_castsi256_si128(s), _mm256_extracti128_si256(s, 1)));
+        } else {
+#pragma GCC unroll 16
+            for (int c = 0; c < C; ++c) {
+                row[c] = sum(a[r][c]);
+            }
+        }
+    }
+}
+
+template <int R>
+void row_block(const uint8_t* x, const int8_t* w, int32_t* acc, int cols, int k) {
+    int c = 0;
+    for (; c + 4 <= cols; c += 4) {
+        tile<R, 4>(x, w + static_cast<size_t>(c) * k, acc + c, cols, k);
+    }
+    for (; c < cols; ++c) {
+        tile<R, 1>(x, w + static_cast<size_t>(c) * k, acc + c, cols, k);
+    }
+}
+
+void gemm_u8s8(const uint8_t* x, const int8_t* w, int32_t* acc, int rows, int cols, int k) {
+    int r = 0;
+    for (; r + 2 <= rows; r += 2) {
+        row_block<2>(x + static_cast<size_t>(r) * k, w, acc + static_cast<size_t>(r) * cols, cols, k);
+    }
+    for (; r < rows; ++r) {
+        row_block<1>(x + static_cast<size_t>(r) * k, w, acc + static_cast<size_t>(r) * cols, cols, k);
+    }
+}
+
+// hi and lo halves of the 32 x 32 bit products a * m, lane by lane
+inline void mulhilo(__m256i a, __m256i m, __m256i& hi, __m256i& lo) {
+    const __m256i even = _mm256_mul_epu32(a, m);
+    const __m256i odd = _mm256_mul_epu32(_mm256_srli_epi64(a, 32), m);
+    hi = _mm256_blend_epi32(_mm256_srli_epi64(even, 32), odd, 0xAA);
+    lo = _mm256_blend_epi32(even, _mm256_slli_epi64(odd, 32), 0xAA);
+}
+
+// Eight blocks at a time, one per lane, then transposed back to block order
+void philox(uint64_t seed, uint64_t stream, uint64_t first_block, size_t blocks, uint32_t* out) {
+    const __m256i m0 = _mm256_set1_epi64x(0xD2511F53);
+    const __m256i m1 = _mm256_set1_epi64x(0xCD9E8D57);
+    const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    size_t b = 0;
+    for (; b + 8 <= blocks; b += 8) {
+        const uint64_t block = first_block + b;
+        // Blocks whose low counter word wraps inside the group take the scalar path below
+        if (static_cast<uint32_t>(block) > 0xFFFFFFF8u) {
+            break;
+        }
+        __m256i c0 = _mm256_add_epi32(_mm256_set1_epi32(static_cast<int>(block)), lanes);
+        __m256i c1 = _mm256_set1_epi32(static_cast<int>(block >> 32));
+        __m256i c2 = _mm256_set1_epi32(static_cast<int>(stream));
+        __m256i c3 = _mm256_set1_epi32(static_cast<int>(stream >> 32));
+        uint32_t k0 = static_cast<uint32_t>(seed), k1 = static_cast<uint32_t>(seed >> 32);
+        for (int round = 0; round < 10; ++round) {
+            __m256i hi0, lo0, hi1, lo1;
+            mulhilo(c0, m0, hi0, lo0);
+            mulhilo(c2, m1, hi1, lo1);
+            c0 = _mm256_xor_si256(_mm256_xor_si256(hi1, c1), _mm256_set1_epi32(static_cast<int>(k0)));
+            c2 = _mm256_xor_si256(_mm256_xor_si256(hi0, c3), _mm256_set1_epi32(static_cast<int>(k1)));
+            c1 = lo1;
+            c3 = lo0;
+            k0 += 0x9E3779B9u;
+            k1 += 0xBB67AE85u;
+        }
+        const __m256i t0 = _mm256_unpacklo_epi32(c0, c1); // blocks 0, 1 | 4, 5 of c0 c1
+        const __m256i t1 = _mm256_unpackhi_epi32(c0, c1); // 2, 3 | 6, 7
+        const __m256i u0 = _mm256_unpacklo_epi32(c2, c3);
+        const __m256i u1 = _mm256_unpackhi_epi32(c2, c3);
+        const __m256i v0 = _mm256_unpacklo_epi64(t0, u0); // block 0 | 4
+        const __m256i v1 = _mm256_unpackhi_epi64(t0, u0); // 1 | 5
+        const __m256i v2 = _mm256_unpacklo_epi64(t1, u1); // 2 | 6
+        const __m256i v3 = _mm256_unpackhi_epi64(t1, u1); // 3 | 7
+        __m256i* dst = reinterpret_cast<__m256i*>(out + 4 * b);
+        _mm256_storeu_si256(dst, _mm256_permute2x128_si256(v0, v1, 0x20));
+        _mm256_storeu_si256(dst + 1, _mm256_permute2x128_si256(v2, v3, 0x20));
+        _mm256_storeu_si256(dst + 2, _mm256_permute2x128_si256(v0, v1, 0x31));
+        _mm256_storeu_si256(dst + 3, _mm256_permute2x128_si256(v2, v3, 0x31));
+    }
+    for (; b < blocks; ++b) {
+        philox_block(seed, stream, first_block + b, out + 4 * b);
+    }
+}
+
+} // namespace
+
+void fill_random_kernels_avx2(RandomKernels& k) {
+    k.name = "avx2";
+    k.philox = &philox;
+}
+
+void fill_int8_kernels_avx2(Int8Kernels& k) {
+    k.name = "avx2";
+    k.gemm_u8s8 = &gemm_u8s8;
+}
+
+#endif
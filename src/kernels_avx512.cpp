@@ -0,0 +1,159 @@
+// AVX-512 kernels, built with -mavx512f
+#include "../include/kernels.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+
+// GCC 12's avx512fintrin.h trips this on its own _mm*_undefined_* placeholders
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+
+namespace {
+
+struct VecD {
+    using T = double;
+    using R = __m512d;
+    static constexpr int W = 8;
+    static R zero() { return _mm512_setzero_pd(); }
+    static R set1(T x) { return _mm512_set1_pd(x); }
+    static R loadu(const T* p) { return _mm512_loadu_pd(p); }
+    static R load_u8(const uint8_t* p) {
+        return _mm512_cvtepi32_pd(_mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(p))));
+    }
+    static R load_i32(const int32_t* p) { return _mm512_cvtepi32_pd(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p))); }
+    static void storeu(T* p, R a) { _mm512_storeu_pd(p, a); }
+    static R add(R a, R b) { return _mm512_add_pd(a, b); }
+    static R sub(R a, R b) { return _mm512_sub_pd(a, b); }
+    static R mul(R a, R b) { return _mm512_mul_pd(a, b); }
+    static R div(R a, R b) { return _mm512_div_pd(a, b); }
+    static R max(R a, R b) { return _mm512_max_pd(a, b); }
+    static R sqrt(R a) { return _mm512_sqrt_pd(a); }
+    static R fmadd(R a, R b, R c) { return _mm512_fmadd_pd(a, b, c); }
+    static R fnmadd(R a, R b, R c) { return _mm512_fnmadd_pd(a, b, c); }
+    static R relu_mask(R x, R v) {
+        return _mm512_maskz_mov_pd(_mm512_cmp_pd_mask(x, _mm512_setzero_pd(), _CMP_GT_OQ), v);
+    }
+    static T hsum(R a) {
+        __m256d h = _mm256_add_pd(_mm512_castpd512_pd256(a), _mm512_extractf64x4_pd(a, 1));
+        __m128d s = _mm_add_pd(_mm256_castpd256_pd128(h), _mm256_extractf128_pd(h, 1));
+        return _mm_cvtsd_f64(_mm_add_sd(s, _mm_unpackhi_pd(s, s)));
+    }
+    static T hmax(R a) {
+        __m256d h = _mm256_max_pd(_mm512_castpd512_pd256(a), _mm512_extractf64x4_pd(a, 1));
+        __m128d s = _mm_max_pd(_mm256_castpd256_pd128(h), _mm256_extractf128_pd(h, 1));
+        return _mm_cvtsd_f64(_mm_max_sd(s, _mm_unpackhi_pd(s, s)));
+    }
+};
+
+struct VecF {
+    using T = float;
+    using R = __m512;
+    static constexpr int W = 16;
+    static R zero() { return _mm512_setzero_ps(); }
+    static R set1(T x) { return _mm512_set1_ps(x); }
+    static R loadu(const T* p) { return _mm512_loadu_ps(p); }
+    static R load_u8(const uint8_t* p) {
+        return _mm512_cvtepi32_ps(_mm512_cvtepu8_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p))));
+    }
+    static R load_i32(const int32_t* p) { return _mm512_cvtepi32_ps(_mm512_loadu_si512(p)); }
+    static void storeu(T* p, R a) { _mm512_storeu_ps(p, a); }
+    static R add(R a, R b) { return _mm512_add_ps(a, b); }
+    static R sub(R a, R b) { return _mm512_sub_ps(a, b); }
+    static R mul(R a, R b) { return _mm512_mul_ps(a, b); }
+    static R div(R a, R b) { return _mm512_div_ps(a, b); }
+    static R max(R a, R b) { return _mm512_max_ps(a, b); }
+    static R sqrt(R a) { return _mm512_sqrt_ps(a); }
+    static R fmadd(R a, R b, R c) { return _mm512_fmadd_ps(a, b, c); }
+    static R fnmadd(R a, R b, R c) { return _mm512_fnmadd_ps(a, b, c); }
+    static R relu_mask(R x, R v) {
+        return _mm512_maskz_mov_ps(_mm512_cmp_ps_mask(x, _mm512_setzero_ps(), _CMP_GT_OQ), v);
+    }
+    static __m256 high_half(R a) { return _mm256_castpd_ps(_mm512_extractf64x4_pd(_mm512_castps_pd(a), 1)); }
+    static T hsum(R a) {
+        __m256 h = _mm256_add_ps(_mm512_castps512_ps256(a), high_half(a));
+        __m128 s = _mm_add_ps(_mm256_castps256_ps128(h), _mm256_extractf128_ps(h, 1));
+        s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+        return _mm_cvtss_f32(_mm_add_ss(s, _mm_shuffle_ps(s, s, 1)));
+    }
+    static T hmax(R a) {
+        __m256 h = _mm256_max_ps(_mm512_castps512_ps256(a), high_half(a));
+        __m128 s = _mm_max_ps(_mm256_castps256_ps128(h), _mm256_extractf128_ps(h, 1));
+        s = _mm_max_ps(s, _mm_movehl_ps(s, s));
+        return _mm_cvtss_f32(_mm_max_ss(s, _mm_shuffle_ps(s, s, 1)));
+    }
+};
+
+} // namespace
+
+#include "../include/kernels_impl.hpp"
+
+namespace {
+
+// hi and lo halves of the 32 x 32 bit products a * m, lane by lane
+inline void mulhilo(__m512i a, __m512i m, __m512i& hi, __m512i& lo) {
+    const __m512i even = _mm512_mul_epu32(a, m);
+    const __m512i odd = _mm512_mul_epu32(_mm512_srli_epi64(a, 32), m);
+    hi = _mm512_mask_blend_epi32(0xAAAA, _mm512_srli_epi64(even, 32), odd);
+    lo = _mm512_mask_blend_epi32(0xAAAA, even, _mm512_slli_epi64(odd, 32));
+}
+
+// Sixteen blocks at a time, one per lane, then transposed back to block order
+void philox(uint64_t seed, uint64_t stream, uint64_t first_block, size_t blocks, uint32_t* out) {
+    const __m512i m0 = _mm512_set1_epi64(0xD2511F53);
+    const __m512i m1 = _mm512_set1_epi64(0xCD9E8D57);
+    const __m512i lanes = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    // Pairs lanes 0-7 (low) or 8-15 (high) of two vectors, then 64-bit pairs the same way
+    const __m512i zip_lo32 = _mm512_setr_epi32(0, 16, 1, 17, 2, 18, 3, 19, 4, 20, 5, 21, 6, 22, 7, 23);
+    const __m512i zip_hi32 = _mm512_setr_epi32(8, 24, 9, 25, 10, 26, 11, 27, 12, 28, 13, 29, 14, 30, 15, 31);
+    const __m512i zip_lo64 = _mm512_setr_epi64(0, 8, 1, 9, 2, 10, 3, 11);
+    const __m512i zip_hi64 = _mm512_setr_epi64(4, 12, 5, 13, 6, 14, 7, 15);
+    size_t b = 0;
+    for (; b + 16 <= blocks; b += 16) {
+        const uint64_t block = first_block + b;
+        // Blocks whose low counter word wraps inside the group take the scalar path below
+        if (static_cast<uint32_t>(block) > 0xFFFFFFF0u) {
+            break;
+        }
+        __m512i c0 = _mm512_add_epi32(_mm512_set1_epi32(static_cast<int>(block)), lanes);
+        __m512i c1 = _mm512_set1_epi32(static_cast<int>(block >> 32));
+        __m512i c2 = _mm512_set1_epi32(static_cast<int>(stream));
+        __m512i c3 = _mm512_set1_epi32(static_cast<int>(stream >> 32));
+        uint32_t k0 = static_cast<uint32_t>(seed), k1 = static_cast<uint32_t>(seed >> 32);
+        for (int round = 0; round < 10; ++round) {
+            __m512i hi0, lo0, hi1, lo1;
+            mulhilo(c0, m0, hi0, lo0);
+            mulhilo(c2, m1, hi1, lo1);
+            c0 = _mm512_xor_si512(_mm512_xor_si512(hi1, c1), _mm512_set1_epi32(static_cast<int>(k0)));
+            c2 = _mm512_xor_si512(_mm512_xor_si512(hi0, c3), _mm512_set1_epi32(static_cast<int>(k1)));
+            c1 = lo1;
+            c3 = lo0;
+            k0 += 0x9E3779B9u;
+            k1 += 0xBB67AE85u;
+        }
+        const __m512i t0 = _mm512_permutex2var_epi32(c0, zip_lo32, c1); // c0 c1 of blocks 0-7
+        const __m512i t1 = _mm512_permutex2var_epi32(c0, zip_hi32, c1); // 8-15
+        const __m512i u0 = _mm512_permutex2var_epi32(c2, zip_lo32, c3);
+        const __m512i u1 = _mm512_permutex2var_epi32(c2, zip_hi32, c3);
+        __m512i* dst = reinterpret_cast<__m512i*>(out + 4 * b);
+        _mm512_storeu_si512(dst, _mm512_permutex2var_epi64(t0, zip_lo64, u0));
+        _mm512_storeu_si512(dst + 1, _mm512_permutex2var_epi64(t0, zip_hi64, u0));
+        _mm512_storeu_si512(dst + 2, _mm512_permutex2var_epi64(t1, zip_lo64, u1));
+        _mm512_storeu_si512(dst + 3, _mm512_permutex2var_epi64(t1, zip_hi64, u1));
+    }
+    for (; b < blocks; ++b) {
+        philox_block(seed, stream, first_block + b, out + 4 * b);
+    }
+}
+
+} // namespace
+
+void fill_kernels_avx512(KernelTable<double>& d, KernelTable<float>& f) {
+    fill_table<VecD, 6, 2>(d, Isa::AVX512);
+    fill_table<VecF, 6, 2>(f, Isa::AVX512);
+}
+
+void fill_random_kernels_avx512(RandomKernels& k) {
+    k.name = "avx512";
+    k.philox = &philox;
+}
+
+#endif
@@ -0,0 +1,81 @@
+// SSE2 kernels, built with -msse2
+#include "../include/kernels.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#include <cstring>
+
+namespace {
+
+struct VecD {
+    using T = double;
+    using R = __m128d;
+    static constexpr int W = 2;
+    static R zero() { return _mm_setzero_pd(); }
+    static R set1(T x) { return _mm_set1_pd(x); }
+    static R loadu(const T* p) { return _mm_loadu_pd(p); }
+    static R load_u8(const uint8_t* p) {
+        uint16_t bytes;
+        std::memcpy(&bytes, p, sizeof(bytes));
+        const __m128i v = _mm_unpacklo_epi8(_mm_cvtsi32_si128(bytes), _mm_setzero_si128());
+        return _mm_cvtepi32_pd(_mm_unpacklo_epi16(v, _mm_setzero_si128()));
+    }
+    static R load_i32(const int32_t* p) { return _mm_cvtepi32_pd(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(p))); }
+    static void storeu(T* p, R a) { _mm_storeu_pd(p, a); }
+    static R add(R a, R b) { return _mm_add_pd(a, b); }
+    static R sub(R a, R b) { return _mm_sub_pd(a, b); }
+    static R mul(R a, R b) { return _mm_mul_pd(a, b); }
+    static R div(R a, R b) { return _mm_div_pd(a, b); }
+    static R max(R a, R b) { return _mm_max_pd(a, b); }
+    static R sqrt(R a) { return _mm_sqrt_pd(a); }
+    static R fmadd(R a, R b, R c) { return _mm_add_pd(_mm_mul_pd(a, b), c); }
+    static R fnmadd(R a, R b, R c) { return _mm_sub_pd(c, _mm_mul_pd(a, b)); }
+    static R relu_mask(R x, R v) { return _mm_and_pd(_mm_cmpgt_pd(x, _mm_setzero_pd()), v); }
+    static T hsum(R a) { return _mm_cvtsd_f64(_mm_add_sd(a, _mm_unpackhi_pd(a, a))); }
+    static T hmax(R a) { return _mm_cvtsd_f64(_mm_max_sd(a, _mm_unpackhi_pd(a, a))); }
+};
+
+struct VecF {
+    using T = float;
+    using R = __m128;
+    static constexpr int W = 4;
+    static R zero() { return _mm_setzero_ps(); }
+    static R set1(T x) { return _mm_set1_ps(x); }
+    static R loadu(const T* p) { return _mm_loadu_ps(p); }
+    static R load_u8(const uint8_t* p) {
+        int32_t bytes;
+        std::memcpy(&bytes, p, sizeof(bytes));
+        const __m128i v = _mm_unpacklo_epi8(_mm_cvtsi32_si128(bytes), _mm_setzero_si128());
+        return _mm_cvtepi32_ps(_mm_unpacklo_epi16(v, _mm_setzero_si128()));
+    }
+    static R load_i32(const int32_t* p) { return _mm_cvtepi32_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p))); }
+    static void storeu(T* p, R a) { _mm_storeu_ps(p, a); }
+    static R add(R a, R b) { return _mm_add_ps(a, b); }
+    static R sub(R a, R b) { return _mm_sub_ps(a, b); }
+    static R mul(R a, R b) { return _mm_mul_ps(a, b); }
+    static R div(R a, R b) { return _mm_div_ps(a, b); }
+    static R max(R a, R b) { return _mm_max_ps(a, b); }
+    static R sqrt(R a) { return _mm_sqrt_ps(a); }
+    static R fmadd(R a, R b, R c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+    static R fnmadd(R a, R b, R c) { return _mm_sub_ps(c, _mm_mul_ps(a, b)); }
+    static R relu_mask(R x, R v) { return _mm_and_ps(_mm_cmpgt_ps(x, _mm_setzero_ps()), v); }
+    static T hsum(R a) {
+        R s = _mm_add_ps(a, _mm_movehl_ps(a, a));
+        return _mm_cvtss_f32(_mm_add_ss(s, _mm_shuffle_ps(s, s, 1)));
+    }
+    static T hmax(R a) {
+        R s = _mm_max_ps(a, _mm_movehl_ps(a, a));
+        return _mm_cvtss_f32(_mm_max_ss(s, _mm_shuffle_ps(s, s, 1)));
+    }
+};
+
+} // namespace
+
+#include "../include/kernels_impl.hpp"
+
+void fill_kernels_sse2(KernelTable<double>& d, KernelTable<float>& f) {
+    fill_table<VecD, 4, 2>(d, Isa::SSE2);
+    fill_table<VecF, 4, 2>(f, Isa::SSE2);
+}
+
+#endif
@@ -0,0 +1,100 @@
+// AVX-512 VNNI int8 kernels, built with -mavx512f -mavx512bw -mavx512vnni
+#include "../include/kernels.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+
+// GCC 12's avx512fintrin.h trips these on its own _mm*_undefined_* placeholders
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#pragma GCC diagnostic ignored "-Wuninitialized"
+
+namespace {
+
+inline __m128i fold(__m512i a) {
+    const __m256i h = _mm256_add_epi32(_mm512_castsi512_si256(a), _mm512_extracti64x4_epi64(a, 1));
+    return _mm_add_epi32(_mm256_castsi256_si128(h), _mm256_extracti128_si256(h, 1));
+}
+
+// Totals of four accumulators side by side
+inline __m128i sums4(const __m512i* a) {
+    const __m512i t0 = _mm512_add_epi32(_mm512_unpacklo_epi32(a[0], a[1]), _mm512_unpackhi_epi32(a[0], a[1]));
+    const __m512i t1 = _mm512_add_epi32(_mm512_unpacklo_epi32(a[2], a[3]), _mm512_unpackhi_epi32(a[2], a[3]));
+    return fold(_mm512_add_epi32(_mm512_unpacklo_epi64(t0, t1), _mm512_unpackhi_epi64(t0, t1)));
+}
+
+inline int32_t sum(__m512i a) {
+    __m128i s = fold(a);
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(1, 0, 3, 2)));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(s);
+}
+
+// R rows by C output channels, every load of x is shared by C channels and every load of w
+// by R rows. vpdpbusd sums u8 x s8 products in fours straight into int32.
+template <int R, int C>
+void tile(const uint8_t* x, const int8_t* w, int32_t* out, int cols, int k) {
+    __m512i a[R][C];
+#pragma GCC unroll 16
+    for (int r = 0; r < R; ++r) {
+#pragma GCC unroll 16
+        for (int c = 0; c < C; ++c) {
+            a[r][c] = _mm512_setzero_si512();
+        }
+    }
+    for (int i = 0; i < k; i += 64) {
+        __m512i wv[C];
+#pragma GCC unroll 16
+        for (int c = 0; c < C; ++c) {
+            wv[c] = _mm512_loadu_si512(w + static_cast<size_t>(c) * k + i);
+        }
+#pragma GCC unroll 16
+        for (int r = 0; r < R; ++r) {
+            const __m512i xv = _mm512_loadu_si512(x + static_cast<size_t>(r) * k + i);
+#pragma GCC unroll 16
+            for (int c = 0; c < C; ++c) {
+                a[r][c] = _mm512_dpbusd_epi32(a[r][c], xv, wv[c]);
+            }
+        }
+    }
+#pragma GCC unroll 16
+    for (int r = 0; r < R; ++r) {
+        if constexpr (C == 4) {
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + static_cast<size_t>(r) * cols), sums4(a[r]));
+        } else {
+#pragma GCC unroll 16
+            for (int c = 0; c < C; ++c) {
+                out[static_cast<size_t>(r) * cols + c] = sum(a[r][c]);
+            }
+        }
+    }
+}
+
+template <int R>
+void row_block(const uint8_t* x, const int8_t* w, int32_t* acc, int cols, int k) {
+    int c = 0;
+    for (; c + 4 <= cols; c += 4) {
+        tile<R, 4>(x, w + static_cast<size_t>(c) * k, acc + c, cols, k);
+    }
+    for (; c < cols; ++c) {
+        tile<R, 1>(x, w + static_cast<size_t>(c) * k, acc + c, cols, k);
+    }
+}
+
+void gemm_u8s8(const uint8_t* x, const int8_t* w, int32_t* acc, int rows, int cols, int k) {
+    int r = 0;
+    for (; r + 4 <= rows; r += 4) {
+        row_block<4>(x + static_cast<size_t>(r) * k, w, acc + static_cast<size_t>(r) * cols, cols, k);
+    }
+    for (; r < rows; ++r) {
+        row_block<1>(x + static_cast<size_t>(r) * k, w, acc + static_cast<size_t>(r) * cols, cols, k);
+    }
+}
+
+} // namespace
+
+void fill_int8_kernels_vnni(Int8Kernels& k) {
+    k.name = "avx512-vnni";
+    k.gemm_u8s8 = &gemm_u8s8;
+}
+
+#endif
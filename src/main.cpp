@@ -1,69 +1,34 @@
 #include "../include/tensor.hpp"
 #include "../include/model.hpp"
 #include "../include/utils.hpp"
+#include "../include/trainer.hpp"
+#include "../include/dataset.hpp"
+#include "../include/data_loader.hpp"
+#include "../include/evaluator.hpp"
+#include "../include/trace.hpp"
+#include "../include/random.hpp"
 #include <iostream>
-#include <fstream>
-#include <sstream>
 #include <vector>
 #include <cstdlib>
-#include <ctime>
-#include <cstring>
 #include <algorithm>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
 
 
-class Dataset {
-public:
-    int count;
-    std::unique_ptr<Tensor> inputs;
-    std::unique_ptr<Tensor> actual;
-
-    Dataset(int num_datapoints, int size_per_point) : count(num_datapoints) {
-        std::vector<int> shape = {num_datapoints, size_per_point};
-        inputs = std::make_unique<Tensor>(shape, 2, false);
-        shape[0] = 1;
-        shape[1] = num_datapoints;
-        actual = std::make_unique<Tensor>(shape, 2, false);
-    }
-
-};
-
-void MNIST_dataset(const std::string& filename, Dataset* dataset) {
-    std::ifstream file(filename);
-    if (!file.is_open()) {
-        std::cerr << "Error opening file: " << filename << std::endl;
-        exit(EXIT_FAILURE);
-    }
-
-    std::string line;
-    int datapoint_index = 0;
-
-    while (std::getline(file, line) && datapoint_index < dataset->count) {
-        std::istringstream iss(line);
-        std::string input, actual;
-        
-        if (std::getline(iss, input, ';') && std::getline(iss, actual)) {
-            std::istringstream input_stream(input);
-            std::string token;
-            int i = 0;
-            while (std::getline(input_stream, token, ',') && i < dataset->inputs->shape[1]) {
-                dataset->inputs->data[datapoint_index * 784 + i] = std::stod(token);
-                i++;
-            }
+int main() {
+    TRACE_THREAD_NAME("main");
 
-            dataset->actual->data[datapoint_index] = std::stod(actual);
-            datapoint_index++;
-        }
+    // SEED picks the initial weights and the batch order, neither depends on NUM_THREADS
+    uint64_t seed = rng::DEFAULT_SEED;
+    if (const char* env_seed = std::getenv("SEED")) {
+        seed = std::strtoull(env_seed, nullptr, 0);
     }
-
-    file.close();
-}
-
-int main() {
-    std::srand(std::time(nullptr));
+    rng::set_seed(seed);
     
-    // Load dataset
-    Dataset dataset(86184, 784);
-    MNIST_dataset("data/train_dataset.txt", &dataset);
+    // Load dataset, the text file is converted to data/train_dataset.bin on first use
+    auto dataset = load_dataset("data/train_dataset.txt");
 
     // Create model
     Model model(6);
@@ -73,67 +38,104 @@ int main() {
     model.add_layer(LayerType::RELU, 100, 100);
     model.add_layer(LayerType::LINEAR, 100, 10);
     model.add_layer(LayerType::SOFTMAX, 10, 10);
+    model.initialize(WeightInit::HE);
 
 
-    Utils utility;
-
     const int BATCH_SIZE = 16;  // Assuming this is defined
     const int EPOCHS = 10;      // Assuming this is defined
-    int num_batches = dataset.count / BATCH_SIZE;
-    double learning_rate = 0.01;
+    const uint64_t SHUFFLE_SEED = seed;
+
+    // TRAINER=hogwild trains with lock-free asynchronous SGD instead of synchronous steps,
+    // which always uses plain SGD, whatever OPTIMIZER says
+    const char* env_trainer = std::getenv("TRAINER");
+    const bool hogwild = env_trainer && std::string(env_trainer) == "hogwild";
+
+    // OPTIMIZER picks sgd, momentum, nesterov, adam or adamw, each with its own learning rate
+    const char* env_optimizer = std::getenv("OPTIMIZER");
+    OptimizerConfig optimizer = optimizer_config(hogwild ? "sgd" : env_optimizer ? env_optimizer : "sgd");
+    double learning_rate = optimizer.learning_rate;
+
+    // NUM_THREADS overrides the worker count, defaults to every core
+    int num_threads = std::max(1u, std::thread::hardware_concurrency());
+    if (const char* env_threads = std::getenv("NUM_THREADS")) {
+        num_threads = std::max(1, std::atoi(env_threads));
+    }
+    std::unique_ptr<DataParallelTrainer> trainer;
+    std::unique_ptr<HogwildTrainer> hogwild_trainer;
+    std::unique_ptr<DataLoader> loader;
+    if (hogwild) {
+        hogwild_trainer = std::make_unique<HogwildTrainer>(model, num_threads);
+        std::cout << "Training on " << hogwild_trainer->num_threads() << " threads with hogwild sgd" << std::endl;
+    } else {
+        trainer = std::make_unique<DataParallelTrainer>(model, num_threads, optimizer);
+        std::cout << "Training on " << trainer->num_threads() << " threads with " << optimizer_name(optimizer.type)
+                  << std::endl;
+        // Batches are shuffled and assembled on the loader's own thread
+        loader = std::make_unique<DataLoader>(*dataset, BATCH_SIZE, true, SHUFFLE_SEED);
+    }
+    int num_batches = dataset->count / BATCH_SIZE;
+
+    // The test set is loaded once and evaluated after every epoch, in batched chunks spread
+    // over its own pool
+    auto test_dataset = load_dataset("data/test_dataset.txt");
+    Evaluator evaluator(*test_dataset, num_threads);
+    EvalResult eval;
 
+    // Training time only, evaluation excluded, so the two trainers compare by time-to-accuracy
+    double train_seconds = 0.0;
     for (int epoch = 0; epoch < EPOCHS; epoch++) {
         double total_loss = 0.0;
+        const auto epoch_start = std::chrono::steady_clock::now();
 
-        for (int batch = 0; batch < num_batches; batch++) {
-            auto input = std::make_unique<Tensor>(std::vector<int>{BATCH_SIZE, 784}, false);
-            auto y_act = std::make_unique<Tensor>(std::vector<int>{BATCH_SIZE, 1}, false);
-
-            for (int i = 0; i < BATCH_SIZE; i++) {
-                int idx = batch * BATCH_SIZE + i;
-                std::memcpy(&input->data[i * 784], &dataset.inputs->data[idx * 784], 784 * sizeof(double));
-                y_act->data[i] = dataset.actual->data[idx];
+        if (hogwild) {
+            total_loss = hogwild_trainer->epoch(*dataset, BATCH_SIZE, learning_rate, SHUFFLE_SEED, epoch) * num_batches;
+        } else {
+            while (const DataLoader::Batch* batch = loader->next()) {
+                total_loss += trainer->step(batch->input, batch->labels, learning_rate);
             }
-
-            auto pred = forward(model, *input);
-            // std::cout << pred->data.size();
-            double loss = utility.cross_entropy_loss(*pred, *y_act);
-            // std::cout << "loss: " << loss << std::endl;
-            total_loss += loss;
-
-            utility.cross_entropy_softmax_backwards(*pred, *pred, *y_act);
-            backward(model, *pred, *y_act);
-            utility.SGD_step(model, learning_rate);
-            utility.zero_grad(model);
         }
+        train_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - epoch_start).count();
 
         std::cout << "Epoch " << epoch + 1 << ", Average Loss: " << total_loss / num_batches << std::endl;
         std::cout << "total loss: " << total_loss << std::endl;
-    // }
-
-    // Evaluation
-    Dataset test_dataset(21546, 784);
-    MNIST_dataset("data/test_dataset.txt", &test_dataset);
-    int correct_predictions = 0;
-    int total_predictions = test_dataset.count;
-
-    for (int i = 0; i < total_predictions; i++) {
-        auto input = std::make_unique<Tensor>(std::vector<int>{1, 784}, false);
-        std::memcpy(input->data.data(), &test_dataset.inputs->data[i * 784], 784 * sizeof(double));
-
-        auto pred = forward(model, *input);
-
-        int predicted_class = std::distance(pred->data.begin(), 
-                                            std::max_element(pred->data.begin(), pred->data.end()));
-        int actual_class = static_cast<int>(test_dataset.actual->data[i]);
-        
-        if (predicted_class == actual_class) {
-            correct_predictions++;
+        std::cout << "Training time so far: " << train_seconds << " s" << std::endl;
+        if (hogwild) {
+            const HogwildStats& s = hogwild_trainer->stats();
+            std::cout << "Hogwild: " << s.updates_per_second << " updates/s, " << s.samples_per_second
+                      << " samples/s, staleness mean " << s.mean_staleness << " max " << s.max_staleness << std::endl;
         }
+
+        // Evaluation, on weights packed once for the GEMM (the next optimizer step drops them)
+        model.set_weight_layout(WeightLayout::PANELS);
+        eval = evaluator.evaluate(model);
+        std::cout << "Model Accuracy: " << eval.accuracy() << "%, test loss " << eval.loss << " ("
+                  << eval.seconds << " s)" << std::endl;
+    }
+
+    // Rows are the actual class, columns the predicted one
+    std::cout << "Confusion matrix:" << std::endl;
+    for (int actual = 0; actual < eval.classes; actual++) {
+        for (int predicted = 0; predicted < eval.classes; predicted++) {
+            std::cout << (predicted ? " " : "") << eval.confusion_at(actual, predicted);
+        }
+        std::cout << std::endl;
+    }
+
+    // Serving can load this with LoadMode::MMAP instead of retraining, the optimizer state
+    // is kept so training can pick up where it left off
+    if (hogwild) {
+        model.save("model.ckpt");
+    } else {
+        const OptimizerState optimizer_state = trainer->optimizer().state();
+        model.save("model.ckpt", &optimizer_state);
     }
+    std::cout << "Saved model.ckpt" << std::endl;
 
-    double accuracy = static_cast<double>(correct_predictions) / total_predictions * 100.0;
-    std::cout << "Model Accuracy: " << accuracy << "%" << std::endl;
+    // Built with TRACE=1: dump the spans (TRACE_FILE, trace.json by default) and where the time went
+    if (trace::enabled) {
+        const char* trace_file = std::getenv("TRACE_FILE");
+        trace::write_chrome_json(trace_file ? trace_file : "trace.json");
+        trace::print_summary(std::cout);
     }
     return 0;
 
@@ -1,5 +1,8 @@
 #include "../include/tensor.hpp"
 #include "../include/model.hpp"
+#include "../include/gemm.hpp"
+#include "../include/ops.hpp"
+#include "../include/trace.hpp"
 
 #include <vector>
 #include <memory>
@@ -7,86 +10,341 @@
 #include <algorithm>
 #include <cmath>
 #include <iostream>
+#include <iterator>
 
-std::unique_ptr<Tensor> forward(Model& model, const Tensor& input) {
-    const Tensor* x = &input;
-    // for (auto i: x->data)
-    // std::cout << x->data.size() << ' ';
-    // std::cout << "!!!";
-    std::unique_ptr<Tensor> next;
+namespace {
 
-    for (auto& layer : model.layers) {
-        layer->input = std::make_unique<Tensor>(x->shape, true, true);
-        std::copy(x->data.begin(), x->data.end(), layer->input->data.begin());
+// Arena offsets are kept to multiples of a cache line of floats
+size_t round_up(size_t n) {
+    return (n + 15) / 16 * 16;
+}
+
+} // namespace
+
+template <typename T>
+void BasicWorkspace<T>::bind(const BasicModel<T>& model) {
+    const size_t num_layers = model.layers.size();
+    if (!private_grads || weight_offsets.size() == num_layers) {
+        return;
+    }
+
+    weight_offsets.assign(num_layers, 0);
+    bias_offsets.assign(num_layers, 0);
+    size_t total = 0;
+    for (size_t i = 0; i < num_layers; ++i) {
+        const BasicLayer<T>& layer = *model.layers[i];
+        if (layer.layer_type == LayerType::LINEAR) {
+            weight_offsets[i] = total;
+            total += layer.weights->total_size;
+            bias_offsets[i] = total;
+            total += layer.bias->total_size;
+        }
+    }
+    grads.assign(total, grad_type(0));
+}
+
+template <typename T>
+acc_t<T>* BasicWorkspace<T>::weight_grad(BasicModel<T>& model, int layer) {
+    return private_grads ? grads.data() + weight_offsets[layer] : model.layers[layer]->weights->grad.data();
+}
+
+template <typename T>
+acc_t<T>* BasicWorkspace<T>::bias_grad(BasicModel<T>& model, int layer) {
+    return private_grads ? grads.data() + bias_offsets[layer] : model.layers[layer]->bias->grad.data();
+}
+
+template <typename T>
+void BasicWorkspace<T>::plan(const BasicModel<T>& model, int max_batch, int input_width) {
+    const int num_layers = static_cast<int>(model.layers.size());
+    const int end = num_layers; // Still needed once the last layer is done
+
+    value_widths.assign(num_layers + 1, input_width);
+    for (int l = 0; l < num_layers; ++l) {
+        const BasicLayer<T>& layer = *model.layers[l];
+        value_widths[l + 1] = layer.layer_type == LayerType::LINEAR ? layer.bias->shape[0] : value_widths[l];
+    }
+
+    // Last layer reading each value. backward() reads the input of every LINEAR layer and the
+    // output of every RELU (as its mask), and the model output goes back to the caller.
+    std::vector<int> last_use(num_layers + 1);
+    for (int k = 0; k < num_layers; ++k) {
+        last_use[k] = k;
+    }
+    last_use[num_layers] = end;
+    for (int l = 0; l < num_layers; ++l) {
+        switch (model.layers[l]->layer_type) {
+            case LayerType::LINEAR:
+                last_use[l] = end;
+                break;
+            case LayerType::RELU:
+                last_use[l + 1] = end;
+                break;
+            case LayerType::SOFTMAX:
+                break;
+        }
+    }
+
+    // Give every value a slot of the arena. A slot is free again once the last layer reading
+    // its value is done, or right away for an elementwise layer that can work in place.
+    auto size_of = [&](int k) { return static_cast<size_t>(max_batch) * value_widths[k]; };
+    std::vector<int> slot_of(num_layers + 1, 0);
+    std::vector<size_t> slot_size = {size_of(0)};
+    std::vector<int> slot_busy_until = {last_use[0]};
+    for (int l = 0; l < num_layers; ++l) {
+        const int k = l + 1;
+        int slot = -1;
+        if (model.layers[l]->layer_type != LayerType::LINEAR && last_use[l] == l) {
+            slot = slot_of[l];
+        } else {
+            // Smallest free slot that fits, else the largest free one, which then grows
+            for (int s = 0; s < static_cast<int>(slot_size.size()); ++s) {
+                if (slot_busy_until[s] >= l) {
+                    continue;
+                }
+                const bool fits = slot_size[s] >= size_of(k);
+                const bool best_fits = slot >= 0 && slot_size[slot] >= size_of(k);
+                if (slot < 0 || (fits && (!best_fits || slot_size[s] < slot_size[slot])) ||
+                    (!fits && !best_fits && slot_size[s] > slot_size[slot])) {
+                    slot = s;
+                }
+            }
+            if (slot < 0) {
+                slot = static_cast<int>(slot_size.size());
+                slot_size.push_back(0);
+                slot_busy_until.push_back(0);
+            }
+        }
+        slot_of[k] = slot;
+        slot_size[slot] = std::max(slot_size[slot], size_of(k));
+        slot_busy_until[slot] = last_use[k];
+    }
+
+    std::vector<size_t> slot_offset(slot_size.size());
+    size_t total = 0;
+    for (size_t s = 0; s < slot_size.size(); ++s) {
+        slot_offset[s] = total;
+        total += round_up(slot_size[s]);
+    }
+    value_offsets.resize(num_layers + 1);
+    for (int k = 0; k <= num_layers; ++k) {
+        value_offsets[k] = slot_offset[slot_of[k]];
+    }
+    arena.assign(total, T(0));
+
+    // Gradients w.r.t. activations only ever need the current one and the one being written
+    size_t grad_size = 0;
+    for (int k = 0; k <= num_layers; ++k) {
+        grad_size = std::max(grad_size, round_up(size_of(k)));
+    }
+    grad_offsets[0] = 0;
+    grad_offsets[1] = grad_size;
+    grad_arena.assign(2 * grad_size, grad_type(0));
+
+    inputs.resize(num_layers, BasicTensor<T>(std::vector<int>{0, 0}));
+    outputs.resize(num_layers, BasicTensor<T>(std::vector<int>{0, 0}));
+    planned_batch = max_batch;
+    planned_width = input_width;
+    planned_layers = model.layers.size();
+}
+
+template <typename T>
+void BasicWorkspace<T>::prepare(const BasicModel<T>& model, int batch_size, int input_width) {
+    if (model.layers.size() != planned_layers || input_width != planned_width || batch_size > planned_batch) {
+        plan(model, std::max(batch_size, planned_batch), input_width);
+    }
+    const size_t num_layers = model.layers.size();
+    for (size_t l = 0; l < num_layers; ++l) {
+        inputs[l].borrow(arena.data() + value_offsets[l], nullptr, batch_size, value_widths[l]);
+        outputs[l].borrow(arena.data() + value_offsets[l + 1], l + 1 == num_layers ? grad_buffer(0) : nullptr,
+                          batch_size, value_widths[l + 1]);
+    }
+}
+
+namespace {
+
+template <typename T>
+void check_schedule(const BasicModel<T>& model) {
+    if (model.layers.empty()) {
+        throw std::runtime_error("Cannot run a model without layers");
+    }
+    const FusedStep& last = model.schedule.empty() ? FusedStep{0, 0, Epilogue::NONE} : model.schedule.back();
+    if (static_cast<size_t>(last.layer + last.count) != model.layers.size()) {
+        throw std::runtime_error("Model schedule is out of date, call fuse() after changing layers");
+    }
+}
+
+// gemv() has kernels for float and double only, bf16 batches always take the GEMM
+template <typename T>
+constexpr bool has_gemv = std::is_same<T, acc_t<T>>::value;
+
+template <typename T>
+void linear_gemv(const BasicModel<T>& model, const BasicLayer<T>& layer, Epilogue epilogue, int rows, int width,
+                 const T* x, int ld, T* y) {
+    if constexpr (has_gemv<T>) {
+        const int output_size = layer.bias->shape[0];
+        gemv(rows, output_size, width, x, ld, layer.weights->data.data(), output_size, y, output_size, epilogue,
+             layer.bias->data.data(), model.inference_team.get());
+    }
+}
+
+// Span names and costs of a step for the trace
+template <typename T>
+const char* step_name(const BasicModel<T>& model, const FusedStep& step) {
+    switch (model.layers[step.layer]->layer_type) {
+        case LayerType::LINEAR:
+            return step.epilogue == Epilogue::BIAS_RELU      ? "linear+relu"
+                   : step.epilogue == Epilogue::BIAS_SOFTMAX ? "linear+softmax"
+                                                             : "linear";
+        case LayerType::RELU:
+            return "relu";
+        case LayerType::SOFTMAX:
+            return "softmax";
+    }
+    return "unknown";
+}
+
+// A LINEAR step is one GEMM forward and two backward, elementwise steps are a few flops per
+// element of their input (width wide)
+template <typename T>
+double step_flops(const BasicModel<T>& model, const FusedStep& step, int batch, int width, bool backward) {
+    const BasicLayer<T>& layer = *model.layers[step.layer];
+    if (layer.layer_type == LayerType::LINEAR) {
+        return (backward ? 4.0 : 2.0) * batch * layer.weights->shape[0] * layer.weights->shape[1];
+    }
+    return (layer.layer_type == LayerType::RELU ? 1.0 : 4.0) * batch * width;
+}
+
+// Every input, weight, bias and output once (twice for what backward reads and writes again)
+template <typename T>
+double step_bytes(const BasicModel<T>& model, const FusedStep& step, int batch, int width, bool backward) {
+    const BasicLayer<T>& layer = *model.layers[step.layer];
+    if (layer.layer_type == LayerType::LINEAR) {
+        const double in = layer.weights->shape[0];
+        const double out = layer.weights->shape[1];
+        return sizeof(T) * ((backward ? 2.0 : 1.0) * (batch * in + in * out) + batch * out + out);
+    }
+    return sizeof(T) * 2.0 * batch * width;
+}
+
+} // namespace
+
+template <typename T>
+BasicTensor<T>& forward(BasicModel<T>& model, const BasicTensor<T>& input) {
+    return forward(model, input, model.workspace);
+}
+
+namespace {
+
+// Runs the first num_steps steps of the schedule on the workspace, input already in place.
+// A fused step writes the activation's output, the LINEAR output never exists.
+template <typename T>
+void run_steps(BasicModel<T>& model, BasicWorkspace<T>& ws, int batch_size, size_t num_steps) {
+    for (size_t s = 0; s < num_steps; ++s) {
+        const FusedStep& step = model.schedule[s];
+        auto& layer = model.layers[step.layer];
+        const BasicTensor<T>& x = ws.inputs[step.layer];
+        BasicTensor<T>& y = ws.outputs[step.layer + step.count - 1];
+        TRACE_SCOPE("forward", step_name(model, step), step.layer, step_flops(model, step, batch_size, x.shape[1], false),
+                    step_bytes(model, step, batch_size, x.shape[1], false));
 
         switch (layer->layer_type) {
             case LayerType::LINEAR: {
-                const int batch_size = x->shape[0];
-                const int input_size = x->shape[1];
-                const int output_size = layer->bias->shape[0];
-                next = std::make_unique<Tensor>(std::vector<int>{batch_size, output_size}, true);
-                
-                for (int b = 0; b < batch_size; ++b) {
-                    for (int j = 0; j < output_size; ++j) {
-                        double sum = 0.0;
-                        for (int i = 0; i < input_size; ++i) {
-                            sum += x->data[b * input_size + i] * layer->weights->data[i * output_size + j];
-                        }
-                        next->data[b * output_size + j] = sum + layer->bias->data[j];
-                    }
-                }
+                const int input_size = x.shape[1];
+                const int output_size = y.shape[1];
+                gemm(Transpose::NO, Transpose::NO, batch_size, output_size, input_size,
+                     1.0, x.data.data(), input_size, layer->weights->data.data(), output_size,
+                     0.0, y.data.data(), output_size, step.epilogue, layer->bias->data.data(), ws.pool);
                 break;
             }
             case LayerType::RELU: {
-                next = std::make_unique<Tensor>(x->shape, x->require_grad);
-                std::transform(x->data.begin(), x->data.end(), next->data.begin(),
-                               [](double val) { return std::max(0.0, val); });
+                ops::relu_forward(x.data.data(), y.data.data(), x.total_size);
                 break;
             }
             case LayerType::SOFTMAX: {
-                const int batch_size = x->shape[0];
-                const int class_count = x->shape[1];
-                next = std::make_unique<Tensor>(x->shape, x->require_grad);
-                
-                for (int b = 0; b < batch_size; ++b) {
-                    const double max_val = *std::max_element(x->data.begin() + b * class_count, 
-                                                             x->data.begin() + ((b + 1) * (class_count)));
-                    std::vector<double> exps(class_count);
-                    double sum_of_exps = 0.0;
-                    
-                    for (int j = 0; j < class_count; ++j) {
-                        exps[j] = std::exp(x->data[b * class_count + j] - max_val);
-                        sum_of_exps += exps[j];
-                    }
-                    
-                    for (int j = 0; j < class_count; ++j) {
-                        next->data[b * class_count + j] = exps[j] / sum_of_exps;
-                    }
-                }
+                ops::softmax_rows(x.data.data(), y.data.data(), batch_size, x.shape[1]);
                 break;
             }
         }
+    }
+}
+
+} // namespace
+
+template <typename T>
+BasicTensor<T>& forward(BasicModel<T>& model, const BasicTensor<T>& input, BasicWorkspace<T>& ws) {
+    check_schedule(model);
+    const int batch_size = input.shape[0];
+    ws.bind(model);
+    ws.prepare(model, batch_size, input.shape[1]);
+    std::copy(input.data.begin(), input.data.begin() + input.total_size, ws.inputs[0].data.begin());
+
+    run_steps(model, ws, batch_size, model.schedule.size());
+    return ws.outputs.back();
+}
+
+template <typename T>
+double forward_loss(BasicModel<T>& model, const BasicTensor<T>& input, const BasicTensor<T>& actual,
+                    BasicWorkspace<T>& ws, int total_batch) {
+    check_schedule(model);
+    if (model.layers.back()->layer_type != LayerType::SOFTMAX) {
+        throw std::runtime_error("forward_loss needs a model ending in SOFTMAX");
+    }
+    const int batch_size = input.shape[0];
+    if (static_cast<size_t>(batch_size) != actual.total_size) {
+        throw std::runtime_error("Invalid dims for softmax cross entropy. Predicted: " + std::to_string(batch_size) +
+                                 " Actual: " + std::to_string(actual.total_size));
+    }
+    ws.bind(model);
+    ws.prepare(model, batch_size, input.shape[1]);
+    std::copy(input.data.begin(), input.data.begin() + input.total_size, ws.inputs[0].data.begin());
+
+    run_steps(model, ws, batch_size, model.schedule.size() - 1);
 
-        layer->output = std::move(next);
-        x = layer->output.get();
+    // The final SOFTMAX (alone or in the epilogue of the LINEAR before it) becomes the loss
+    BasicTensor<T>& out = ws.outputs.back();
+    const FusedStep& step = model.schedule.back();
+    const T* logits = out.data.data();
+    TRACE_SCOPE("forward", step.count == 2 ? "linear+softmax_xent" : "softmax_xent", step.layer,
+                step_flops(model, step, batch_size, ws.inputs[step.layer].shape[1], false),
+                step_bytes(model, step, batch_size, ws.inputs[step.layer].shape[1], false));
+    if (step.count == 2) {
+        const BasicLayer<T>& layer = *model.layers[step.layer];
+        const BasicTensor<T>& x = ws.inputs[step.layer];
+        gemm(Transpose::NO, Transpose::NO, batch_size, out.shape[1], x.shape[1],
+             1.0, x.data.data(), x.shape[1], layer.weights->data.data(), out.shape[1],
+             0.0, out.data.data(), out.shape[1], Epilogue::BIAS, layer.bias->data.data(), ws.pool);
+    } else {
+        logits = ws.inputs[step.layer].data.data();
     }
+    return ops::softmax_cross_entropy(logits, actual.data.data(), out.data.data(), out.grad.data(),
+                                      batch_size, out.shape[1], acc_t<T>(1) / total_batch);
+}
 
-    return std::make_unique<Tensor>(*x);
+template <typename T>
+void backward(BasicModel<T>& model, BasicTensor<T>& pred, const BasicTensor<T>& actual) {
+    backward(model, pred, actual, model.workspace, true);
 }
 
-void backward(Model& model, Tensor& pred, const Tensor& actual) {
-    int last_layer = model.layers.size() - 1;
+template <typename T>
+void backward(BasicModel<T>& model, BasicTensor<T>& pred, const BasicTensor<T>& /* actual */, BasicWorkspace<T>& ws,
+              bool accumulate) {
+    using G = acc_t<T>;
+    check_schedule(model);
     const int batch_size = pred.shape[0];
+    const G beta = accumulate ? G(1) : G(0);
 
-    // Compute initial gradient (assuming cross-entropy loss with softmax output)
-    std::vector<double> grad = pred.grad;
-    for (size_t i = 0; i < actual.data.size(); ++i) {
-        // pred.grad[i] = pred.data[i] - (i % pred.shape[1] == static_cast<int>(actual.data[i / pred.shape[1]]));
-        grad[i] = pred.grad[i];
-    }
+    // Start from pred.grad (cross-entropy with softmax output), every layer then writes its
+    // input gradient into whichever ping-pong buffer does not hold its output gradient
+    G* buffers[2] = {ws.grad_buffer(0), ws.grad_buffer(1)};
+    const G* grad = pred.grad.data();
 
-    for (int i = last_layer; i >= 0; --i) {
-        // Layer& layer = *model.layers[i];
+    for (auto step = model.schedule.rbegin(); step != model.schedule.rend(); ++step) {
+        const int i = step->layer;
+        const int last = step->layer + step->count - 1;
+        G* next = grad == buffers[0] ? buffers[1] : buffers[0];
+        TRACE_SCOPE("backward", step_name(model, *step), i,
+                    step_flops(model, *step, batch_size, ws.inputs[i].shape[1], true),
+                    step_bytes(model, *step, batch_size, ws.inputs[i].shape[1], true));
 
         switch (model.layers[i]->layer_type) {
             case LayerType::SOFTMAX:
@@ -94,60 +352,277 @@ void backward(Model& model, Tensor& pred, const Tensor& actual) {
                 break;
 
             case LayerType::LINEAR: {
-                const int input_size = model.layers[i]->input->shape[1];
-                const int output_size = model.layers[i]->output->shape[1];
-                
-                // Compute gradient w.r.t weights
-                std::vector<double> weight_grad(model.layers[i]->weights->data.size(), 0.0);
-                for (int b = 0; b < batch_size; ++b) {
-                    for (int index = 0; index < input_size; ++index) {
-                        for (int j = 0; j < output_size; ++j) {
-                            weight_grad[index * output_size + j] += model.layers[i]->input->data[b * input_size + index] * grad[b * output_size + j];
-                        }
-                    }
+                const int input_size = ws.inputs[i].shape[1];
+                const int output_size = ws.outputs[last].shape[1];
+
+                // db = sum of dY over the batch. A fused ReLU masks dY by its output in the
+                // same pass and the masked dY goes on to the two GEMMs.
+                if (step->epilogue == Epilogue::BIAS_RELU) {
+                    ops::bias_backward(grad, ws.outputs[last].data.data(), next, ws.bias_grad(model, i),
+                                       batch_size, output_size, beta);
+                    grad = next;
+                    next = grad == buffers[0] ? buffers[1] : buffers[0];
+                } else {
+                    ops::bias_backward(grad, static_cast<const T*>(nullptr), static_cast<G*>(nullptr),
+                                       ws.bias_grad(model, i), batch_size, output_size, beta);
                 }
-                
-                // Update weights
-                for (size_t j = 0; j < model.layers[i]->weights->data.size(); ++j) {
-                    model.layers[i]->weights->grad[j] += weight_grad[j]; // 0.01 is the learning rate
+
+                // dW = X^T dY, straight into the weight gradient. k is the batch here, a pool
+                // only ever splits the rows and columns of dW, so the sum over rows is one order.
+                gemm(Transpose::YES, Transpose::NO, input_size, output_size, batch_size,
+                     1.0, ws.inputs[i].data.data(), input_size, grad, output_size,
+                     beta, ws.weight_grad(model, i), output_size, Epilogue::NONE, static_cast<const G*>(nullptr),
+                     ws.pool);
+
+                // dX = dY W^T, nobody needs it for the first layer
+                if (step != std::prev(model.schedule.rend())) {
+                    gemm(Transpose::NO, Transpose::YES, batch_size, input_size, output_size,
+                         1.0, grad, output_size, model.layers[i]->weights->data.data(), output_size,
+                         0.0, next, input_size, Epilogue::NONE, static_cast<const G*>(nullptr), ws.pool);
+                    grad = next;
                 }
+                break;
+            }
 
-                // Compute gradient w.r.t bias and update
-                std::vector<double> bias_grad(output_size, 0.0);
-                for (int b = 0; b < batch_size; ++b) {
-                    for (int j = 0; j < output_size; ++j) {
-                        bias_grad[j] += grad[b * output_size + j];
-                    }
+            case LayerType::RELU: {
+                // ReLU backward pass, masked by the output: relu(x) > 0 exactly where x > 0
+                ops::relu_backward(ws.outputs[i].data.data(), grad, next, ws.outputs[i].total_size);
+                grad = next;
+                break;
+            }
+        }
+    }
+}
+
+template <typename T>
+void infer(const BasicModel<T>& model, const BasicTensor<T>& input, BasicTensor<T>& output) {
+    infer(model, input.view(), output);
+}
+
+template <typename T>
+void infer(const BasicModel<T>& model, TensorView<const T> input, BasicTensor<T>& output) {
+    check_schedule(model);
+    if (input.dims() != 2 || input.stride(1) != 1) {
+        throw std::invalid_argument("infer needs a 2-D input with contiguous rows");
+    }
+    const int batch_size = input.size(0);
+
+    int width = input.size(1);
+    int max_width = width;
+    for (const auto& layer : model.layers) {
+        if (layer->layer_type == LayerType::LINEAR) {
+            width = layer->bias->shape[0];
+            max_width = std::max(max_width, width);
+        }
+    }
+    output.resize(batch_size, width);
+
+    // Each step reads one buffer and writes the other, elementwise layers work in place.
+    // Both only ever grow, so a thread allocates once for its largest batch.
+    thread_local std::vector<T> ping, pong;
+    const size_t needed = static_cast<size_t>(batch_size) * max_width;
+    if (ping.size() < needed) {
+        ping.resize(needed);
+        pong.resize(needed);
+    }
+
+    const T* x = input.data();
+    int ld = static_cast<int>(input.stride(0)); // Row stride of x, only the input can have gaps
+    T* current = nullptr; // Buffer holding x, none while x is still the input
+    width = input.size(1);
+    for (const FusedStep& step : model.schedule) {
+        const BasicLayer<T>& layer = *model.layers[step.layer];
+        const bool last = &step == &model.schedule.back();
+        TRACE_SCOPE("infer", step_name(model, step), step.layer, step_flops(model, step, batch_size, width, false),
+                    step_bytes(model, step, batch_size, width, false));
+        // Elementwise steps take the whole batch at once, or a row at a time off a strided input
+        const int calls = ld == width ? 1 : batch_size;
+        const int rows = ld == width ? batch_size : 1;
+
+        switch (layer.layer_type) {
+            case LayerType::LINEAR: {
+                const int output_size = layer.bias->shape[0];
+                T* y = last ? output.data.data() : (current == ping.data() ? pong.data() : ping.data());
+                if (has_gemv<T> && batch_size <= GEMV_MAX_ROWS) {
+                    // A few rows stream the row-major weights once, split across the team if any
+                    linear_gemv(model, layer, step.epilogue, batch_size, width, x, ld, y);
+                } else if (layer.packed_weights) {
+                    gemm(Transpose::NO, batch_size, output_size, width, 1.0, x, ld, *layer.packed_weights,
+                         0.0, y, output_size, step.epilogue, layer.bias->data.data());
+                } else {
+                    gemm(Transpose::NO, Transpose::NO, batch_size, output_size, width,
+                         1.0, x, ld, layer.weights->data.data(), output_size,
+                         0.0, y, output_size, step.epilogue, layer.bias->data.data());
                 }
-                for (size_t j = 0; j < model.layers[i]->bias->data.size(); ++j) {
-                    model.layers[i]->bias->grad[j] += bias_grad[j];
+                width = output_size;
+                current = y;
+                break;
+            }
+            case LayerType::RELU: {
+                T* y = last ? output.data.data() : (current ? current : ping.data());
+                for (int r = 0; r < calls; ++r) {
+                    ops::relu_forward(x + static_cast<size_t>(r) * ld, y + static_cast<size_t>(r) * width,
+                                      static_cast<size_t>(rows) * width);
                 }
-
-                // Compute gradient w.r.t input for next layer
-                std::vector<double> input_grad(batch_size * input_size, 0.0);
-                for (int b = 0; b < batch_size; ++b) {
-                    for (int index = 0; index < input_size; ++index) {
-                        for (int j = 0; j < output_size; ++j) {
-                            input_grad[b * input_size + index] += grad[b * output_size + j] * model.layers[i]->weights->data[index * output_size + j];
-                        }
-                    }
+                current = y;
+                break;
+            }
+            case LayerType::SOFTMAX: {
+                T* y = last ? output.data.data() : (current ? current : ping.data());
+                for (int r = 0; r < calls; ++r) {
+                    ops::softmax_rows(x + static_cast<size_t>(r) * ld, y + static_cast<size_t>(r) * width, rows,
+                                      width);
                 }
-                grad = std::move(input_grad);
+                current = y;
                 break;
             }
+        }
+        x = current;
+        ld = width;
+    }
+}
 
-            case LayerType::RELU: {
-                // ReLU backward pass
-                // for (size_t j = 0; j < grad.size(); ++j) {
-                    std::transform(model.layers[i]->input->data.begin(), model.layers[i]->input->data.end(), grad.begin(), grad.begin(),
-               [](double input, double grad) { return input > 0 ? grad : 0; });
-               
-                // }
+template <typename T>
+void BasicModel<T>::set_weight_layout(WeightLayout layout) {
+    for (const auto& layer : layers) {
+        if (layer->layer_type != LayerType::LINEAR) {
+            continue;
+        }
+        if (layout == WeightLayout::PANELS) {
+            const BasicTensor<T>& w = *layer->weights;
+            layer->packed_weights = std::make_unique<PackedMatrix<gemm_acc_t<T, T, T>>>(
+                pack_matrix<gemm_acc_t<T, T, T>>(Transpose::NO, w.shape[0], w.shape[1], w.data.data(), w.shape[1]));
+        } else {
+            layer->packed_weights.reset();
+        }
+    }
+}
+
+template <typename T>
+WeightLayout BasicModel<T>::weight_layout() const {
+    for (const auto& layer : layers) {
+        if (layer->packed_weights) {
+            return WeightLayout::PANELS;
+        }
+    }
+    return WeightLayout::ROW_MAJOR;
+}
+
+template <typename T>
+void BasicModel<T>::initialize(WeightInit init, uint64_t seed) {
+    if (mapped()) {
+        throw std::runtime_error("Cannot initialize a model mapped from a checkpoint, load it with LoadMode::COPY");
+    }
+    set_weight_layout(WeightLayout::ROW_MAJOR);
+    for (size_t l = 0; l < layers.size(); ++l) {
+        if (layers[l]->layer_type != LayerType::LINEAR) {
+            continue;
+        }
+        BasicTensor<T>& w = *layers[l]->weights;
+        BasicTensor<T>& b = *layers[l]->bias;
+        const double fan_in = w.shape[0];
+        const double fan_out = w.shape[1];
+        const uint64_t stream = rng::INIT_STREAMS + 2 * l;
+        switch (init) {
+            case WeightInit::UNIFORM:
+                rng::fill_uniform(w.data.data(), w.total_size, -1.0, 1.0, stream, seed);
+                rng::fill_uniform(b.data.data(), b.total_size, -1.0, 1.0, stream + 1, seed);
+                continue;
+            case WeightInit::XAVIER: {
+                const double limit = std::sqrt(6.0 / (fan_in + fan_out));
+                rng::fill_uniform(w.data.data(), w.total_size, -limit, limit, stream, seed);
                 break;
             }
+            case WeightInit::HE: {
+                const double limit = std::sqrt(6.0 / fan_in);
+                rng::fill_uniform(w.data.data(), w.total_size, -limit, limit, stream, seed);
+                break;
+            }
+            case WeightInit::XAVIER_NORMAL:
+                rng::fill_normal(w.data.data(), w.total_size, 0.0, std::sqrt(2.0 / (fan_in + fan_out)), stream, seed);
+                break;
+            case WeightInit::HE_NORMAL:
+                rng::fill_normal(w.data.data(), w.total_size, 0.0, std::sqrt(2.0 / fan_in), stream, seed);
+                break;
         }
+        std::fill(b.data.begin(), b.data.end(), T(0));
+    }
+}
 
-        // Store the gradient in the input tensor of the current layer
-        model.layers[i]->input->grad = grad;
+template <typename T>
+void BasicModel<T>::pack_parameters() {
+    if (mapped()) {
+        throw std::runtime_error("Cannot pack a model mapped from a checkpoint, load it with LoadMode::COPY");
     }
-}
\ No newline at end of file
+    set_weight_layout(WeightLayout::ROW_MAJOR);
+    size_t total = 0;
+    for (const auto& layer : layers) {
+        if (layer->layer_type == LayerType::LINEAR) {
+            total += layer->weights->total_size + layer->bias->total_size;
+        }
+    }
+
+    // Filled from the tensors before they are re-pointed, they may borrow the old buffers
+    std::vector<T> packed_values(total);
+    std::vector<acc_t<T>> packed_grads(total, acc_t<T>(0));
+    size_t offset = 0;
+    for (const auto& layer : layers) {
+        if (layer->layer_type != LayerType::LINEAR) {
+            continue;
+        }
+        for (BasicTensor<T>* param : {layer->weights.get(), layer->bias.get()}) {
+            std::copy(param->data.begin(), param->data.end(), packed_values.begin() + offset);
+            if (param->grad.size() == param->total_size) {
+                std::copy(param->grad.begin(), param->grad.end(), packed_grads.begin() + offset);
+            }
+            offset += param->total_size;
+        }
+    }
+    parameters = std::move(packed_values);
+    gradients = std::move(packed_grads);
+
+    offset = 0;
+    for (const auto& layer : layers) {
+        if (layer->layer_type != LayerType::LINEAR) {
+            continue;
+        }
+        for (BasicTensor<T>* param : {layer->weights.get(), layer->bias.get()}) {
+            param->data.borrow(parameters.data() + offset, param->total_size);
+            param->grad.borrow(gradients.data() + offset, param->total_size);
+            offset += param->total_size;
+        }
+    }
+}
+
+template <typename T>
+bool BasicModel<T>::packed() const {
+    size_t total = 0;
+    for (const auto& layer : layers) {
+        if (layer->layer_type == LayerType::LINEAR) {
+            if (!layer->weights->data.is_borrowed() || !layer->bias->data.is_borrowed()) {
+                return false;
+            }
+            total += layer->weights->total_size + layer->bias->total_size;
+        }
+    }
+    return total == parameters.size();
+}
+
+#define INSTANTIATE_MODEL(T) \
+    template class BasicWorkspace<T>; \
+    template void BasicModel<T>::initialize(WeightInit, uint64_t); \
+    template void BasicModel<T>::pack_parameters(); \
+    template bool BasicModel<T>::packed() const; \
+    template void BasicModel<T>::set_weight_layout(WeightLayout); \
+    template WeightLayout BasicModel<T>::weight_layout() const; \
+    template BasicTensor<T>& forward(BasicModel<T>&, const BasicTensor<T>&); \
+    template BasicTensor<T>& forward(BasicModel<T>&, const BasicTensor<T>&, BasicWorkspace<T>&); \
+    template double forward_loss(BasicModel<T>&, const BasicTensor<T>&, const BasicTensor<T>&, BasicWorkspace<T>&, int); \
+    template void backward(BasicModel<T>&, BasicTensor<T>&, const BasicTensor<T>&); \
+    template void backward(BasicModel<T>&, BasicTensor<T>&, const BasicTensor<T>&, BasicWorkspace<T>&, bool); \
+    template void infer(const BasicModel<T>&, const BasicTensor<T>&, BasicTensor<T>&); \
+    template void infer(const BasicModel<T>&, TensorView<const T>, BasicTensor<T>&);
+
+INSTANTIATE_MODEL(float)
+INSTANTIATE_MODEL(double)
+INSTANTIATE_MODEL(bf16)
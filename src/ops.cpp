@@ -0,0 +1,241 @@
+#include "../include/ops.hpp"
+#include "../include/kernels.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <type_traits>
+
+namespace ops {
+
+template <typename T>
+constexpr bool native = std::is_same<T, acc_t<T>>::value;
+
+template <typename T>
+void bias_add(T* x, const T* bias, int rows, int cols) {
+    if constexpr (native<T>) {
+        kernels<T>().bias_add(x, bias, rows, cols);
+    } else {
+        for (int r = 0; r < rows; ++r) {
+            for (int j = 0; j < cols; ++j) {
+                T& v = x[static_cast<size_t>(r) * cols + j];
+                v = T(static_cast<acc_t<T>>(v) + static_cast<acc_t<T>>(bias[j]));
+            }
+        }
+    }
+}
+
+template <typename T>
+void relu_forward(const T* x, T* y, size_t n) {
+    if constexpr (native<T>) {
+        kernels<T>().relu_forward(x, y, n);
+    } else {
+        for (size_t i = 0; i < n; ++i) {
+            y[i] = static_cast<acc_t<T>>(x[i]) > 0 ? x[i] : T(0);
+        }
+    }
+}
+
+template <typename T>
+void relu_backward(const T* x, const acc_t<T>* dy, acc_t<T>* dx, size_t n) {
+    if constexpr (native<T>) {
+        kernels<T>().relu_backward(x, dy, dx, n);
+    } else {
+        for (size_t i = 0; i < n; ++i) {
+            dx[i] = static_cast<acc_t<T>>(x[i]) > 0 ? dy[i] : acc_t<T>(0);
+        }
+    }
+}
+
+template <typename T>
+void softmax_rows(const T* x, T* y, int rows, int cols) {
+    if constexpr (native<T>) {
+        kernels<T>().softmax_rows(x, y, rows, cols);
+    } else {
+        using A = acc_t<T>;
+        for (int b = 0; b < rows; ++b) {
+            const T* in = x + static_cast<size_t>(b) * cols;
+            T* out = y + static_cast<size_t>(b) * cols;
+            A max_val = in[0];
+            for (int j = 1; j < cols; ++j) {
+                max_val = std::max(max_val, static_cast<A>(in[j]));
+            }
+            A sum = 0;
+            for (int j = 0; j < cols; ++j) {
+                sum += std::exp(static_cast<A>(in[j]) - max_val);
+            }
+            for (int j = 0; j < cols; ++j) {
+                out[j] = T(std::exp(static_cast<A>(in[j]) - max_val) / sum);
+            }
+        }
+    }
+}
+
+template <typename T>
+void cross_entropy_grad(const T* probs, const T* labels, acc_t<T>* grad, int rows, int cols, acc_t<T> scale) {
+    if constexpr (native<T>) {
+        kernels<T>().cross_entropy_grad(probs, labels, grad, rows, cols, scale);
+    } else {
+        using A = acc_t<T>;
+        for (int b = 0; b < rows; ++b) {
+            const int target = static_cast<int>(static_cast<A>(labels[b]));
+            for (int j = 0; j < cols; ++j) {
+                const A targ = j == target ? A(1) : A(0);
+                grad[b * cols + j] = (static_cast<A>(probs[b * cols + j]) - targ) * scale;
+            }
+        }
+    }
+}
+
+template <typename T>
+double softmax_cross_entropy(const T* logits, const T* labels, T* probs, acc_t<T>* grad, int rows, int cols,
+                             acc_t<T> scale) {
+    if constexpr (native<T>) {
+        return kernels<T>().softmax_cross_entropy(logits, labels, probs, grad, rows, cols, scale);
+    } else {
+        using A = acc_t<T>;
+        double loss = 0.0;
+        for (int b = 0; b < rows; ++b) {
+            const T* in = logits + static_cast<size_t>(b) * cols;
+            const int target = static_cast<int>(static_cast<A>(labels[b]));
+            const A target_logit = in[target];
+            A max_val = in[0];
+            for (int j = 1; j < cols; ++j) {
+                max_val = std::max(max_val, static_cast<A>(in[j]));
+            }
+            A sum = 0;
+            for (int j = 0; j < cols; ++j) {
+                sum += std::exp(static_cast<A>(in[j]) - max_val);
+            }
+            loss += std::log(static_cast<double>(sum)) + static_cast<double>(max_val - target_logit);
+            for (int j = 0; j < cols; ++j) {
+                const A p = std::exp(static_cast<A>(in[j]) - max_val) / sum;
+                if (grad) {
+                    grad[static_cast<size_t>(b) * cols + j] = (p - (j == target ? A(1) : A(0))) * scale;
+                }
+                if (probs) {
+                    probs[static_cast<size_t>(b) * cols + j] = T(p);
+                }
+            }
+        }
+        return loss;
+    }
+}
+
+template <typename T>
+void bias_backward(const acc_t<T>* dy, const T* mask, acc_t<T>* dy_out, acc_t<T>* db, int rows, int cols,
+                   acc_t<T> beta) {
+    if constexpr (native<T>) {
+        kernels<T>().bias_backward(dy, mask, dy_out, db, rows, cols, beta);
+    } else {
+        using A = acc_t<T>;
+        if (beta == A(0)) {
+            std::fill(db, db + cols, A(0));
+        }
+        for (int b = 0; b < rows; ++b) {
+            for (int j = 0; j < cols; ++j) {
+                const size_t idx = static_cast<size_t>(b) * cols + j;
+                A v = dy[idx];
+                if (mask) {
+                    v = static_cast<A>(mask[idx]) > 0 ? v : A(0);
+                    dy_out[idx] = v;
+                }
+                db[j] += v;
+            }
+        }
+    }
+}
+
+template <typename T>
+void accumulate(T* dst, const T* src, size_t n) {
+    kernels<T>().accumulate(dst, src, n);
+}
+
+template <typename T>
+void sgd_update(T* param, const acc_t<T>* grad, acc_t<T> learning_rate, size_t n) {
+    if constexpr (native<T>) {
+        kernels<T>().sgd_update(param, grad, learning_rate, n);
+    } else {
+        for (size_t i = 0; i < n; ++i) {
+            param[i] = T(static_cast<acc_t<T>>(param[i]) - learning_rate * grad[i]);
+        }
+    }
+}
+
+template <typename T>
+void momentum_update(T* param, const acc_t<T>* grad, acc_t<T>* velocity, size_t n, acc_t<T> learning_rate,
+                     acc_t<T> momentum, acc_t<T> weight_decay, bool nesterov) {
+    if constexpr (native<T>) {
+        kernels<T>().momentum_update(param, grad, velocity, n, learning_rate, momentum, weight_decay, nesterov);
+    } else {
+        using A = acc_t<T>;
+        for (size_t i = 0; i < n; ++i) {
+            const A p = static_cast<A>(param[i]);
+            const A g = grad[i] + weight_decay * p;
+            const A v = momentum * velocity[i] + g;
+            velocity[i] = v;
+            param[i] = T(p - learning_rate * (nesterov ? g + momentum * v : v));
+        }
+    }
+}
+
+template <typename T>
+void adam_update(T* param, const acc_t<T>* grad, acc_t<T>* m, acc_t<T>* v, size_t n,
+                 const AdamCoefficients<acc_t<T>>& c) {
+    if constexpr (native<T>) {
+        kernels<T>().adam_update(param, grad, m, v, n, c);
+    } else {
+        using A = acc_t<T>;
+        for (size_t i = 0; i < n; ++i) {
+            const A p = static_cast<A>(param[i]);
+            const A g = grad[i] + c.l2 * p;
+            m[i] = c.beta1 * m[i] + (A(1) - c.beta1) * g;
+            v[i] = c.beta2 * v[i] + (A(1) - c.beta2) * g * g;
+            param[i] = T(c.decay * p - c.step_size * m[i] / (std::sqrt(v[i]) * c.inv_sqrt_bias2 + c.epsilon));
+        }
+    }
+}
+
+template <typename T>
+void dequantize_u8(const uint8_t* q, T* out, size_t n, acc_t<T> scale, acc_t<T> offset) {
+    if constexpr (native<T>) {
+        kernels<T>().dequantize_u8(q, out, n, scale, offset);
+    } else {
+        for (size_t i = 0; i < n; ++i) {
+            out[i] = T(offset + scale * static_cast<acc_t<T>>(q[i]));
+        }
+    }
+}
+
+template <typename T>
+void scale_i32(const int32_t* q, T* out, size_t n, acc_t<T> scale, acc_t<T> offset) {
+    if constexpr (native<T>) {
+        kernels<T>().scale_i32(q, out, n, scale, offset);
+    } else {
+        for (size_t i = 0; i < n; ++i) {
+            out[i] = T(offset + scale * static_cast<acc_t<T>>(q[i]));
+        }
+    }
+}
+
+#define INSTANTIATE_OPS(T) \
+    template void bias_add<T>(T*, const T*, int, int); \
+    template void relu_forward<T>(const T*, T*, size_t); \
+    template void relu_backward<T>(const T*, const acc_t<T>*, acc_t<T>*, size_t); \
+    template void softmax_rows<T>(const T*, T*, int, int); \
+    template void cross_entropy_grad<T>(const T*, const T*, acc_t<T>*, int, int, acc_t<T>); \
+    template double softmax_cross_entropy<T>(const T*, const T*, T*, acc_t<T>*, int, int, acc_t<T>); \
+    template void bias_backward<T>(const acc_t<T>*, const T*, acc_t<T>*, acc_t<T>*, int, int, acc_t<T>); \
+    template void sgd_update<T>(T*, const acc_t<T>*, acc_t<T>, size_t); \
+    template void momentum_update<T>(T*, const acc_t<T>*, acc_t<T>*, size_t, acc_t<T>, acc_t<T>, acc_t<T>, bool); \
+    template void adam_update<T>(T*, const acc_t<T>*, acc_t<T>*, acc_t<T>*, size_t, const AdamCoefficients<acc_t<T>>&); \
+    template void dequantize_u8<T>(const uint8_t*, T*, size_t, acc_t<T>, acc_t<T>); \
+    template void scale_i32<T>(const int32_t*, T*, size_t, acc_t<T>, acc_t<T>);
+
+INSTANTIATE_OPS(float)
+INSTANTIATE_OPS(double)
+INSTANTIATE_OPS(bf16)
+
+template void accumulate<float>(float*, const float*, size_t);
+template void accumulate<double>(double*, const double*, size_t);
+
+} // namespace ops
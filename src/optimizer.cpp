@@ -0,0 +1,171 @@
+#include "../include/optimizer.hpp"
+#include "../include/ops.hpp"
+#include "../include/trace.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace {
+
+// Elements per worker below which splitting a step costs more than it saves
+constexpr size_t MIN_SLICE = 16384;
+// Slices start on a multiple of this, so an element takes the same vector or scalar-tail path
+// (and rounds the same) however many workers split the step
+constexpr size_t SLICE_ALIGN = 64;
+
+int slots_for(const OptimizerConfig& config) {
+    switch (config.type) {
+        case OptimizerType::SGD:
+            return config.weight_decay != 0.0 ? 1 : 0; // Runs as momentum 0, see update()
+        case OptimizerType::MOMENTUM:
+        case OptimizerType::NESTEROV:
+            return 1;
+        case OptimizerType::ADAM:
+        case OptimizerType::ADAMW:
+            return 2;
+    }
+    return 0;
+}
+
+} // namespace
+
+OptimizerConfig optimizer_config(const std::string& name) {
+    OptimizerConfig config;
+    if (name == "sgd") {
+        config.type = OptimizerType::SGD;
+    } else if (name == "momentum") {
+        config.type = OptimizerType::MOMENTUM;
+    } else if (name == "nesterov") {
+        config.type = OptimizerType::NESTEROV;
+    } else if (name == "adam") {
+        config.type = OptimizerType::ADAM;
+        config.learning_rate = 1e-3;
+    } else if (name == "adamw") {
+        config.type = OptimizerType::ADAMW;
+        config.learning_rate = 1e-3;
+        config.weight_decay = 0.01;
+    } else {
+        throw std::runtime_error("Unknown optimizer " + name + ", expected sgd, momentum, nesterov, adam or adamw");
+    }
+    return config;
+}
+
+const char* optimizer_name(OptimizerType type) {
+    switch (type) {
+        case OptimizerType::SGD: return "sgd";
+        case OptimizerType::MOMENTUM: return "momentum";
+        case OptimizerType::NESTEROV: return "nesterov";
+        case OptimizerType::ADAM: return "adam";
+        case OptimizerType::ADAMW: return "adamw";
+    }
+    return "unknown";
+}
+
+template <typename T>
+BasicOptimizer<T>::BasicOptimizer(BasicModel<T>& model, const OptimizerConfig& config, ThreadPool* pool)
+    : model(model), config(config), pool(pool), num_slots(slots_for(config)) {
+    if (model.mapped()) {
+        throw std::runtime_error("Cannot optimize a model mapped from a checkpoint, load it with LoadMode::COPY");
+    }
+    if (!model.packed()) {
+        model.pack_parameters();
+    }
+    slots.assign(num_slots * model.parameters.size(), acc_t<T>(0));
+}
+
+template <typename T>
+void BasicOptimizer<T>::step(double learning_rate) {
+    const size_t n = model.parameters.size();
+    if (!model.packed() || slots.size() != num_slots * n) {
+        throw std::runtime_error("Model layers changed after the optimizer was created");
+    }
+    ++step_count;
+    model.set_weight_layout(WeightLayout::ROW_MAJOR);
+
+    // Per parameter: read param, grad and every state slot, write param and every slot
+    TRACE_SCOPE("optimizer", optimizer_name(config.type), -1, double(n) * (num_slots == 2 ? 12 : 2 + 2 * num_slots),
+                double(n) * (2 * sizeof(T) + sizeof(acc_t<T>) * (1 + 2 * num_slots)));
+
+    const acc_t<T> lr = static_cast<acc_t<T>>(learning_rate);
+    const int workers = pool ? std::min<int>(pool->size(), static_cast<int>(std::max<size_t>(1, n / MIN_SLICE))) : 1;
+    if (workers <= 1) {
+        update(0, n, lr);
+        return;
+    }
+    pool->run([&](int w) {
+        if (w < workers) {
+            auto slice = ThreadPool::split((n + SLICE_ALIGN - 1) / SLICE_ALIGN, workers, w);
+            update(std::min(n, slice.first * SLICE_ALIGN), std::min(n, slice.second * SLICE_ALIGN), lr);
+        }
+    });
+}
+
+template <typename T>
+void BasicOptimizer<T>::update(size_t begin, size_t end, acc_t<T> learning_rate) {
+    using A = acc_t<T>;
+    const size_t n = model.parameters.size();
+    const size_t count = end - begin;
+    T* param = model.parameters.data() + begin;
+    const A* grad = model.gradients.data() + begin;
+    A* first = num_slots > 0 ? slots.data() + begin : nullptr;
+    A* second = num_slots > 1 ? slots.data() + n + begin : nullptr;
+    const A weight_decay = static_cast<A>(config.weight_decay);
+
+    switch (config.type) {
+        case OptimizerType::SGD:
+            if (first) {
+                ops::momentum_update(param, grad, first, count, learning_rate, A(0), weight_decay, false);
+            } else {
+                ops::sgd_update(param, grad, learning_rate, count);
+            }
+            break;
+        case OptimizerType::MOMENTUM:
+        case OptimizerType::NESTEROV:
+            ops::momentum_update(param, grad, first, count, learning_rate, static_cast<A>(config.momentum),
+                                 weight_decay, config.type == OptimizerType::NESTEROV);
+            break;
+        case OptimizerType::ADAM:
+        case OptimizerType::ADAMW: {
+            const double t = static_cast<double>(step_count);
+            const bool decoupled = config.type == OptimizerType::ADAMW;
+            AdamCoefficients<A> c;
+            c.beta1 = static_cast<A>(config.beta1);
+            c.beta2 = static_cast<A>(config.beta2);
+            c.epsilon = static_cast<A>(config.epsilon);
+            c.step_size = static_cast<A>(learning_rate / (1.0 - std::pow(config.beta1, t)));
+            c.inv_sqrt_bias2 = static_cast<A>(1.0 / std::sqrt(1.0 - std::pow(config.beta2, t)));
+            c.l2 = decoupled ? A(0) : weight_decay;
+            c.decay = decoupled ? A(1) - learning_rate * weight_decay : A(1);
+            ops::adam_update(param, grad, first, second, count, c);
+            break;
+        }
+    }
+}
+
+template <typename T>
+BasicOptimizerState<T> BasicOptimizer<T>::state() const {
+    BasicOptimizerState<T> s;
+    s.name = optimizer_name(config.type);
+    s.step = step_count;
+    s.values = slots;
+    return s;
+}
+
+template <typename T>
+void BasicOptimizer<T>::load_state(const BasicOptimizerState<T>& state) {
+    if (state.name != optimizer_name(config.type)) {
+        throw std::runtime_error("Optimizer state was saved by " + (state.name.empty() ? "nothing" : state.name) +
+                                 ", not " + optimizer_name(config.type));
+    }
+    if (state.values.size() != slots.size()) {
+        throw std::runtime_error("Optimizer state has " + std::to_string(state.values.size()) + " values, expected " +
+                                 std::to_string(slots.size()));
+    }
+    slots = state.values;
+    step_count = state.step;
+}
+
+template class BasicOptimizer<float>;
+template class BasicOptimizer<double>;
+template class BasicOptimizer<bf16>;
@@ -0,0 +1,233 @@
+#include "../include/quantize.hpp"
+#include "../include/gemm.hpp"
+#include "../include/kernels.hpp"
+#include "../include/ops.hpp"
+#include "../include/trace.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+constexpr int QMAX = 127;
+
+int round_k(int n) {
+    return (n + INT8_K_ALIGN - 1) / INT8_K_ALIGN * INT8_K_ALIGN;
+}
+
+// Clamped before rounding so it stays branch free and vectorizes, rounding halves up is fine
+// for values that are never negative by then
+inline uint8_t quantize_activation(float x, float inv_scale, float zero, float lo) {
+    float q = x * inv_scale + zero;
+    q = q < lo ? lo : q;
+    q = q > QMAX ? QMAX : q;
+    return static_cast<uint8_t>(static_cast<int>(q + 0.5f));
+}
+
+// Affine scale covering [lo, hi], widened to include 0 so it stays exact
+void activation_scale(float lo, float hi, float& scale, int& zero) {
+    lo = std::min(lo, 0.0f);
+    hi = std::max(hi, 0.0f);
+    scale = hi > lo ? (hi - lo) / QMAX : 1.0f;
+    zero = static_cast<int>(std::lrint(-lo / scale));
+}
+
+struct LinearPlan {
+    int layer;
+    bool relu;
+};
+
+// LINEAR layers with whether a RELU follows each, checking the model is supported
+std::vector<LinearPlan> plan_layers(const Model& model, bool& softmax) {
+    std::vector<LinearPlan> plan;
+    softmax = false;
+    const int n = static_cast<int>(model.layers.size());
+    for (int l = 0; l < n; ++l) {
+        const LayerType type = model.layers[l]->layer_type;
+        if (type == LayerType::LINEAR) {
+            const bool relu = l + 1 < n && model.layers[l + 1]->layer_type == LayerType::RELU;
+            plan.push_back({l, relu});
+            l += relu ? 1 : 0;
+        } else if (type == LayerType::SOFTMAX && l == n - 1 && !plan.empty()) {
+            softmax = true;
+        } else {
+            throw std::runtime_error("Cannot quantize layer " + std::to_string(l) +
+                                     ": only LINEAR, LINEAR+RELU and a final SOFTMAX are supported");
+        }
+    }
+    if (plan.empty()) {
+        throw std::runtime_error("Cannot quantize a model without LINEAR layers");
+    }
+    return plan;
+}
+
+} // namespace
+
+QuantizedModel quantize_model(const Model& model, const Dataset& calibration, int samples) {
+    TRACE_SCOPE("quantize", "calibrate");
+    QuantizedModel q;
+    const std::vector<LinearPlan> plan = plan_layers(model, q.softmax);
+    if (model.layers[plan[0].layer]->weights->shape[0] != calibration.features) {
+        throw std::runtime_error("Calibration data has " + std::to_string(calibration.features) +
+                                 " features, the model expects " +
+                                 std::to_string(model.layers[plan[0].layer]->weights->shape[0]));
+    }
+
+    // Float forward pass over the calibration rows, tracking the range of every LINEAR input
+    samples = std::max(1, std::min(samples, calibration.count));
+    std::vector<float> lo(plan.size(), 0.0f), hi(plan.size(), 0.0f);
+    const int batch = 64;
+    Tensor x(std::vector<int>{batch, calibration.features});
+    Tensor labels(std::vector<int>{batch, 1});
+    Tensor y(std::vector<int>{batch, 1});
+    for (int first = 0; first < samples; first += batch) {
+        const int rows = std::min(batch, samples - first);
+        x.resize(rows, calibration.features);
+        labels.resize(rows, 1);
+        calibration.fill_batch(first, rows, x, labels);
+        for (size_t p = 0; p < plan.size(); ++p) {
+            const auto minmax = std::minmax_element(x.data.begin(), x.data.end());
+            lo[p] = std::min(lo[p], *minmax.first);
+            hi[p] = std::max(hi[p], *minmax.second);
+
+            const Layer& layer = *model.layers[plan[p].layer];
+            const int in = layer.weights->shape[0];
+            const int out = layer.weights->shape[1];
+            y.resize(rows, out);
+            gemm(Transpose::NO, Transpose::NO, rows, out, in, 1.0f, x.data.data(), in, layer.weights->data.data(), out,
+                 0.0f, y.data.data(), out, plan[p].relu ? Epilogue::BIAS_RELU : Epilogue::BIAS,
+                 layer.bias->data.data());
+            std::swap(x, y);
+        }
+    }
+
+    for (size_t p = 0; p < plan.size(); ++p) {
+        const Layer& layer = *model.layers[plan[p].layer];
+        QuantizedLinear ql;
+        ql.input = layer.weights->shape[0];
+        ql.output = layer.weights->shape[1];
+        ql.k = round_k(ql.input);
+        ql.relu = plan[p].relu;
+        ql.last = p + 1 == plan.size();
+        activation_scale(lo[p], hi[p], ql.in_scale, ql.in_zero);
+        if (!ql.last) {
+            activation_scale(lo[p + 1], hi[p + 1], ql.out_scale, ql.out_zero);
+        }
+
+        // Transposed to one row per output channel, each with its own symmetric scale
+        const float* w = layer.weights->data.data();
+        ql.weights.assign(static_cast<size_t>(ql.output) * ql.k, 0);
+        ql.weight_scale.resize(ql.output);
+        ql.offset.resize(ql.output);
+        ql.multiplier.resize(ql.output);
+        for (int c = 0; c < ql.output; ++c) {
+            float max_abs = 0.0f;
+            for (int i = 0; i < ql.input; ++i) {
+                max_abs = std::max(max_abs, std::fabs(w[static_cast<size_t>(i) * ql.output + c]));
+            }
+            const float scale = max_abs > 0.0f ? max_abs / QMAX : 1.0f;
+            int32_t row_sum = 0;
+            for (int i = 0; i < ql.input; ++i) {
+                const long v = std::lrint(w[static_cast<size_t>(i) * ql.output + c] / scale);
+                const int8_t qv = static_cast<int8_t>(std::min<long>(QMAX, std::max<long>(-QMAX, v)));
+                ql.weights[static_cast<size_t>(c) * ql.k + i] = qv;
+                row_sum += qv;
+            }
+            const float acc_scale = ql.in_scale * scale;
+            ql.weight_scale[c] = scale;
+            ql.offset[c] = static_cast<int32_t>(std::lrint(layer.bias->data[c] / acc_scale)) - ql.in_zero * row_sum;
+            ql.multiplier[c] = ql.last ? acc_scale : acc_scale / ql.out_scale;
+        }
+        q.layers.push_back(std::move(ql));
+    }
+    return q;
+}
+
+void QuantizedModel::infer(const Tensor& input, Tensor& output) const {
+    const int rows = input.shape[0];
+    const QuantizedLinear& first = layers.front();
+    if (input.shape[1] != first.input) {
+        throw std::runtime_error("Invalid input width " + std::to_string(input.shape[1]) + " for a model expecting " +
+                                 std::to_string(first.input));
+    }
+    output.resize(rows, layers.back().output);
+    const Int8Kernels& kernels = int8_kernels();
+
+    // Activations ping-pong between two uint8 buffers, accumulators go through one int32
+    // buffer; all of them only ever grow
+    thread_local std::vector<uint8_t> ping, pong;
+    thread_local std::vector<int32_t> acc;
+    size_t max_k = 0, max_out = 0;
+    for (const QuantizedLinear& l : layers) {
+        max_k = std::max<size_t>(max_k, l.k);
+        max_out = std::max<size_t>(max_out, l.output);
+    }
+    if (ping.size() < rows * max_k || acc.size() < rows * max_out) {
+        ping.resize(rows * max_k);
+        pong.resize(rows * max_k);
+        acc.resize(rows * max_out);
+    }
+
+    // Everything the loops read is hoisted into locals, the uint8 stores could alias it otherwise
+    const int in = first.input;
+    const int in_k = first.k;
+    const float inv_scale = 1.0f / first.in_scale;
+    const float in_zero = static_cast<float>(first.in_zero);
+    for (int r = 0; r < rows; ++r) {
+        const float* x = input.data.data() + static_cast<size_t>(r) * in;
+        uint8_t* qx = ping.data() + static_cast<size_t>(r) * in_k;
+        for (int i = 0; i < in; ++i) {
+            qx[i] = quantize_activation(x[i], inv_scale, in_zero, 0.0f);
+        }
+        std::fill(qx + in, qx + in_k, uint8_t(0));
+    }
+
+    uint8_t* current = ping.data();
+    uint8_t* next = pong.data();
+    for (size_t l = 0; l < layers.size(); ++l) {
+        const QuantizedLinear& layer = layers[l];
+        TRACE_SCOPE("infer_int8", layer.relu ? "linear+relu" : "linear", static_cast<int>(l),
+                    2.0 * rows * layer.input * layer.output,
+                    double(layer.weights.size()) + rows * (layer.k + 4.0 * layer.output));
+        kernels.gemm_u8s8(current, layer.weights.data(), acc.data(), rows, layer.output, layer.k);
+
+        const int out = layer.output;
+        const int32_t* offset = layer.offset.data();
+        const float* multiplier = layer.multiplier.data();
+        for (int r = 0; r < rows; ++r) {
+            const int32_t* a = acc.data() + static_cast<size_t>(r) * out;
+            if (layer.last) {
+                float* y = output.data.data() + static_cast<size_t>(r) * out;
+                const float lo = layer.relu ? 0.0f : -INFINITY;
+                for (int c = 0; c < out; ++c) {
+                    y[c] = std::max(lo, multiplier[c] * static_cast<float>(a[c] + offset[c]));
+                }
+            } else {
+                // Requantize for the next layer, a ReLU just raises the lower clamp to the zero point
+                const int next_k = layers[l + 1].k;
+                uint8_t* y = next + static_cast<size_t>(r) * next_k;
+                const float zero = static_cast<float>(layer.out_zero);
+                const float lo = layer.relu ? zero : 0.0f;
+                for (int c = 0; c < out; ++c) {
+                    y[c] = quantize_activation(static_cast<float>(a[c] + offset[c]), multiplier[c], zero, lo);
+                }
+                std::fill(y + out, y + next_k, uint8_t(0));
+            }
+        }
+        std::swap(current, next);
+    }
+
+    if (softmax) {
+        ops::softmax_rows(output.data.data(), output.data.data(), rows, layers.back().output);
+    }
+}
+
+size_t QuantizedModel::weight_bytes() const {
+    size_t bytes = 0;
+    for (const QuantizedLinear& l : layers) {
+        bytes += l.weights.size() + l.weight_scale.size() * sizeof(float) + l.offset.size() * sizeof(int32_t);
+    }
+    return bytes;
+}
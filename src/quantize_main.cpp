@@ -0,0 +1,98 @@
+#include "../include/model.hpp"
+#include "../include/dataset.hpp"
+#include "../include/kernels.hpp"
+#include "../include/quantize.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Quantizes a trained checkpoint to int8 and reports how much accuracy that costs on the
+// test set, next to the speed of both models.
+//
+//   ./quantize [model.ckpt] [calibration samples]
+
+namespace {
+
+struct Score {
+    int correct = 0;
+    double seconds = 0.0;
+    std::vector<int> predictions;
+};
+
+int argmax(const float* row, int cols) {
+    return static_cast<int>(std::max_element(row, row + cols) - row);
+}
+
+template <typename Infer>
+Score evaluate(const Dataset& test, int classes, Infer infer) {
+    const int batch = 64;
+    Tensor input(std::vector<int>{batch, test.features});
+    Tensor labels(std::vector<int>{batch, 1});
+    Tensor output(std::vector<int>{batch, classes});
+    Score score;
+    score.predictions.reserve(test.count);
+    for (int first = 0; first < test.count; first += batch) {
+        const int rows = std::min(batch, test.count - first);
+        input.resize(rows, test.features);
+        labels.resize(rows, 1);
+        test.fill_batch(first, rows, input, labels);
+
+        auto start = std::chrono::steady_clock::now();
+        infer(input, output);
+        score.seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        for (int r = 0; r < rows; ++r) {
+            const int predicted = argmax(&output.data[static_cast<size_t>(r) * classes], classes);
+            score.predictions.push_back(predicted);
+            score.correct += predicted == test.label(first + r);
+        }
+    }
+    return score;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const std::string checkpoint = argc > 1 ? argv[1] : "model.ckpt";
+    const int samples = argc > 2 ? std::max(1, std::atoi(argv[2])) : 1000;
+
+    Model model = Model::load(checkpoint);
+    model.set_weight_layout(WeightLayout::PANELS);
+    auto calibration = load_dataset("data/train_dataset.txt");
+    auto test = load_dataset("data/test_dataset.txt");
+
+    QuantizedModel quantized = quantize_model(model, *calibration, samples);
+    const int classes = quantized.layers.back().output;
+
+    size_t float_bytes = 0;
+    for (const auto& layer : model.layers) {
+        if (layer->weights) {
+            float_bytes += (layer->weights->total_size + layer->bias->total_size) * sizeof(float);
+        }
+    }
+
+    Score reference = evaluate(*test, classes, [&](const Tensor& x, Tensor& y) { infer(model, x, y); });
+    Score int8 = evaluate(*test, classes, [&](const Tensor& x, Tensor& y) { quantized.infer(x, y); });
+
+    int agree = 0;
+    for (int i = 0; i < test->count; ++i) {
+        agree += reference.predictions[i] == int8.predictions[i];
+    }
+    const double n = test->count;
+
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "Calibrated on " << std::min(samples, calibration->count) << " samples, int8 kernels: "
+              << int8_kernels().name << std::endl;
+    std::cout << "Weights: float32 " << float_bytes / 1024.0 << " KiB, int8 " << quantized.weight_bytes() / 1024.0
+              << " KiB (" << double(float_bytes) / quantized.weight_bytes() << "x smaller)" << std::endl;
+    std::cout << "Accuracy: float32 " << 100.0 * reference.correct / n << "%, int8 " << 100.0 * int8.correct / n
+              << "%, difference " << 100.0 * (int8.correct - reference.correct) / n << " points" << std::endl;
+    std::cout << "Predictions agreeing: " << 100.0 * agree / n << "%" << std::endl;
+    std::cout << "Inference: float32 " << 1e9 * reference.seconds / n << " ns/sample, int8 "
+              << 1e9 * int8.seconds / n << " ns/sample (" << reference.seconds / int8.seconds << "x)" << std::endl;
+    return 0;
+}
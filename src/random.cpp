@@ -0,0 +1,122 @@
+#include "../include/random.hpp"
+#include "../include/dtype.hpp"
+#include "../include/kernels.hpp"
+#include "../include/ops.hpp"
+#include "../include/thread_pool.hpp"
+#include "../include/trace.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <utility>
+
+namespace rng {
+
+namespace {
+
+std::atomic<uint64_t> global_seed{DEFAULT_SEED};
+std::atomic<uint64_t> streams{0};
+
+// Blocks per call into the kernel, small enough for the values to stay in L1
+constexpr size_t CHUNK_BLOCKS = 64;
+
+// Hands the stream's values [first, last) to use(start, count, bits) a chunk at a time,
+// bits[j] being value start + j. Value v is lane v % 4 of block v / 4, and every chunk but
+// the first starts on a block.
+template <typename F>
+void for_each_chunk(size_t first, size_t last, uint64_t seed, uint64_t stream, F&& use) {
+    const RandomKernels& k = random_kernels();
+    alignas(64) uint32_t bits[4 * CHUNK_BLOCKS];
+    for (size_t start = first; start < last;) {
+        const size_t block = start / 4;
+        const size_t end = std::min(last, (block + CHUNK_BLOCKS) * 4);
+        k.philox(seed, stream, block, (end - 4 * block + 3) / 4, bits);
+        use(start, end - start, bits + start % 4);
+        start = end;
+    }
+}
+
+// Whole chunks per worker, so only the last one is short
+template <typename F>
+void run_split(size_t n, ThreadPool* pool, F&& fill) {
+    if (!pool || pool->size() == 1) {
+        fill(size_t(0), n);
+        return;
+    }
+    const size_t chunk = 4 * CHUNK_BLOCKS;
+    const size_t chunks = (n + chunk - 1) / chunk;
+    pool->run([&](int w) {
+        auto range = ThreadPool::split(chunks, pool->size(), w);
+        fill(std::min(n, range.first * chunk), std::min(n, range.second * chunk));
+    });
+}
+
+} // namespace
+
+void set_seed(uint64_t seed) {
+    global_seed = seed;
+    streams = 0;
+}
+
+uint64_t seed() {
+    return global_seed;
+}
+
+uint64_t next_stream() {
+    return TENSOR_STREAMS + streams++;
+}
+
+template <typename T>
+void fill_uniform(T* out, size_t n, double lo, double hi, uint64_t stream, uint64_t seed, ThreadPool* pool) {
+    TRACE_SCOPE("rng", "fill_uniform", -1, 0.0, double(n) * sizeof(T));
+    // lo + (hi - lo) * to_unit(bits) as one multiply-add on the signed bits
+    const acc_t<T> scale = static_cast<acc_t<T>>((hi - lo) / 4294967296.0);
+    const acc_t<T> offset = static_cast<acc_t<T>>(lo + (hi - lo) * (2147483648.5 / 4294967296.0));
+    run_split(n, pool, [&](size_t first, size_t last) {
+        for_each_chunk(first, last, seed, stream, [&](size_t start, size_t count, const uint32_t* bits) {
+            ops::scale_i32(reinterpret_cast<const int32_t*>(bits), out + start, count, scale, offset);
+        });
+    });
+}
+
+template <typename T>
+void fill_normal(T* out, size_t n, double mean, double stddev, uint64_t stream, uint64_t seed, ThreadPool* pool) {
+    TRACE_SCOPE("rng", "fill_normal", -1, 0.0, double(n) * sizeof(T));
+    const double two_pi = 6.283185307179586;
+    // Elements 2p and 2p + 1 are the cosine and sine halves of one Box-Muller pair on stream
+    // values 2p and 2p + 1, so a range starting or ending mid-pair still gets the same values
+    run_split(n, pool, [&](size_t first, size_t last) {
+        const size_t begin = first & ~size_t(1);
+        const size_t end = (last + 1) & ~size_t(1);
+        // Chunks start on a block or at begin, so on a pair either way
+        for_each_chunk(begin, end, seed, stream, [&](size_t start, size_t count, const uint32_t* bits) {
+            for (size_t j = 0; j < count; j += 2) {
+                const double radius = stddev * std::sqrt(-2.0 * std::log(to_unit(bits[j])));
+                const double angle = two_pi * to_unit(bits[j + 1]);
+                const size_t i = start + j;
+                if (i >= first) {
+                    out[i] = static_cast<T>(mean + radius * std::cos(angle));
+                }
+                if (i + 1 < last) {
+                    out[i + 1] = static_cast<T>(mean + radius * std::sin(angle));
+                }
+            }
+        });
+    });
+}
+
+void shuffle(int* values, size_t n, uint64_t stream, uint64_t seed) {
+    Stream draws(stream, seed);
+    for (size_t i = n; i > 1; --i) {
+        std::swap(values[i - 1], values[draws.below(static_cast<uint32_t>(i))]);
+    }
+}
+
+template void fill_uniform(float*, size_t, double, double, uint64_t, uint64_t, ThreadPool*);
+template void fill_uniform(double*, size_t, double, double, uint64_t, uint64_t, ThreadPool*);
+template void fill_uniform(bf16*, size_t, double, double, uint64_t, uint64_t, ThreadPool*);
+template void fill_normal(float*, size_t, double, double, uint64_t, uint64_t, ThreadPool*);
+template void fill_normal(double*, size_t, double, double, uint64_t, uint64_t, ThreadPool*);
+template void fill_normal(bf16*, size_t, double, double, uint64_t, uint64_t, ThreadPool*);
+
+} // namespace rng
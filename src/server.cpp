@@ -0,0 +1,131 @@
+#include "../include/server.hpp"
+#include "../include/trace.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+InferenceServer::InferenceServer(const Model& model, const ServerConfig& config)
+    : model(model), config(config), started(Clock::now()) {
+    if (config.max_batch < 1 || config.max_delay_us < 0) {
+        throw std::runtime_error("Server needs max_batch >= 1 and max_delay_us >= 0");
+    }
+    for (const auto& layer : model.layers) {
+        if (layer->layer_type == LayerType::LINEAR) {
+            inputs = inputs ? inputs : layer->weights->shape[0];
+            outputs = layer->weights->shape[1];
+        }
+    }
+    if (!inputs) {
+        throw std::runtime_error("Cannot serve a model without LINEAR layers");
+    }
+    latencies.reserve(LATENCY_WINDOW);
+    batcher = std::thread([this] { batch_loop(); });
+}
+
+InferenceServer::~InferenceServer() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    ready.notify_all();
+    batcher.join();
+}
+
+std::future<std::vector<float>> InferenceServer::submit(std::vector<float> features) {
+    if (features.size() != static_cast<size_t>(inputs)) {
+        throw std::runtime_error("Request has " + std::to_string(features.size()) + " features, the model expects " +
+                                 std::to_string(inputs));
+    }
+    Request request;
+    request.features = std::move(features);
+    request.queued = Clock::now();
+    std::future<std::vector<float>> scores = request.scores.get_future();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        queue.push_back(std::move(request));
+    }
+    ready.notify_one();
+    return scores;
+}
+
+void InferenceServer::batch_loop() {
+    TRACE_THREAD_NAME("batcher");
+    Tensor input(std::vector<int>{config.max_batch, inputs});
+    Tensor output(std::vector<int>{config.max_batch, outputs});
+    std::vector<Request> batch;
+    batch.reserve(config.max_batch);
+    const auto max_delay = std::chrono::microseconds(config.max_delay_us);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        ready.wait(lock, [&] { return stopping || !queue.empty(); });
+        if (queue.empty()) {
+            return;
+        }
+        // Give the batch until the oldest request's deadline to fill up
+        ready.wait_until(lock, queue.front().queued + max_delay,
+                         [&] { return stopping || queue.size() >= static_cast<size_t>(config.max_batch); });
+        const size_t rows = std::min(queue.size(), static_cast<size_t>(config.max_batch));
+        for (size_t r = 0; r < rows; ++r) {
+            batch.push_back(std::move(queue.front()));
+            queue.pop_front();
+        }
+        lock.unlock();
+
+        {
+            TRACE_SCOPE("server", "batch", -1, static_cast<double>(rows));
+            input.resize(static_cast<int>(rows), inputs);
+            for (size_t r = 0; r < rows; ++r) {
+                std::copy(batch[r].features.begin(), batch[r].features.end(), &input.data[r * inputs]);
+            }
+            infer(model, input, output);
+        }
+
+        // Counted before anyone is answered, so stats() after a reply always includes it
+        const Clock::time_point done = Clock::now();
+        lock.lock();
+        for (const Request& request : batch) {
+            const double us = std::chrono::duration<double, std::micro>(done - request.queued).count();
+            if (latencies.size() < LATENCY_WINDOW) {
+                latencies.push_back(us);
+            } else {
+                latencies[next_latency] = us;
+            }
+            next_latency = (next_latency + 1) % LATENCY_WINDOW;
+        }
+        requests += rows;
+        ++batches;
+        lock.unlock();
+
+        for (size_t r = 0; r < rows; ++r) {
+            const float* scores = &output.data[r * outputs];
+            batch[r].scores.set_value(std::vector<float>(scores, scores + outputs));
+        }
+        batch.clear();
+        lock.lock();
+    }
+}
+
+ServerStats InferenceServer::stats() const {
+    std::vector<double> window;
+    ServerStats s;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        window = latencies;
+        s.requests = requests;
+        s.batches = batches;
+    }
+    s.mean_batch = s.batches ? static_cast<double>(s.requests) / s.batches : 0.0;
+    s.requests_per_second = s.requests / std::chrono::duration<double>(Clock::now() - started).count();
+    if (!window.empty()) {
+        auto percentile = [&](double p) {
+            auto nth = window.begin() + static_cast<size_t>(p * (window.size() - 1));
+            std::nth_element(window.begin(), nth, window.end());
+            return *nth;
+        };
+        s.p50_us = percentile(0.50);
+        s.p99_us = percentile(0.99);
+    }
+    return s;
+}
@@ -0,0 +1,325 @@
+#include "../include/model.hpp"
+#include "../include/server.hpp"
+#include "../include/thread_pool.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// Serves a checkpoint over a Unix domain socket, or stdin/stdout without --socket, with
+// requests from every connection batched together (see InferenceServer).
+//
+//   ./serve [model.ckpt] [--socket PATH] [--max-batch N] [--max-delay-us US] [--team N]
+//   ./serve [model.ckpt] --load CLIENTS [--seconds S] [--max-batch N] [--max-delay-us US] [--team N]
+//
+// Protocol, one line each way: a request is the comma separated features of one row, the
+// reply its comma separated class scores (or "error: ..."). A connection may send many
+// requests before reading replies, they come back in order. "stats" replies with the
+// latency and throughput so far, which are also printed to stderr on exit.
+//
+// --load runs CLIENTS threads in-process, each sending random rows back to back, and prints
+// the stats after S seconds: a quick way to pick max batch and delay for a traffic level.
+//
+// --team N splits batches of up to GEMV_MAX_ROWS rows over N spinning threads (the batcher
+// included), which keep N - 1 cores busy for as long as the server runs.
+
+namespace {
+
+struct Options {
+    std::string checkpoint = "model.ckpt";
+    std::string socket_path;
+    ServerConfig config;
+    int load_clients = 0;
+    double seconds = 5.0;
+    int team_threads = 0;
+};
+
+std::atomic<bool> interrupted{false};
+
+void on_signal(int) {
+    interrupted = true;
+}
+
+Options parse_args(int argc, char** argv) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        const bool has_value = i + 1 < argc;
+        if (arg == "--socket" && has_value) {
+            options.socket_path = argv[++i];
+        } else if (arg == "--max-batch" && has_value) {
+            options.config.max_batch = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "--max-delay-us" && has_value) {
+            options.config.max_delay_us = std::max(0, std::atoi(argv[++i]));
+        } else if (arg == "--load" && has_value) {
+            options.load_clients = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "--seconds" && has_value) {
+            options.seconds = std::max(0.1, std::atof(argv[++i]));
+        } else if (arg == "--team" && has_value) {
+            options.team_threads = std::max(1, std::atoi(argv[++i]));
+        } else if (arg[0] != '-') {
+            options.checkpoint = arg;
+        } else {
+            std::cerr << "Usage: " << argv[0]
+                      << " [model.ckpt] [--socket PATH | --load CLIENTS [--seconds S]] [--max-batch N]"
+                         " [--max-delay-us US] [--team N]"
+                      << std::endl;
+            std::exit(EXIT_FAILURE);
+        }
+    }
+    return options;
+}
+
+std::string format_stats(const InferenceServer& server) {
+    const ServerStats s = server.stats();
+    std::ostringstream out;
+    out << "requests " << s.requests << ", batches " << s.batches << ", mean batch " << s.mean_batch << ", p50 "
+        << s.p50_us << " us, p99 " << s.p99_us << " us, " << s.requests_per_second << " requests/s";
+    return out.str();
+}
+
+bool write_all(int fd, const std::string& text) {
+    size_t done = 0;
+    while (done < text.size()) {
+        const ssize_t n = write(fd, text.data() + done, text.size() - done);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        done += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+// One reply owed to a connection: scores still being computed, the stats as of when the
+// replies before it are out, or a line ready to go
+struct Reply {
+    std::future<std::vector<float>> scores;
+    bool stats = false;
+    std::string line;
+};
+
+// Reads requests from in_fd and writes replies to out_fd until EOF. Requests are submitted
+// as they arrive and a second thread writes the replies in order as they complete, so one
+// connection can have many rows in the same batch.
+void serve_connection(InferenceServer& server, int in_fd, int out_fd) {
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::deque<Reply> replies;
+    bool reading = true;
+
+    std::thread writer([&] {
+        bool open = true;
+        while (true) {
+            Reply reply;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                cv.wait(lock, [&] { return !replies.empty() || !reading; });
+                if (replies.empty()) {
+                    return;
+                }
+                reply = std::move(replies.front());
+                replies.pop_front();
+            }
+            std::string line = reply.stats ? format_stats(server) : std::move(reply.line);
+            if (reply.scores.valid()) {
+                const std::vector<float> scores = reply.scores.get();
+                for (size_t c = 0; c < scores.size(); ++c) {
+                    char value[32];
+                    std::snprintf(value, sizeof(value), c ? ",%.6g" : "%.6g", scores[c]);
+                    line += value;
+                }
+            }
+            open = open && write_all(out_fd, line + "\n");
+        }
+    });
+
+    auto push = [&](Reply reply) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            replies.push_back(std::move(reply));
+        }
+        cv.notify_one();
+    };
+
+    std::string pending;
+    std::string line;
+    std::vector<char> buffer(1 << 16);
+    std::vector<float> features;
+    while (true) {
+        const ssize_t n = read(in_fd, buffer.data(), buffer.size());
+        if (n < 0 && errno == EINTR && !interrupted) {
+            continue;
+        }
+        if (n <= 0) {
+            break;
+        }
+        pending.append(buffer.data(), static_cast<size_t>(n));
+        size_t start = 0;
+        for (size_t end; (end = pending.find('\n', start)) != std::string::npos; start = end + 1) {
+            // A copy of the line, so strtof() can't skip past its end into the next request
+            line.assign(pending, start, end - start);
+            const char* p = line.c_str();
+            const char* line_end = p + line.size();
+            Reply reply;
+            if (std::strncmp(p, "stats", 5) == 0) {
+                reply.stats = true;
+                push(std::move(reply));
+                continue;
+            }
+            features.clear();
+            while (p < line_end) {
+                char* next = nullptr;
+                const float value = std::strtof(p, &next);
+                if (next == p) {
+                    break;
+                }
+                features.push_back(value);
+                p = next < line_end && *next == ',' ? next + 1 : next;
+            }
+            try {
+                reply.scores = server.submit(features);
+            } catch (const std::exception& e) {
+                reply.line = std::string("error: ") + e.what();
+            }
+            push(std::move(reply));
+        }
+        pending.erase(0, start);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        reading = false;
+    }
+    cv.notify_one();
+    writer.join();
+}
+
+void serve_socket(InferenceServer& server, const std::string& path) {
+    const int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (listener < 0 || path.size() >= sizeof(address.sun_path)) {
+        throw std::runtime_error("Cannot create socket " + path);
+    }
+    std::strcpy(address.sun_path, path.c_str());
+    unlink(path.c_str());
+    if (bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || listen(listener, 64) != 0) {
+        throw std::runtime_error("Cannot listen on " + path + ": " + std::strerror(errno));
+    }
+    std::cerr << "Listening on " << path << std::endl;
+
+    // Connection threads are detached, so a long-running server keeps no thread object per
+    // connection it ever had. live counts the open ones; it is only touched under the mutex,
+    // so the last thread is done with both before the wait below can return.
+    std::mutex mutex;
+    std::condition_variable all_closed;
+    int live = 0;
+    while (!interrupted) {
+        const int fd = accept(listener, nullptr, nullptr);
+        if (fd < 0) {
+            continue; // EINTR from the signal, or a connection that went away
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            ++live;
+        }
+        auto finished = [&] {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (--live == 0) {
+                all_closed.notify_all();
+            }
+        };
+        try {
+            std::thread([&server, fd, finished] {
+                serve_connection(server, fd, fd);
+                close(fd);
+                finished();
+            }).detach();
+        } catch (const std::system_error& e) {
+            std::cerr << "Dropping a connection: " << e.what() << std::endl;
+            close(fd);
+            finished();
+        }
+    }
+    close(listener);
+    unlink(path.c_str());
+    // Open connections hold the server, so wait for their clients to hang up
+    std::unique_lock<std::mutex> lock(mutex);
+    all_closed.wait(lock, [&] { return live == 0; });
+}
+
+void run_load(InferenceServer& server, int clients, double seconds) {
+    const auto until = std::chrono::steady_clock::now() + std::chrono::duration<double>(seconds);
+    std::vector<std::thread> threads;
+    for (int c = 0; c < clients; ++c) {
+        threads.emplace_back([&server, until, c] {
+            std::mt19937 rng(c);
+            std::uniform_real_distribution<float> pixel(0.0f, 1.0f);
+            std::vector<float> row(server.input_width());
+            while (std::chrono::steady_clock::now() < until && !interrupted) {
+                std::generate(row.begin(), row.end(), [&] { return pixel(rng); });
+                server.submit(row).get();
+            }
+        });
+    }
+    for (std::thread& t : threads) {
+        t.join();
+    }
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const Options options = parse_args(argc, argv);
+
+    // Read-only mapping, and the weights packed for the GEMM once up front
+    Model model = Model::load(options.checkpoint, LoadMode::MMAP);
+    model.set_weight_layout(WeightLayout::PANELS);
+    if (options.team_threads > 1) {
+        model.set_inference_team(std::make_shared<SpinTeam>(options.team_threads));
+    }
+
+    struct sigaction action{};
+    action.sa_handler = on_signal;
+    sigaction(SIGINT, &action, nullptr); // No SA_RESTART, so accept() and read() return
+    sigaction(SIGTERM, &action, nullptr);
+    signal(SIGPIPE, SIG_IGN);
+
+    InferenceServer server(model, options.config);
+    std::cerr << "Serving " << options.checkpoint << ": " << server.input_width() << " features -> "
+              << server.output_width() << " scores, max batch " << options.config.max_batch << ", max delay "
+              << options.config.max_delay_us << " us" << std::endl;
+
+    if (options.load_clients > 0) {
+        run_load(server, options.load_clients, options.seconds);
+    } else if (!options.socket_path.empty()) {
+        serve_socket(server, options.socket_path);
+    } else {
+        serve_connection(server, STDIN_FILENO, STDOUT_FILENO);
+    }
+    std::cerr << format_stats(server) << std::endl;
+    return 0;
+}
@@ -1,34 +1,39 @@
 #include "../include/tensor.hpp"
+#include "../include/random.hpp"
 #include <iostream>
 #include <iomanip>
 #include <stdexcept>
 #include <numeric>
 #include <algorithm>
-#include <random>
 
-Tensor::Tensor(const std::vector<int>& shape, bool require_grad)
+template <typename T>
+BasicTensor<T>::BasicTensor(const std::vector<int>& shape, bool require_grad)
     : shape(shape), ndim(shape.size()), require_grad(require_grad) {
     total_size = std::accumulate(shape.begin(), shape.end(), 1, std::multiplies<int>());
-    data.resize(total_size, 0.0);
+    data.resize(total_size, T(0));
     if (require_grad) {
-        grad.resize(total_size, 0.0);
+        grad.resize(total_size, grad_type(0));
     }
 }
 
-Tensor::Tensor(const std::vector<int>& shape, bool require_grad, bool randomize)
-    : Tensor(shape, require_grad) {
+template <typename T>
+BasicTensor<T>::BasicTensor(const std::vector<int>& shape, bool require_grad, bool randomize)
+    : BasicTensor(shape, require_grad) {
     initialize(randomize);
 }
 
-Tensor::Tensor(const Tensor& other)
+template <typename T>
+BasicTensor<T>::BasicTensor(const BasicTensor& other)
     : data(other.data), grad(other.grad), shape(other.shape),
       ndim(other.ndim), total_size(other.total_size), require_grad(other.require_grad) {}
 
-Tensor::Tensor(Tensor&& other) noexcept
+template <typename T>
+BasicTensor<T>::BasicTensor(BasicTensor&& other) noexcept
     : data(std::move(other.data)), grad(std::move(other.grad)), shape(std::move(other.shape)),
       ndim(other.ndim), total_size(other.total_size), require_grad(other.require_grad) {}
 
-Tensor& Tensor::operator=(const Tensor& other) {
+template <typename T>
+BasicTensor<T>& BasicTensor<T>::operator=(const BasicTensor& other) {
     if (this != &other) {
         data = other.data;
         grad = other.grad;
@@ -40,7 +45,8 @@ Tensor& Tensor::operator=(const Tensor& other) {
     return *this;
 }
 
-Tensor& Tensor::operator=(Tensor&& other) noexcept {
+template <typename T>
+BasicTensor<T>& BasicTensor<T>::operator=(BasicTensor&& other) noexcept {
     if (this != &other) {
         data = std::move(other.data);
         grad = std::move(other.grad);
@@ -52,18 +58,42 @@ Tensor& Tensor::operator=(Tensor&& other) noexcept {
     return *this;
 }
 
-void Tensor::initialize(bool randomize) {
+template <typename T>
+void BasicTensor<T>::initialize(bool randomize) {
     if (randomize) {
-        std::random_device rd;
-        std::mt19937 gen(rd());
-        std::uniform_real_distribution<> dis(-1.0, 1.0);
-        std::generate(data.begin(), data.end(), [&]() { return dis(gen); });
+        rng::fill_uniform(data.data(), total_size, -1.0, 1.0, rng::next_stream());
     } else {
-        std::fill(data.begin(), data.end(), 0.0);
+        std::fill(data.begin(), data.end(), T(0));
     }
 }
 
-void Tensor::print() const {
+template <typename T>
+void BasicTensor<T>::borrow(T* data_ptr, grad_type* grad_ptr, int rows, int cols) {
+    shape.resize(2);
+    shape[0] = rows;
+    shape[1] = cols;
+    ndim = 2;
+    total_size = static_cast<size_t>(rows) * cols;
+    data.borrow(data_ptr, total_size);
+    grad.borrow(grad_ptr, grad_ptr ? total_size : 0);
+    require_grad = grad_ptr != nullptr;
+}
+
+template <typename T>
+void BasicTensor<T>::resize(int rows, int cols) {
+    shape.resize(2);
+    shape[0] = rows;
+    shape[1] = cols;
+    ndim = 2;
+    total_size = static_cast<size_t>(rows) * cols;
+    data.resize(total_size);
+    if (require_grad) {
+        grad.resize(total_size);
+    }
+}
+
+template <typename T>
+void BasicTensor<T>::print() const {
     std::cout << "Tensor shape: (";
     for (size_t i = 0; i < shape.size(); ++i) {
         std::cout << shape[i];
@@ -75,17 +105,18 @@ void Tensor::print() const {
     // This is a simplified print for all dimensions
     // You might want to implement a more sophisticated printing for multi-dimensional tensors
     for (const auto& val : data) {
-        std::cout << std::setprecision(4) << std::fixed << val << " ";
+        std::cout << std::setprecision(4) << std::fixed << static_cast<double>(val) << " ";
     }
     std::cout << std::endl;
 }
 
-Tensor Tensor::reshape(const std::vector<int>& new_shape) const {
+template <typename T>
+BasicTensor<T> BasicTensor<T>::reshape(const std::vector<int>& new_shape) const {
     size_t new_total_size = std::accumulate(new_shape.begin(), new_shape.end(), 1, std::multiplies<int>());
     if (new_total_size != total_size) {
         throw std::invalid_argument("New shape is incompatible with the current data size");
     }
-    Tensor reshaped(new_shape, require_grad);
+    BasicTensor reshaped(new_shape, require_grad);
     reshaped.data = data;
     if (require_grad) {
         reshaped.grad = grad;
@@ -93,16 +124,19 @@ Tensor Tensor::reshape(const std::vector<int>& new_shape) const {
     return reshaped;
 }
 
-double& Tensor::operator()(const std::vector<int>& indices) {
+template <typename T>
+T& BasicTensor<T>::operator()(const std::vector<int>& indices) {
     return data[calculate_index(indices)];
 }
 
-const double& Tensor::operator()(const std::vector<int>& indices) const {
+template <typename T>
+const T& BasicTensor<T>::operator()(const std::vector<int>& indices) const {
     return data[calculate_index(indices)];
 }
 
-size_t Tensor::calculate_index(const std::vector<int>& indices) const {
-    if (indices.size() != ndim) {
+template <typename T>
+size_t BasicTensor<T>::calculate_index(const std::vector<int>& indices) const {
+    if (indices.size() != static_cast<size_t>(ndim)) {
         throw std::invalid_argument("Number of indices does not match tensor dimensions");
     }
     size_t index = 0;
@@ -117,21 +151,25 @@ size_t Tensor::calculate_index(const std::vector<int>& indices) const {
     return index;
 }
 
-std::unique_ptr<Tensor> Tensor::zeros(const std::vector<int>& shape) {
-    return std::make_unique<Tensor>(shape, false);
+template <typename T>
+std::unique_ptr<BasicTensor<T>> BasicTensor<T>::zeros(const std::vector<int>& shape) {
+    return std::make_unique<BasicTensor>(shape, false);
 }
 
-std::unique_ptr<Tensor> Tensor::ones(const std::vector<int>& shape) {
-    auto tensor = std::make_unique<Tensor>(shape, false);
-    std::fill(tensor->data.begin(), tensor->data.end(), 1.0);
+template <typename T>
+std::unique_ptr<BasicTensor<T>> BasicTensor<T>::ones(const std::vector<int>& shape) {
+    auto tensor = std::make_unique<BasicTensor>(shape, false);
+    std::fill(tensor->data.begin(), tensor->data.end(), T(1));
     return tensor;
 }
 
-std::unique_ptr<Tensor> Tensor::random(const std::vector<int>& shape, double min, double max) {
-    auto tensor = std::make_unique<Tensor>(shape, false, true);
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    std::uniform_real_distribution<> dis(min, max);
-    std::generate(tensor->data.begin(), tensor->data.end(), [&]() { return dis(gen); });
+template <typename T>
+std::unique_ptr<BasicTensor<T>> BasicTensor<T>::random(const std::vector<int>& shape, double min, double max) {
+    auto tensor = std::make_unique<BasicTensor>(shape, false);
+    rng::fill_uniform(tensor->data.data(), tensor->total_size, min, max, rng::next_stream());
     return tensor;
-}
\ No newline at end of file
+}
+
+template class BasicTensor<float>;
+template class BasicTensor<double>;
+template class BasicTensor<bf16>;
\ No newline at end of file
@@ -0,0 +1,157 @@
+#include "../include/thread_pool.hpp"
+#include "../include/trace.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+namespace {
+
+// Busy-wait iterations before a spinning thread starts yielding its core
+constexpr int SPINS_BEFORE_YIELD = 1 << 14;
+
+void spin_pause(int& spins) {
+    if (spins < SPINS_BEFORE_YIELD) {
+        ++spins;
+#if defined(__x86_64__) || defined(__i386__)
+        _mm_pause();
+#endif
+    } else {
+        std::this_thread::yield();
+    }
+}
+
+} // namespace
+
+ThreadPool::ThreadPool(int num_threads) : num_threads(std::max(1, num_threads)) {
+    threads.reserve(this->num_threads - 1);
+    for (int i = 1; i < this->num_threads; ++i) {
+        threads.emplace_back(&ThreadPool::worker_loop, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    start_cv.notify_all();
+    for (auto& t : threads) {
+        t.join();
+    }
+}
+
+void ThreadPool::run_erased(JobFn fn, const void* job) {
+    if (num_threads == 1) {
+        fn(job, 0);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        current_fn = fn;
+        current_job = job;
+        pending = num_threads - 1;
+        ++generation;
+    }
+    start_cv.notify_all();
+
+    fn(job, 0);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    done_cv.wait(lock, [this] { return pending == 0; });
+    current_fn = nullptr;
+    current_job = nullptr;
+}
+
+void ThreadPool::worker_loop(int index) {
+    TRACE_THREAD_NAME("worker " + std::to_string(index));
+    unsigned long seen = 0;
+    while (true) {
+        JobFn fn;
+        const void* job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            start_cv.wait(lock, [&] { return stopping || generation != seen; });
+            if (stopping) {
+                return;
+            }
+            seen = generation;
+            fn = current_fn;
+            job = current_job;
+        }
+
+        fn(job, index);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (--pending == 0) {
+            done_cv.notify_one();
+        }
+    }
+}
+
+std::pair<size_t, size_t> ThreadPool::split(size_t count, int parts, int index) {
+    if (parts <= 0 || index < 0 || index >= parts) {
+        throw std::out_of_range("Invalid split of " + std::to_string(count) + " into " + std::to_string(parts));
+    }
+    const size_t base = count / parts;
+    const size_t extra = count % parts;
+    const size_t begin = index * base + std::min<size_t>(index, extra);
+    return {begin, begin + base + (static_cast<size_t>(index) < extra ? 1 : 0)};
+}
+
+SpinTeam::SpinTeam(int num_threads) : num_threads(std::max(1, num_threads)) {
+    threads.reserve(this->num_threads - 1);
+    for (int i = 1; i < this->num_threads; ++i) {
+        threads.emplace_back(&SpinTeam::worker_loop, this, i);
+    }
+}
+
+SpinTeam::~SpinTeam() {
+    stopping.store(true, std::memory_order_release);
+    for (auto& t : threads) {
+        t.join();
+    }
+}
+
+bool SpinTeam::try_run_erased(JobFn fn, const void* job) {
+    if (busy.exchange(true, std::memory_order_acquire)) {
+        return false;
+    }
+    if (num_threads > 1) {
+        current_fn = fn;
+        current_job = job;
+        pending.store(num_threads - 1, std::memory_order_relaxed);
+        generation.fetch_add(1, std::memory_order_release);
+    }
+
+    fn(job, 0);
+
+    for (int spins = 0; pending.load(std::memory_order_acquire) != 0;) {
+        spin_pause(spins);
+    }
+    busy.store(false, std::memory_order_release);
+    return true;
+}
+
+void SpinTeam::worker_loop(int index) {
+    TRACE_THREAD_NAME("spin worker " + std::to_string(index));
+    unsigned long seen = 0;
+    while (true) {
+        unsigned long current;
+        for (int spins = 0; (current = generation.load(std::memory_order_acquire)) == seen;) {
+            if (stopping.load(std::memory_order_acquire)) {
+                return;
+            }
+            spin_pause(spins);
+        }
+        seen = current;
+
+        current_fn(current_job, index);
+        pending.fetch_sub(1, std::memory_order_acq_rel);
+    }
+}
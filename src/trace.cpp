@@ -0,0 +1,206 @@
+#include "../include/trace.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <tuple>
+#include <vector>
+
+namespace trace {
+
+namespace {
+
+// Written only by its own thread. head counts every span ever recorded, the slot of span i
+// is i % RING_CAPACITY, and readers only look at the head after it is published.
+struct ThreadRing {
+    std::vector<Event> events;
+    std::atomic<uint64_t> head{0};
+    std::string name;
+    int tid;
+};
+
+struct Registry {
+    std::mutex mutex;
+    std::vector<std::unique_ptr<ThreadRing>> rings; // Kept after their thread exits
+};
+
+Registry& registry() {
+    static Registry r;
+    return r;
+}
+
+ThreadRing* register_thread() {
+    Registry& r = registry();
+    auto ring = std::make_unique<ThreadRing>();
+    ring->events.resize(RING_CAPACITY);
+    std::lock_guard<std::mutex> lock(r.mutex);
+    ring->tid = static_cast<int>(r.rings.size());
+    ring->name = "thread " + std::to_string(ring->tid);
+    r.rings.push_back(std::move(ring));
+    return r.rings.back().get();
+}
+
+ThreadRing& local_ring() {
+    thread_local ThreadRing* ring = register_thread();
+    return *ring;
+}
+
+struct ThreadEvents {
+    int tid;
+    std::string name;
+    std::vector<Event> events;
+};
+
+// Copies out what every ring still holds, oldest first
+std::vector<ThreadEvents> snapshot() {
+    Registry& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    std::vector<ThreadEvents> out;
+    for (const auto& ring : r.rings) {
+        const uint64_t head = ring->head.load(std::memory_order_acquire);
+        const uint64_t count = std::min<uint64_t>(head, RING_CAPACITY);
+        ThreadEvents t{ring->tid, ring->name, {}};
+        t.events.reserve(count);
+        for (uint64_t i = head - count; i < head; ++i) {
+            t.events.push_back(ring->events[i % RING_CAPACITY]);
+        }
+        out.push_back(std::move(t));
+    }
+    return out;
+}
+
+std::string escape(const std::string& s) {
+    std::string out;
+    for (char c : s) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+        }
+        out += c;
+    }
+    return out;
+}
+
+std::string display_name(const Event& e) {
+    return e.layer >= 0 ? std::string(e.name) + " [" + std::to_string(e.layer) + "]" : e.name;
+}
+
+} // namespace
+
+uint64_t now_ns() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+void record(const Event& event) {
+    ThreadRing& ring = local_ring();
+    const uint64_t head = ring.head.load(std::memory_order_relaxed);
+    ring.events[head % RING_CAPACITY] = event;
+    ring.head.store(head + 1, std::memory_order_release);
+}
+
+void set_thread_name(const std::string& name) {
+    ThreadRing& ring = local_ring();
+    std::lock_guard<std::mutex> lock(registry().mutex);
+    ring.name = name;
+}
+
+void write_chrome_json(const std::string& path) {
+    const std::vector<ThreadEvents> threads = snapshot();
+    uint64_t origin = UINT64_MAX;
+    for (const auto& t : threads) {
+        for (const Event& e : t.events) {
+            origin = std::min(origin, e.begin_ns);
+        }
+    }
+
+    std::ofstream out(path);
+    if (!out.is_open()) {
+        throw std::runtime_error("Error opening trace file " + path);
+    }
+    out << "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [\n";
+    bool first = true;
+    char line[512];
+    for (const auto& t : threads) {
+        std::snprintf(line, sizeof(line),
+                      "%s{\"ph\": \"M\", \"name\": \"thread_name\", \"pid\": 1, \"tid\": %d, \"args\": {\"name\": \"%s\"}}",
+                      first ? "" : ",\n", t.tid, escape(t.name).c_str());
+        out << line;
+        first = false;
+        for (const Event& e : t.events) {
+            // Chrome wants microseconds
+            std::snprintf(line, sizeof(line),
+                          ",\n{\"ph\": \"X\", \"name\": \"%s\", \"cat\": \"%s\", \"pid\": 1, \"tid\": %d, "
+                          "\"ts\": %.3f, \"dur\": %.3f, \"args\": {\"layer\": %d, \"flops\": %.0f, \"bytes\": %.0f}}",
+                          escape(display_name(e)).c_str(), e.category, t.tid, (e.begin_ns - origin) / 1e3,
+                          (e.end_ns - e.begin_ns) / 1e3, e.layer, e.flops, e.bytes);
+            out << line;
+        }
+    }
+    out << "\n]}\n";
+    if (!out) {
+        throw std::runtime_error("Error writing trace file " + path);
+    }
+}
+
+void print_summary(std::ostream& out) {
+    struct Total {
+        long calls = 0;
+        double ns = 0.0;
+        double flops = 0.0;
+        double bytes = 0.0;
+    };
+    std::map<std::tuple<std::string, std::string, int>, Total> totals;
+    uint64_t begin = UINT64_MAX, end = 0;
+    for (const auto& t : snapshot()) {
+        for (const Event& e : t.events) {
+            Total& total = totals[std::make_tuple(std::string(e.category), std::string(e.name), e.layer)];
+            total.calls++;
+            total.ns += static_cast<double>(e.end_ns - e.begin_ns);
+            total.flops += e.flops;
+            total.bytes += e.bytes;
+            begin = std::min(begin, e.begin_ns);
+            end = std::max(end, e.end_ns);
+        }
+    }
+    if (totals.empty()) {
+        out << "No trace spans recorded" << std::endl;
+        return;
+    }
+
+    // Most expensive first. Spans nest and threads overlap, so the shares of the traced wall
+    // time are per row and do not add up to 100%.
+    std::vector<std::pair<std::tuple<std::string, std::string, int>, Total>> rows(totals.begin(), totals.end());
+    std::sort(rows.begin(), rows.end(), [](const auto& a, const auto& b) { return a.second.ns > b.second.ns; });
+
+    const double wall = std::max(1.0, static_cast<double>(end - begin));
+    char line[256];
+    std::snprintf(line, sizeof(line), "%-10s %-20s %5s %9s %11s %11s %7s %9s %9s\n", "category", "span", "layer",
+                  "calls", "total ms", "mean us", "%wall", "GFLOP/s", "GB/s");
+    out << line;
+    for (const auto& row : rows) {
+        Total t = row.second;
+        t.ns = std::max(1.0, t.ns);
+        const int layer = std::get<2>(row.first);
+        std::snprintf(line, sizeof(line), "%-10s %-20s %5s %9ld %11.3f %11.3f %7.2f %9.2f %9.2f\n",
+                      std::get<0>(row.first).c_str(), std::get<1>(row.first).c_str(),
+                      layer >= 0 ? std::to_string(layer).c_str() : "-", t.calls, t.ns / 1e6, t.ns / t.calls / 1e3,
+                      100.0 * t.ns / wall, t.flops / t.ns, t.bytes / t.ns);
+        out << line;
+    }
+}
+
+void clear() {
+    Registry& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    for (auto& ring : r.rings) {
+        ring->head.store(0, std::memory_order_release);
+    }
+}
+
+} // namespace trace
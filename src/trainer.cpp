@@ -0,0 +1,124 @@
+#include "../include/trainer.hpp"
+#include "../include/ops.hpp"
+#include "../include/random.hpp"
+#include "../include/trace.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+
+template <typename T>
+BasicDataParallelTrainer<T>::BasicDataParallelTrainer(BasicModel<T>& model, int num_threads,
+                                                      const OptimizerConfig& optimizer_config)
+    : model(model), pool(num_threads), optim(model, optimizer_config, &pool) {
+    workspace.pool = &pool;
+}
+
+template <typename T>
+double BasicDataParallelTrainer<T>::step(const BasicTensor<T>& input, const BasicTensor<T>& actual, double learning_rate) {
+    const int batch_size = input.shape[0];
+    if (static_cast<int>(actual.total_size) != batch_size) {
+        throw std::runtime_error("Invalid dims for training step. Input: " + std::to_string(batch_size) +
+                                 " Actual: " + std::to_string(actual.total_size));
+    }
+    TRACE_SCOPE("train", "step");
+
+    // backward() overwrites the gradients, nothing to zero beforehand
+    const double loss = forward_loss(model, input, actual, workspace, batch_size);
+    backward(model, workspace.outputs.back(), actual, workspace, false);
+    optim.step(learning_rate);
+    return loss / batch_size;
+}
+
+template <typename T>
+BasicHogwildTrainer<T>::BasicHogwildTrainer(BasicModel<T>& model, int num_threads)
+    : model(model), pool(num_threads), counters(pool.size()) {
+    if (model.mapped()) {
+        throw std::runtime_error("Cannot train a model mapped from a checkpoint, load it with LoadMode::COPY");
+    }
+    if (!model.packed()) {
+        model.pack_parameters();
+    }
+    workspaces.reserve(pool.size());
+    for (int w = 0; w < pool.size(); ++w) {
+        workspaces.emplace_back(true);
+        workspaces.back().bind(model);
+        batch_inputs.emplace_back(std::vector<int>{0, 0});
+        batch_labels.emplace_back(std::vector<int>{0, 1});
+    }
+}
+
+template <typename T>
+double BasicHogwildTrainer<T>::epoch(const Dataset& dataset, int batch_size, double learning_rate, uint64_t seed,
+                                     int epoch) {
+    if (batch_size < 1) {
+        throw std::invalid_argument("Batch size must be at least 1");
+    }
+    TRACE_SCOPE("train", "hogwild_epoch");
+    model.set_weight_layout(WeightLayout::ROW_MAJOR);
+
+    // Same permutation as the DataLoader draws for (seed, epoch)
+    order.resize(dataset.count);
+    std::iota(order.begin(), order.end(), 0);
+    rng::shuffle(order.data(), order.size(), rng::SHUFFLE_STREAMS + epoch, seed);
+
+    const int num_batches = dataset.count / batch_size;
+    const int features = dataset.features;
+    const size_t total = model.parameters.size();
+    const acc_t<T> lr = static_cast<acc_t<T>>(learning_rate);
+    std::atomic<int> next_batch{0};
+    version = 0;
+
+    const auto start = std::chrono::steady_clock::now();
+    pool.run([&](int w) {
+        TRACE_SCOPE("train", "hogwild_worker");
+        BasicWorkspace<T>& ws = workspaces[w];
+        BasicTensor<T>& x = batch_inputs[w];
+        BasicTensor<T>& y = batch_labels[w];
+        x.resize(batch_size, features);
+        y.resize(batch_size, 1);
+        WorkerCounters c;
+
+        for (int b; (b = next_batch.fetch_add(1, std::memory_order_relaxed)) < num_batches;) {
+            dataset.gather(&order[static_cast<size_t>(b) * batch_size], batch_size, x, y);
+            const uint64_t seen = version.load(std::memory_order_relaxed);
+            c.loss += forward_loss(model, x, y, ws, batch_size);
+            backward(model, ws.outputs.back(), y, ws, false);
+            ops::sgd_update(model.parameters.data(), ws.grads.data(), lr, total);
+
+            const uint64_t staleness = version.fetch_add(1, std::memory_order_relaxed) - seen;
+            c.staleness_sum += staleness;
+            c.staleness_max = std::max(c.staleness_max, staleness);
+            c.updates++;
+            c.samples += batch_size;
+        }
+        counters[w] = c;
+    });
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    HogwildStats s;
+    double loss = 0.0;
+    uint64_t staleness_sum = 0;
+    for (const WorkerCounters& c : counters) {
+        s.updates += c.updates;
+        s.samples += c.samples;
+        staleness_sum += c.staleness_sum;
+        s.max_staleness = std::max(s.max_staleness, c.staleness_max);
+        loss += c.loss;
+    }
+    s.seconds = seconds;
+    s.mean_staleness = s.updates ? static_cast<double>(staleness_sum) / s.updates : 0.0;
+    s.samples_per_second = s.samples / seconds;
+    s.updates_per_second = s.updates / seconds;
+    last_stats = s;
+    return s.samples ? loss / s.samples : 0.0;
+}
+
+template class BasicDataParallelTrainer<float>;
+template class BasicDataParallelTrainer<double>;
+template class BasicDataParallelTrainer<bf16>;
+template class BasicHogwildTrainer<float>;
+template class BasicHogwildTrainer<double>;
+template class BasicHogwildTrainer<bf16>;
@@ -1,5 +1,7 @@
 #include "../include/utils.hpp"
 #include "../include/model.hpp"
+#include "../include/ops.hpp"
+#include "../include/trace.hpp"
 #include <iostream>
 #include <cmath>
 #include <algorithm>
@@ -7,13 +9,14 @@
 
 
 
-double Utils::cross_entropy_loss(const Tensor& y_pred, const Tensor& y_act) {
+template <typename T>
+double Utils::cross_entropy_loss(const BasicTensor<T>& y_pred, const BasicTensor<T>& y_act) {
     int batch_size = y_pred.shape[0];
 
     if (y_act.shape[1] != 1) {
         throw std::runtime_error("Actual must be of shape (n, 1)");
     }
-    if (batch_size != y_act.total_size) {
+    if (static_cast<size_t>(batch_size) != y_act.total_size) {
         throw std::runtime_error("Invalid dims for cross entropy loss. Predicted: " + 
                                  std::to_string(batch_size) + " Actual: " + std::to_string(y_act.total_size));
     }
@@ -21,47 +24,103 @@ double Utils::cross_entropy_loss(const Tensor& y_pred, const Tensor& y_act) {
     double loss = 0.0;
 
     for (int b = 0; b < batch_size; b++) {
-        int true_class = static_cast<int>(y_act.data[b]);
-        double pred = y_pred.data[b * size + true_class];
+        int true_class = static_cast<int>(static_cast<acc_t<T>>(y_act.data[b]));
+        double pred = static_cast<acc_t<T>>(y_pred.data[b * size + true_class]);
         loss -= std::log(std::max(pred, 1e-7));
     }
 
     return loss / batch_size;
 }
 
-void Utils::cross_entropy_softmax_backwards(Tensor& input, Tensor& output, const Tensor& actual) {
+template <typename T>
+void Utils::cross_entropy_softmax_backwards(BasicTensor<T>& input, BasicTensor<T>& output, const BasicTensor<T>& actual) {
+    cross_entropy_softmax_backwards(input, output, actual, input.shape[0]);
+}
+
+template <typename T>
+void Utils::cross_entropy_softmax_backwards(BasicTensor<T>& input, BasicTensor<T>& output, const BasicTensor<T>& actual, int total_batch) {
     int batch_size = input.shape[0];
     int size = input.shape[1];
 
-    for (int b = 0; b < batch_size; b++) {
-        for (int i = 0; i < size; i++) {
-            double targ = (i == static_cast<int>(actual.data[b])) ? 1.0 : 0.0;
-            input.grad[b * size + i] = (output.data[b * size + i] - targ) / batch_size;
-        }
-    }
+    ops::cross_entropy_grad(output.data.data(), actual.data.data(), input.grad.data(),
+                            batch_size, size, acc_t<T>(1) / total_batch);
 }
 
-void Utils::SGD_step(Model& model, double learning_rate) {
+template <typename T>
+void Utils::SGD_step(BasicModel<T>& model, double learning_rate) {
+    TRACE_SCOPE("optimizer", "sgd");
+    if (model.mapped()) {
+        throw std::runtime_error("Cannot update a model mapped from a checkpoint, load it with LoadMode::COPY");
+    }
+    model.set_weight_layout(WeightLayout::ROW_MAJOR);
+    const acc_t<T> lr = static_cast<acc_t<T>>(learning_rate);
     for (auto& layer : model.layers) {
         if (layer->layer_type == LayerType::LINEAR) {
-            for (size_t j = 0; j < layer->weights->total_size; j++) {
-                layer->weights->data[j] -= layer->weights->grad[j] * learning_rate;
-            }
-
-            for (size_t j = 0; j < layer->bias->total_size; j++) {
-                layer->bias->data[j] -= layer->bias->grad[j] * learning_rate;
-            }
+            ops::sgd_update(layer->weights->data.data(), layer->weights->grad.data(), lr, layer->weights->total_size);
+            ops::sgd_update(layer->bias->data.data(), layer->bias->grad.data(), lr, layer->bias->total_size);
         }
     }
 }
 
-void Utils::zero_grad(Model& model) {
+template <typename T>
+void Utils::zero_grad(BasicModel<T>& model) {
     for (auto& layer : model.layers) {
         if (layer->weights) {
-            std::fill(layer->weights->grad.begin(), layer->weights->grad.end(), 0.0);
+            std::fill(layer->weights->grad.begin(), layer->weights->grad.end(), acc_t<T>(0));
         }
         if (layer->bias) {
-            std::fill(layer->bias->grad.begin(), layer->bias->grad.end(), 0.0);
+            std::fill(layer->bias->grad.begin(), layer->bias->grad.end(), acc_t<T>(0));
         }
     }
-}
\ No newline at end of file
+}
+
+template <typename T>
+double Utils::gradient_check(BasicModel<T>& model, const BasicTensor<T>& input, const BasicTensor<T>& actual,
+                             int checks_per_layer, double epsilon) {
+    zero_grad(model);
+    const int batch_size = input.shape[0];
+    forward_loss(model, input, actual, model.workspace, batch_size);
+    backward(model, model.workspace.outputs.back(), actual);
+
+    auto loss_at = [&]() {
+        return forward_loss(model, input, actual, model.workspace, batch_size) / batch_size;
+    };
+
+    double worst = 0.0;
+    for (auto& layer : model.layers) {
+        if (layer->layer_type != LayerType::LINEAR) {
+            continue;
+        }
+        for (BasicTensor<T>* param : {layer->weights.get(), layer->bias.get()}) {
+            const size_t stride = std::max<size_t>(1, param->total_size / checks_per_layer);
+            for (size_t j = 0; j < param->total_size; j += stride) {
+                const T saved = param->data[j];
+                param->data[j] = saved + epsilon;
+                const double plus = loss_at();
+                param->data[j] = saved - epsilon;
+                const double minus = loss_at();
+                param->data[j] = saved;
+
+                const double numeric = (plus - minus) / (2.0 * epsilon);
+                const double analytic = param->grad[j];
+                const double scale = std::max(1e-8, std::fabs(numeric) + std::fabs(analytic));
+                worst = std::max(worst, std::fabs(numeric - analytic) / scale);
+            }
+        }
+    }
+    zero_grad(model);
+    return worst;
+}
+
+#define INSTANTIATE_UTILS(T) \
+    template double Utils::cross_entropy_loss(const BasicTensor<T>&, const BasicTensor<T>&); \
+    template void Utils::cross_entropy_softmax_backwards(BasicTensor<T>&, BasicTensor<T>&, const BasicTensor<T>&); \
+    template void Utils::cross_entropy_softmax_backwards(BasicTensor<T>&, BasicTensor<T>&, const BasicTensor<T>&, int); \
+    template void Utils::SGD_step(BasicModel<T>&, double); \
+    template void Utils::zero_grad(BasicModel<T>&);
+
+INSTANTIATE_UTILS(float)
+INSTANTIATE_UTILS(double)
+INSTANTIATE_UTILS(bf16)
+
+template double Utils::gradient_check(BasicModel<double>&, const BasicTensor<double>&, const BasicTensor<double>&, int, double);
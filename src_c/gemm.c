@@ -0,0 +1,126 @@
+#include "../include/gemm.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Packing buffers, grown once and reused for every call (the C engine is single threaded)
+static double* packed_a = NULL;
+static double* packed_b = NULL;
+
+static void alloc_pack_buffers(void) {
+    if (packed_a != NULL) {
+        return;
+    }
+    packed_a = (double *) malloc(sizeof(double) * GEMM_MC * GEMM_KC);
+    packed_b = (double *) malloc(sizeof(double) * GEMM_KC * GEMM_NC);
+    if (packed_a == NULL || packed_b == NULL) {
+        fprintf(stderr, "Failed to allocate gemm packing buffers\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+static int min_int(int a, int b) {
+    return a < b ? a : b;
+}
+
+// Copies an mc x kc block of A into panels of MR rows, column by column, so the micro kernel reads it in order
+// Pads the last panel with 0s so the kernel never has to check edges
+static void pack_a(bool trans, int mc, int kc, const double* A, int lda, double* packed) {
+    for (int ir = 0; ir < mc; ir += GEMM_MR) {
+        int mr = min_int(GEMM_MR, mc - ir);
+        for (int p = 0; p < kc; p++) {
+            for (int i = 0; i < mr; i++) {
+                packed[p * GEMM_MR + i] = trans ? A[p * lda + ir + i] : A[(ir + i) * lda + p];
+            }
+            for (int i = mr; i < GEMM_MR; i++) {
+                packed[p * GEMM_MR + i] = 0.0;
+            }
+        }
+        packed += kc * GEMM_MR;
+    }
+}
+
+// Same thing for B but panels of NR columns, row by row
+static void pack_b(bool trans, int kc, int nc, const double* B, int ldb, double* packed) {
+    for (int jr = 0; jr < nc; jr += GEMM_NR) {
+        int nr = min_int(GEMM_NR, nc - jr);
+        for (int p = 0; p < kc; p++) {
+            for (int j = 0; j < nr; j++) {
+                packed[p * GEMM_NR + j] = trans ? B[(jr + j) * ldb + p] : B[p * ldb + jr + j];
+            }
+            for (int j = nr; j < GEMM_NR; j++) {
+                packed[p * GEMM_NR + j] = 0.0;
+            }
+        }
+        packed += kc * GEMM_NR;
+    }
+}
+
+// MR x NR block of C kept in registers for the whole kc loop, only the mr x nr corner gets written for edges
+static void micro_kernel(int kc, const double* a, const double* b, double* C, int ldc,
+                         double alpha, double beta, int mr, int nr) {
+    double acc[GEMM_MR][GEMM_NR] = {{0}};
+    for (int p = 0; p < kc; p++) {
+        for (int i = 0; i < GEMM_MR; i++) {
+            double ai = a[p * GEMM_MR + i];
+            for (int j = 0; j < GEMM_NR; j++) {
+                acc[i][j] += ai * b[p * GEMM_NR + j];
+            }
+        }
+    }
+
+    for (int i = 0; i < mr; i++) {
+        for (int j = 0; j < nr; j++) {
+            // beta of 0 shouldn't read C at all, it might be garbage
+            if (beta == 0.0) {
+                C[i * ldc + j] = alpha * acc[i][j];
+            } else {
+                C[i * ldc + j] = alpha * acc[i][j] + beta * C[i * ldc + j];
+            }
+        }
+    }
+}
+
+void gemm(bool trans_a, bool trans_b, int m, int n, int k,
+          double alpha, const double* A, int lda, const double* B, int ldb,
+          double beta, double* C, int ldc) {
+    if (m <= 0 || n <= 0) {
+        return;
+    }
+    if (k <= 0 || alpha == 0.0) {
+        for (int i = 0; i < m; i++) {
+            for (int j = 0; j < n; j++) {
+                C[i * ldc + j] = beta == 0.0 ? 0.0 : beta * C[i * ldc + j];
+            }
+        }
+        return;
+    }
+
+    alloc_pack_buffers();
+
+    for (int jc = 0; jc < n; jc += GEMM_NC) {
+        int nc = min_int(GEMM_NC, n - jc);
+
+        for (int pc = 0; pc < k; pc += GEMM_KC) {
+            int kc = min_int(GEMM_KC, k - pc);
+            // After the first block of k we are adding onto what is already in C
+            double beta_pc = pc == 0 ? beta : 1.0;
+
+            pack_b(trans_b, kc, nc, trans_b ? B + jc * ldb + pc : B + pc * ldb + jc, ldb, packed_b);
+
+            for (int ic = 0; ic < m; ic += GEMM_MC) {
+                int mc = min_int(GEMM_MC, m - ic);
+
+                pack_a(trans_a, mc, kc, trans_a ? A + pc * lda + ic : A + ic * lda + pc, lda, packed_a);
+
+                for (int jr = 0; jr < nc; jr += GEMM_NR) {
+                    for (int ir = 0; ir < mc; ir += GEMM_MR) {
+                        micro_kernel(kc, packed_a + ir * kc, packed_b + jr * kc,
+                                     C + (ic + ir) * ldc + jc + jr, ldc, alpha, beta_pc,
+                                     min_int(GEMM_MR, mc - ir), min_int(GEMM_NR, nc - jr));
+                    }
+                }
+            }
+        }
+    }
+}
@@ -1,11 +1,11 @@
 #include "../include/tensor.h"
 #include "../include/model.h"
 #include "../include/utils.h"
+#include "../include/random.h"
 #include "../include/tensor.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <time.h>
 
 #define BATCH_SIZE 16
 #define EPOCHS 75
@@ -83,7 +83,9 @@ void MNIST_dataset(const char* filename, Dataset* dataset) {
 }
 
 int main() {
-    srand(time(NULL));
+    // SEED picks the initial weights, fixed by default so runs are reproducible
+    const char* env_seed = getenv("SEED");
+    rng_set_seed(env_seed ? strtoull(env_seed, NULL, 0) : RNG_DEFAULT_SEED);
     
     // Load dataset
     Dataset* dataset = create_dataset(86184, 784);
@@ -101,6 +103,17 @@ int main() {
     int num_batches = dataset->count / BATCH_SIZE;
     double learning_rate = .01;
 
+    // OPTIMIZER picks sgd (the default), adam or adamw like the C++ version, without momentum
+    const char* env_optimizer = getenv("OPTIMIZER");
+    Adam* adam = NULL;
+    if (env_optimizer && (strcmp(env_optimizer, "adam") == 0 || strcmp(env_optimizer, "adamw") == 0)) {
+        adam = create_adam(model, 0.9, 0.999, 1e-8, strcmp(env_optimizer, "adamw") == 0 ? 0.01 : 0.0);
+        learning_rate = 1e-3;
+    } else if (env_optimizer && strcmp(env_optimizer, "sgd") != 0) {
+        fprintf(stderr, "Unknown optimizer: %s, expected sgd, adam or adamw\n", env_optimizer);
+        exit(EXIT_FAILURE);
+    }
+
     for (int epoch = 0; epoch < EPOCHS; epoch++) {
         double total_loss = 0.0;
 
@@ -129,14 +142,15 @@ int main() {
             double loss = cross_entropy_loss(pred, y_act);
             total_loss += loss;
 
-            // Backward pass
-            backwards(model, pred, y_act);
+            // Backward pass, overwrites the grads so there is nothing to zero afterwards
+            backwards(model, pred, y_act, false);
 
             // Update weights
-            SGD_step(model, learning_rate);
-
-            // Zero gradients
-            zero_grad(model);
+            if (adam) {
+                Adam_step(adam, model, learning_rate);
+            } else {
+                SGD_step(model, learning_rate);
+            }
 
             // Free temporary tensors
             free_tensor(input);
@@ -148,6 +162,9 @@ int main() {
         printf("Epoch %d, Average Loss: %.9f\n", epoch + 1, total_loss / num_batches);
     }
     free_dataset(dataset);
+    if (adam) {
+        free_adam(adam);
+    }
 
     Dataset* test_dataset = create_dataset(21546, 784);
     MNIST_dataset("data/test_dataset.txt", dataset);
@@ -3,6 +3,7 @@
 #include "../include/utils.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 
 
@@ -101,7 +102,7 @@ Tensor* forward(Model* model, Tensor* input) {
     return x;
 }
 
-void backwards(Model* model, Tensor* pred, Tensor* act) {
+void backwards(Model* model, Tensor* pred, Tensor* act, bool accumulate) {
     int last_layer = model->layer_size -1;
 
     // Calculate the grad of the loss where the input is the input of the last layer, pred, expected
@@ -120,15 +121,17 @@ void backwards(Model* model, Tensor* pred, Tensor* act) {
                 break;
             case LINEAR_LAYER:
                 // input the current layer input and weights, as well as the cur grad to matmul
-                matmul_d(cur_layer->input, cur_layer->weights, cur_grad);
+                matmul_d(cur_layer->input, cur_layer->weights, cur_grad, accumulate);
 
-                // Update bias weights by sum
-                for (int j = 0; j < cur_layer->bias->total_size; j++) {
-                    double sum = 0.0;
-                    for (int batch = 0; batch < cur_grad->shape[0]; batch++) {
-                        sum += cur_grad->grad[batch * cur_layer->bias->total_size + j];
+                // Update bias weights by sum, going down the rows so the reads are contiguous
+                int bias_size = cur_layer->bias->total_size;
+                if (!accumulate) {
+                    memset(cur_layer->bias->grad, 0, sizeof(double) * bias_size);
+                }
+                for (int batch = 0; batch < cur_grad->shape[0]; batch++) {
+                    for (int j = 0; j < bias_size; j++) {
+                        cur_layer->bias->grad[j] += cur_grad->grad[batch * bias_size + j];
                     }
-                    cur_layer->bias->grad[j] += sum;
                 }
 
 
@@ -1,10 +1,11 @@
 #include "../include/tensor.h"
+#include "../include/gemm.h"
 #include <stdlib.h>
 #include <stdio.h>
 #include <math.h>
 
 
-// The matmul operation which is VERY slow and I will def speed up either from scratch or just yoink BLAS, also only up to 2 dim for right now
+// The matmul operation, goes through the blocked gemm in gemm.c, also only up to 2 dim for right now
 Tensor* matmul(Tensor* t1, Tensor* t2) {
 
     if (t1->ndim > 2 || t2->ndim > 2) {
@@ -26,51 +27,23 @@ Tensor* matmul(Tensor* t1, Tensor* t2) {
 
     Tensor* res = create_tensor(shape, 2, t1->req_grad || t2->req_grad);
 
-    //TODO: FASTER
-    for (int i = 0; i < m; i++) {
-         for (int j = 0; j < p; j++) {
-             double sum = 0.0;
-             for (int k = 0; k < n; k++) {
-                 sum += t1->data[i * n + k] * t2->data[k * p + j];
-             }
-             res->data[i * p + j] = sum;
-         }
-    }
+    gemm(false, false, m, p, n, 1.0, t1->data, n, t2->data, p, 0.0, res->data, p);
     return res;
 }
 
 // I kept messing up the deriv so I commented it heavily
-void matmul_d(Tensor* t1, Tensor* t2, Tensor* prev_layer_grad) {
+// The weight grad (t2) is summed into when accumulate is set and overwritten otherwise,
+// t1.grad is always overwritten since nothing else writes to it
+void matmul_d(Tensor* t1, Tensor* t2, Tensor* prev_layer_grad, bool accumulate) {
     int m = t1->shape[0]; // i iterates over rows of t1, prev
     int n = t1->shape[1]; // j iterates over rows of t1, cols of t2
     int p = t2->shape[1]; // k iterates over cols of t2, prev
     
     // t1.grad = Prev times t2^T
-    for (int i = 0; i < m; i++) {
-        for (int j = 0; j < n; j++) {
-            double sum = 0;
-            for (int k = 0; k < p; k++) {
-                // row of grad times col (transposed row) of t2
-                sum += prev_layer_grad->grad[i * p + k] * t2->data[j * p + k];
-
-
-            }
-            t1->grad[i * n + j] += sum;
-        }
-    }
-
+    gemm(false, true, m, n, p, 1.0, prev_layer_grad->grad, p, t2->data, p, 0.0, t1->grad, n);
 
     // t2.grad = t1^T times prev
-    for (int j = 0; j < n; j++) {
-        for (int k = 0; k < p; k++) {
-            double sum = 0;
-            for (int i = 0; i < m; i++) {
-                // col (transposed row) of t1 times row of grad 
-                sum += t1->data[i * n + j] * prev_layer_grad->grad[i * p + k];
-            }
-            t2->grad[j * p + k] += sum;
-        }
-    }
+    gemm(true, false, n, p, m, 1.0, t1->data, n, prev_layer_grad->grad, p, accumulate ? 1.0 : 0.0, t2->grad, p);
 }
 
 
@@ -0,0 +1,52 @@
+#include "../include/random.h"
+
+static uint64_t global_seed = RNG_DEFAULT_SEED;
+static uint64_t streams = 0;
+
+void rng_set_seed(uint64_t seed) {
+    global_seed = seed;
+    streams = 0;
+}
+
+uint64_t rng_seed(void) {
+    return global_seed;
+}
+
+uint64_t rng_next_stream(void) {
+    return streams++;
+}
+
+void rng_philox(uint64_t seed, uint64_t stream, uint64_t block, uint32_t out[4]) {
+    uint32_t c0 = (uint32_t) block, c1 = (uint32_t) (block >> 32);
+    uint32_t c2 = (uint32_t) stream, c3 = (uint32_t) (stream >> 32);
+    uint32_t k0 = (uint32_t) seed, k1 = (uint32_t) (seed >> 32);
+    for (int round = 0; round < 10; round++) {
+        uint64_t p0 = 0xD2511F53ull * c0;
+        uint64_t p1 = 0xCD9E8D57ull * c2;
+        uint32_t n0 = (uint32_t) (p1 >> 32) ^ c1 ^ k0;
+        uint32_t n2 = (uint32_t) (p0 >> 32) ^ c3 ^ k1;
+        c0 = n0;
+        c1 = (uint32_t) p1;
+        c2 = n2;
+        c3 = (uint32_t) p0;
+        k0 += 0x9E3779B9u;
+        k1 += 0xBB67AE85u;
+    }
+    out[0] = c0;
+    out[1] = c1;
+    out[2] = c2;
+    out[3] = c3;
+}
+
+void rng_fill_uniform(double* out, long int n, double lo, double hi, uint64_t stream) {
+    // lo + (hi - lo) * (bits + 0.5) / 2^32 with the bits read as signed, as one multiply-add
+    double scale = (hi - lo) / 4294967296.0;
+    double offset = lo + (hi - lo) * (2147483648.5 / 4294967296.0);
+    uint32_t bits[4];
+    for (long int i = 0; i < n; i++) {
+        if (i % 4 == 0) {
+            rng_philox(global_seed, stream, (uint64_t) i / 4, bits);
+        }
+        out[i] = offset + scale * (double) (int32_t) bits[i % 4];
+    }
+}
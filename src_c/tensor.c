@@ -1,4 +1,5 @@
 #include "../include/tensor.h"
+#include "../include/random.h"
 #include <stdio.h>
 #include <stdlib.h>
 
@@ -113,13 +114,11 @@ Tensor* create_tensor_rand(const int* shape, int ndim, bool req_grad) {
     tensor->total_size = total_size;
 
     tensor->data = (double *) malloc(total_size * sizeof(double));
-    for (int i = 0; i < total_size; i++) {
-            tensor->data[i] = MIN_RAND + (rand() / (double)RAND_MAX) * (MAX_RAND - MIN_RAND);
-    }
     if (tensor->data == NULL) {
         fprintf(stderr, "Failed to allocate space for data of tensor\n");
         exit(EXIT_FAILURE);
     }
+    rng_fill_uniform(tensor->data, total_size, MIN_RAND, MAX_RAND, rng_next_stream());
 
     tensor->req_grad = req_grad;
     if (req_grad) {
@@ -19,14 +19,12 @@ double cross_entropy_loss(Tensor* y_pred, Tensor* y_act) {
     int size = y_pred->shape[1];
     double loss = 0.0;
 
+    // One term per row, this used to be added size times over
     for (int b = 0; b < batch_size; b++) {
-
-        for (int i = 0; i < size; i++) {
-            int true_class = y_act->data[b];
-            double pred = y_pred->data[b * size + true_class];
-            // Make sure to not log of 0, otherwise KABLOOM 
-            loss -= log(fmax(pred, 1e-7));
-        }
+        int true_class = y_act->data[b];
+        double pred = y_pred->data[b * size + true_class];
+        // Make sure to not log of 0, otherwise KABLOOM 
+        loss -= log(fmax(pred, 1e-7));
     }
 
     // This is to make sure the loss wasn't 0 because if it was then the afformentioned kabloom occured, not needed anymore but is a relic of my pain
@@ -55,7 +53,6 @@ void cross_entropy_softmax_backwards(Tensor* input, Tensor* output, Tensor* actu
 
 
 
-//TODO Adam optim?!?!
 // Pretty simple just the classic SGD, changes the all linear layers
 void SGD_step(Model* model, double learning_rate) {
     for (int i = 0; i < model->layer_size; i++) {
@@ -75,6 +72,78 @@ void SGD_step(Model* model, double learning_rate) {
 
 }
 
+static long int linear_param_count(Model* model) {
+    long int count = 0;
+    for (int i = 0; i < model->layer_size; i++) {
+        Layer* layer = &model->layers[i];
+        if (layer->layer_type == LINEAR_LAYER) {
+            count += layer->weights->total_size + layer->bias->total_size;
+        }
+    }
+    return count;
+}
+
+Adam* create_adam(Model* model, double beta1, double beta2, double epsilon, double weight_decay) {
+    long int count = linear_param_count(model);
+
+    Adam* adam = malloc(sizeof(Adam));
+    double* state = calloc(2 * count, sizeof(double));
+    if (adam == NULL || state == NULL) {
+        fprintf(stderr, "Failed to allocate memory for Adam\n");
+        exit(EXIT_FAILURE);
+    }
+    adam->m = state;
+    adam->v = state + count;
+    adam->count = count;
+    adam->step = 0;
+    adam->beta1 = beta1;
+    adam->beta2 = beta2;
+    adam->epsilon = epsilon;
+    adam->weight_decay = weight_decay;
+    return adam;
+}
+
+// One pass per tensor that reads the param, grad, m and v once, the bias corrections are folded
+// into a step size and a scale for sqrt(v) up front
+static void adam_update(Adam* adam, Tensor* param, long int offset, double step_size, double inv_sqrt_bias2,
+                        double decay) {
+    double* m = adam->m + offset;
+    double* v = adam->v + offset;
+    for (long int j = 0; j < param->total_size; j++) {
+        double g = param->grad[j];
+        m[j] = adam->beta1 * m[j] + (1.0 - adam->beta1) * g;
+        v[j] = adam->beta2 * v[j] + (1.0 - adam->beta2) * g * g;
+        param->data[j] = decay * param->data[j] - step_size * m[j] / (sqrt(v[j]) * inv_sqrt_bias2 + adam->epsilon);
+    }
+}
+
+void Adam_step(Adam* adam, Model* model, double learning_rate) {
+    if (linear_param_count(model) != adam->count) {
+        fprintf(stderr, "Model changed after create_adam, Adam has state for %ld parameters\n", adam->count);
+        exit(EXIT_FAILURE);
+    }
+    adam->step++;
+    double step_size = learning_rate / (1.0 - pow(adam->beta1, adam->step));
+    double inv_sqrt_bias2 = 1.0 / sqrt(1.0 - pow(adam->beta2, adam->step));
+    double decay = 1.0 - learning_rate * adam->weight_decay;
+
+    long int offset = 0;
+    for (int i = 0; i < model->layer_size; i++) {
+        Layer* layer = &model->layers[i];
+        if (layer->layer_type == LINEAR_LAYER) {
+            adam_update(adam, layer->weights, offset, step_size, inv_sqrt_bias2, decay);
+            offset += layer->weights->total_size;
+            adam_update(adam, layer->bias, offset, step_size, inv_sqrt_bias2, decay);
+            offset += layer->bias->total_size;
+        }
+    }
+}
+
+void free_adam(Adam* adam) {
+    free(adam->m);
+    free(adam);
+}
+
 // Zeros grad using memset, though I have heard it is unsafe
 void zero_grad(Model* model) {
     for (int i = 0; i < model->layer_size; i++) {